@@ -0,0 +1,165 @@
+/*
+ * File:	benchChunkTable.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench table: per frame chunk bookkeeping, ChunkTable against std::map
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+#include "chunkTable.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+typedef ChunkTable::chunkCoord chunkCoord;
+
+// chunks around the camera, the full detail window of the game before it had
+// levels of detail
+#define TABLE_DIST 5
+
+// the bookkeeping TerrainPager used to do with one std::map per field
+struct MapBookkeeping
+{
+	std::map<chunkCoord, int> chunkToMesh;
+	std::map<chunkCoord, bool> chunkProcessing;
+	std::map<chunkCoord, bool> chunkDirty;
+
+	void markDirty( const chunkCoord &coord )
+	{
+		chunkDirty[ coord ] = true;
+	}
+
+	void regenerate( const chunkCoord &chunk, std::vector<chunkCoord> &work )
+	{
+		for( int x = chunk.x - TABLE_DIST; x <= chunk.x + TABLE_DIST; x++ )
+		{
+			for( int z = chunk.z - TABLE_DIST; z <= chunk.z + TABLE_DIST; z++ )
+			{
+				chunkCoord coord = chunkCoord( x, 0, z );
+
+				if( chunkProcessing[ coord ] == true )
+				{
+					continue;
+				}
+
+				if( chunkToMesh.find( coord ) == chunkToMesh.end() || chunkDirty[coord] == true )
+				{
+					chunkProcessing[ coord ] = true;
+					chunkDirty[ coord ] = false;
+					work.push_back( coord );
+				}
+			}
+		}
+	}
+
+	void finish( const chunkCoord &coord, int meshId )
+	{
+		chunkToMesh[coord] = meshId;
+		chunkProcessing[coord] = false;
+	}
+};
+
+// the same bookkeeping on a ChunkTable, as TerrainCore does it
+struct TableBookkeeping
+{
+	ChunkTable chunks;
+
+	TableBookkeeping() : chunks( 4*(2*TABLE_DIST+1)*(2*TABLE_DIST+1) ) {}
+
+	void markDirty( const chunkCoord &coord )
+	{
+		ChunkRecord &rec = chunks.insert( coord );
+		rec.dirty = true;
+		rec.version++;
+	}
+
+	void regenerate( const chunkCoord &chunk, std::vector<chunkCoord> &work )
+	{
+		for( int x = chunk.x - TABLE_DIST; x <= chunk.x + TABLE_DIST; x++ )
+		{
+			for( int z = chunk.z - TABLE_DIST; z <= chunk.z + TABLE_DIST; z++ )
+			{
+				chunkCoord coord = chunkCoord( x, 0, z );
+				ChunkRecord &rec = chunks.insert( coord );
+
+				if( rec.state == CHUNK_PROCESSING )
+				{
+					continue;
+				}
+
+				if( rec.state == CHUNK_NEW || rec.dirty )
+				{
+					rec.state = CHUNK_PROCESSING;
+					rec.dirty = false;
+					work.push_back( coord );
+				}
+			}
+		}
+	}
+
+	void finish( const chunkCoord &coord, int meshId )
+	{
+		ChunkRecord &rec = chunks.insert( coord );
+		rec.meshId = meshId;
+		rec.state = CHUNK_MESHED;
+	}
+};
+
+// stand still with a few edits per frame, the common case for the game
+template <typename Bookkeeping>
+static void run( const char *name, int frames, int edits )
+{
+	Bookkeeping book;
+	std::vector<chunkCoord> work;
+	work.reserve( (2*TABLE_DIST+1)*(2*TABLE_DIST+1) );
+
+	chunkCoord center( 0, 0, 0 );
+	int nextMesh = 0;
+
+	// warm up, mesh everything in range once
+	book.regenerate( center, work );
+	for( size_t i = 0; i < work.size(); i++ )
+	{
+		book.finish( work[i], nextMesh++ );
+	}
+
+	size_t allocs = benchAllocations();
+	benchClock::time_point start = benchClock::now();
+
+	for( int frame = 0; frame < frames; frame++ )
+	{
+		for( int e = 0; e < edits; e++ )
+		{
+			int x = (frame * 7 + e * 13) % (2*TABLE_DIST+1) - TABLE_DIST;
+			int z = (frame * 11 + e * 5) % (2*TABLE_DIST+1) - TABLE_DIST;
+			book.markDirty( chunkCoord( x, 0, z ) );
+		}
+
+		work.clear();
+		book.regenerate( center, work );
+
+		for( size_t i = 0; i < work.size(); i++ )
+		{
+			book.finish( work[i], i );
+		}
+	}
+
+	double ms = elapsedMs( start );
+	allocs = benchAllocations() - allocs;
+
+	printf( "%-10s %8.0f ns/frame  %6.2f ns/lookup  %zu allocations\n", name,
+			ms * 1e6 / frames, ms * 1e6 / (frames * (double)(2*TABLE_DIST+1)*(2*TABLE_DIST+1)), allocs );
+}
+
+int benchChunkTable( int argc, char *argv[] )
+{
+	int frames = (argc > 0) ? atoi(argv[0]) : 100000;
+	int edits = (argc > 1) ? atoi(argv[1]) : 4;
+
+	run<MapBookkeeping>( "std::map", frames, edits );
+	run<TableBookkeeping>( "ChunkTable", frames, edits );
+
+	return 0;
+}
@@ -0,0 +1,272 @@
+/*
+ * File:	benchCollide.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench collide: bodies walking over the terrain, CameraMan's old raycasts against swept boxes
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+// blocks paged in around the origin, on a side
+#define COLLIDE_AREA 4
+
+// a tick at 60 frames per second
+#define COLLIDE_DT (1.0f / 60)
+
+// CameraMan's player
+#define COLLIDE_HEIGHT 2.0f
+#define COLLIDE_RADIUS 0.4f
+#define COLLIDE_HEADROOM 0.25f
+#define COLLIDE_GRAVITY 10.0f
+#define COLLIDE_FALL_MAX 10.0f
+
+struct Mover
+{
+	// eye position
+	PolyVox::Vector3DFloat pos;
+	PolyVox::Vector3DFloat vel;
+};
+
+static float randomFloat( float lo, float hi )
+{
+	return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+// walking speeds up to CameraMan's running top speed
+static void randomHeading( Mover &m )
+{
+	float angle = randomFloat( 0, 6.2831853f );
+	float speed = randomFloat( 5, 300 );
+
+	m.vel = PolyVox::Vector3DFloat( cosf( angle ) * speed, m.vel.getY(), sinf( angle ) * speed );
+}
+
+static void spawn( TerrainCore &core, std::vector<Mover> &movers, size_t count )
+{
+	movers.resize( count );
+
+	for( size_t i = 0; i < count; i++ )
+	{
+		Mover &m = movers[i];
+		PolyVox::Vector3DFloat top( randomFloat( 16, COLLIDE_AREA*CHUNK_SIZE - 16 ), 120, randomFloat( 16, COLLIDE_AREA*CHUNK_SIZE - 16 ) );
+
+		// standing on the highest column under the box
+		float ground = -1000;
+		for( int c = 0; c < 4; c++ )
+		{
+			PolyVox::Vector3DFloat corner( top.getX() + ((c & 1) ? COLLIDE_RADIUS : -COLLIDE_RADIUS), top.getY(),
+					top.getZ() + ((c & 2) ? COLLIDE_RADIUS : -COLLIDE_RADIUS) );
+
+			PolyVox::RaycastResult result;
+			core.raycast( corner, PolyVox::Vector3DFloat( 0, -200, 0 ), result );
+			ground = std::max( ground, result.previousVoxel.getY() - 0.5f );
+		}
+
+		m.pos = PolyVox::Vector3DFloat( top.getX(), ground + COLLIDE_HEIGHT + 0.01f, top.getZ() );
+		m.vel = PolyVox::Vector3DFloat( 0, 0, 0 );
+		randomHeading( m );
+	}
+}
+
+// gravity, a new heading now and then, turned back at the edge of the area
+static void steer( Mover &m, int tick, size_t i )
+{
+	float y = m.vel.getY() - COLLIDE_GRAVITY * COLLIDE_DT;
+	m.vel = PolyVox::Vector3DFloat( m.vel.getX(), (y < -COLLIDE_FALL_MAX) ? -COLLIDE_FALL_MAX : y, m.vel.getZ() );
+
+	if( (tick + i) % 120 == 0 )
+	{
+		randomHeading( m );
+	}
+
+	const float edge = COLLIDE_AREA*CHUNK_SIZE - 16;
+	if( (m.pos.getX() < 16 && m.vel.getX() < 0) || (m.pos.getX() > edge && m.vel.getX() > 0) )
+	{
+		m.vel = PolyVox::Vector3DFloat( -m.vel.getX(), m.vel.getY(), m.vel.getZ() );
+	}
+	if( (m.pos.getZ() < 16 && m.vel.getZ() < 0) || (m.pos.getZ() > edge && m.vel.getZ() > 0) )
+	{
+		m.vel = PolyVox::Vector3DFloat( m.vel.getX(), m.vel.getY(), -m.vel.getZ() );
+	}
+}
+
+// what CameraMan did before swept boxes: half voxel raycasts from the head
+// and the feet along each axis it moves on, snapping to the voxel before a hit
+static void rayStep( TerrainCore &core, Mover &m )
+{
+	const float width = 0.5f;
+	PolyVox::Vector3DFloat posH( m.pos.getX(), m.pos.getY() + width, m.pos.getZ() );
+	PolyVox::Vector3DFloat posL( m.pos.getX(), m.pos.getY() - COLLIDE_HEIGHT + width, m.pos.getZ() );
+
+	float pos[3] = { m.pos.getX(), m.pos.getY(), m.pos.getZ() };
+	float vel[3] = { m.vel.getX(), m.vel.getY(), m.vel.getZ() };
+
+	for( int a = 0; a < 3; a += 2 )
+	{
+		if( vel[a] == 0 )
+		{
+			continue;
+		}
+
+		float d[3] = { 0, 0, 0 };
+		d[a] = (vel[a] > 0) ? width : -width;
+
+		PolyVox::RaycastResult resultH, resultL;
+		core.raycastVolume( posH, PolyVox::Vector3DFloat( d[0], d[1], d[2] ), resultH );
+		core.raycastVolume( posL, PolyVox::Vector3DFloat( d[0], d[1], d[2] ), resultL );
+
+		if( resultH.foundIntersection || resultL.foundIntersection )
+		{
+			const PolyVox::Vector3DInt32 &prev = resultH.foundIntersection ? resultH.previousVoxel : resultL.previousVoxel;
+
+			vel[a] = 0;
+			pos[a] = (a == 0) ? prev.getX() : prev.getZ();
+		}
+	}
+
+	if( vel[1] != 0 )
+	{
+		PolyVox::RaycastResult result;
+		if( vel[1] > 0 )
+		{
+			core.raycastVolume( posH, PolyVox::Vector3DFloat( 0, width, 0 ), result );
+		}
+		else
+		{
+			core.raycastVolume( posL, PolyVox::Vector3DFloat( 0, -width, 0 ), result );
+		}
+
+		if( result.foundIntersection )
+		{
+			pos[1] = result.previousVoxel.getY();
+			if( vel[1] < 0 )
+			{
+				pos[1] += COLLIDE_HEIGHT - 1.0f;
+			}
+			vel[1] = 0;
+		}
+	}
+
+	m.vel = PolyVox::Vector3DFloat( vel[0], vel[1], vel[2] );
+	m.pos = PolyVox::Vector3DFloat( pos[0], pos[1], pos[2] ) + m.vel * COLLIDE_DT;
+}
+
+// every body in one call, as CameraMan does for the player
+static void sweepStep( TerrainCore &core, std::vector<Mover> &movers, std::vector<CollisionBody> &bodies )
+{
+	for( size_t i = 0; i < movers.size(); i++ )
+	{
+		const Mover &m = movers[i];
+		CollisionBody &body = bodies[i];
+
+		body.lo = PolyVox::Vector3DFloat( m.pos.getX() - COLLIDE_RADIUS, m.pos.getY() - COLLIDE_HEIGHT, m.pos.getZ() - COLLIDE_RADIUS );
+		body.hi = PolyVox::Vector3DFloat( m.pos.getX() + COLLIDE_RADIUS, m.pos.getY() + COLLIDE_HEADROOM, m.pos.getZ() + COLLIDE_RADIUS );
+		body.move = m.vel * COLLIDE_DT;
+	}
+
+	core.collide( &bodies[0], bodies.size() );
+
+	for( size_t i = 0; i < movers.size(); i++ )
+	{
+		Mover &m = movers[i];
+		const CollisionBody &body = bodies[i];
+
+		m.pos += body.moved;
+		m.vel = PolyVox::Vector3DFloat( (body.blocked & (COLLIDE_NEG_X | COLLIDE_POS_X)) ? 0 : m.vel.getX(),
+				(body.blocked & (COLLIDE_NEG_Y | COLLIDE_POS_Y)) ? 0 : m.vel.getY(),
+				(body.blocked & (COLLIDE_NEG_Z | COLLIDE_POS_Z)) ? 0 : m.vel.getZ() );
+	}
+}
+
+// the body's eyes or middle are in a solid voxel, it went into a wall
+static bool embedded( TerrainCore &core, const Mover &m )
+{
+	PolyVox::RaycastResult result;
+	const PolyVox::Vector3DFloat none( 0, 0, 0 );
+
+	core.raycast( m.pos, none, result );
+	if( result.foundIntersection )
+	{
+		return true;
+	}
+
+	core.raycast( m.pos - PolyVox::Vector3DFloat( 0, COLLIDE_HEIGHT / 2, 0 ), none, result );
+	return result.foundIntersection;
+}
+
+template <bool swept>
+static void run( TerrainCore &core, const char *name, size_t count, int ticks )
+{
+	std::vector<Mover> movers;
+	std::vector<CollisionBody> bodies( count );
+
+	srand( 1 );
+	spawn( core, movers, count );
+
+	size_t stuck = 0;
+	double ms = 0;
+	double travelled = 0;
+	std::vector<PolyVox::Vector3DFloat> last( count );
+
+	for( int tick = 0; tick < ticks; tick++ )
+	{
+		for( size_t i = 0; i < count; i++ )
+		{
+			steer( movers[i], tick, i );
+			last[i] = movers[i].pos;
+		}
+
+		benchClock::time_point start = benchClock::now();
+		if( swept )
+		{
+			sweepStep( core, movers, bodies );
+		}
+		else
+		{
+			for( size_t i = 0; i < count; i++ )
+			{
+				rayStep( core, movers[i] );
+			}
+		}
+		ms += elapsedMs( start );
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			stuck += embedded( core, movers[i] );
+			PolyVox::Vector3DFloat step = movers[i].pos - last[i];
+			travelled += sqrtf( step.getX()*step.getX() + step.getZ()*step.getZ() );
+		}
+	}
+
+	printf( "%-8s %5zu bodies  %8.1f ns/body  %6.3f ms/tick  %5.2f voxels/tick walked  %5.2f%% of body ticks inside terrain\n", name, count,
+			ms * 1e6 / ((double)count * ticks), ms / ticks, travelled / ((double)count * ticks), 100.0 * stuck / ((double)count * ticks) );
+}
+
+int benchCollide( int argc, char *argv[] )
+{
+	size_t count = (argc > 0) ? atoi(argv[0]) : 500;
+	int ticks = (argc > 1) ? atoi(argv[1]) : 600;
+
+	TerrainCore core;
+
+	// page the area in so both see the same voxels
+	for( int x = 0; x < COLLIDE_AREA; x++ )
+	{
+		for( int z = 0; z < COLLIDE_AREA; z++ )
+		{
+			core.prefetch( PolyVox::Region( PolyVox::Vector3DInt32( x*CHUNK_SIZE, -CHUNK_SIZE, z*CHUNK_SIZE ),
+						PolyVox::Vector3DInt32( (x+1)*CHUNK_SIZE - 1, 2*CHUNK_SIZE - 1, (z+1)*CHUNK_SIZE - 1 ) ) );
+		}
+	}
+
+	run<false>( core, "rays", count, ticks );
+	run<true>( core, "swept", count, ticks );
+
+	return 0;
+}
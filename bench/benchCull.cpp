@@ -0,0 +1,171 @@
+/*
+ * File:	benchCull.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench cull: triangles submitted per frame along canned camera paths
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+#include "chunkJob.h"
+#include "chunkVisibility.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// the game's camera, see BasicTutorial3
+#define CULL_FOV_Y (M_PI / 4)
+#define CULL_ASPECT (4.0f / 3.0f)
+#define CULL_NEAR 0.1f
+#define CULL_FAR 5000.0f
+
+enum CullPath
+{
+	PATH_FLY,			// skim the surface along +x looking ahead
+	PATH_SPIN,			// stand still and turn around once
+	PATH_OVERHEAD,		// fly high along +z looking down at an angle
+	CULL_PATHS
+};
+
+static const char *pathNames[CULL_PATHS] = { "fly", "spin", "overhead" };
+
+static void cameraPath( CullPath path, int frame, int frames, float speed, PolyVox::Vector3DFloat &position,
+		PolyVox::Vector3DFloat &direction )
+{
+	switch( path )
+	{
+		case PATH_FLY:
+			position = PolyVox::Vector3DFloat( frame * speed, 70, 0 );
+			direction = PolyVox::Vector3DFloat( 1, -0.2f, 0 );
+			break;
+
+		case PATH_SPIN:
+		{
+			float angle = 2 * M_PI * frame / frames;
+			position = PolyVox::Vector3DFloat( 0, 70, 0 );
+			direction = PolyVox::Vector3DFloat( cosf( angle ), -0.2f, sinf( angle ) );
+			break;
+		}
+
+		default:
+			position = PolyVox::Vector3DFloat( 0, 400, frame * speed );
+			direction = PolyVox::Vector3DFloat( 0, -1, 1 );
+			break;
+	}
+}
+
+// mesh everything in range along the path and count what each stage of the
+// visibility pass lets through
+static void run( CullPath path, int frames, float speed )
+{
+	TerrainCore core;
+	ChunkJobPool pool( CHUNK_SIZE );
+
+	// draw info of every section, sections without a chunk draw nothing
+	std::vector<ChunkDrawInfo> sections;
+	std::vector<int> freeSections;
+	std::vector<ChunkDraw> draws;
+
+	size_t resident = 0, frustum = 0, faces = 0, drawCount = 0;
+	double cullMs = 0;
+
+	for( int frame = 0; frame < frames; frame++ )
+	{
+		PolyVox::Vector3DFloat position, direction;
+		cameraPath( path, frame, frames, speed, position, direction );
+
+		core.regenerate( position, direction );
+
+		const std::vector<int> &evicted = core.getEvicted();
+		for( size_t i = 0; i < evicted.size(); i++ )
+		{
+			sections[ evicted[i] ].faceStart[CHUNK_FACES] = 0;
+			freeSections.push_back( evicted[i] );
+		}
+
+		TerrainCore::chunkCoord coord;
+
+		while( core.nextChunk( coord ) )
+		{
+			ChunkJob *job = pool.acquire();
+			job->region = TerrainCore::toRegion( coord );
+			job->coord = coord;
+			job->mesher = MESHER_GREEDY;
+
+			core.extractJob( *job );
+
+			int meshId = core.getMeshId( coord );
+			if( meshId == -1 )
+			{
+				if( freeSections.empty() )
+				{
+					meshId = sections.size();
+					sections.push_back( ChunkDrawInfo() );
+				}
+				else
+				{
+					meshId = freeSections.back();
+					freeSections.pop_back();
+				}
+			}
+
+			sections[ meshId ].set( meshId, job->mesh );
+			core.finishChunk( coord, meshId );
+
+			pool.release( job );
+		}
+
+		for( size_t i = 0; i < sections.size(); i++ )
+		{
+			resident += sections[i].faceStart[CHUNK_FACES] / 3;
+		}
+
+		ViewFrustum view;
+		view.setPerspective( position, direction, PolyVox::Vector3DFloat( 0, 1, 0 ), CULL_FOV_Y, CULL_ASPECT, CULL_NEAR, CULL_FAR );
+
+		draws.clear();
+		buildDrawList( view, position, sections, false, draws );
+		for( size_t i = 0; i < draws.size(); i++ )
+		{
+			frustum += draws[i].indexCount / 3;
+		}
+
+		benchClock::time_point start = benchClock::now();
+
+		draws.clear();
+		buildDrawList( view, position, sections, true, draws );
+
+		cullMs += elapsedMs( start );
+
+		for( size_t i = 0; i < draws.size(); i++ )
+		{
+			faces += draws[i].indexCount / 3;
+		}
+		drawCount += draws.size();
+	}
+
+	printf( "%-9s %8zu resident  %8zu frustum (%4.1f%%)  %8zu +faces (%4.1f%%)  %5.1f draws  %6.2f us/frame\n",
+			pathNames[path], resident / frames, frustum / frames, 100.0 * frustum / resident, faces / frames,
+			100.0 * faces / resident, (double)drawCount / frames, cullMs * 1000 / frames );
+}
+
+int benchCull( int argc, char *argv[] )
+{
+	int frames = (argc > 0) ? atoi(argv[0]) : 300;
+	float speed = (argc > 1) ? atof(argv[1]) : 4.0;
+
+	printf( "triangles per frame\n" );
+
+	for( int path = 0; path < CULL_PATHS; path++ )
+	{
+		if( argc > 2 && strcmp( argv[2], pathNames[path] ) != 0 )
+		{
+			continue;
+		}
+		run( (CullPath)path, frames, speed );
+	}
+
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * File:	benchEdit.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench edit: sphere brushes against one setVoxelAt per voxel
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+
+#include <cstdlib>
+#include <cstdio>
+
+// mesh everything queued so only the chunks of the next edit are counted
+static int drain( TerrainCore &core, int &nextMesh )
+{
+	core.regenerate( PolyVox::Vector3DFloat( 0, 33, 0 ), PolyVox::Vector3DFloat( 1, 0, 0 ) );
+
+	int count = 0;
+	TerrainCore::chunkCoord coord;
+	while( core.nextChunk( coord ) )
+	{
+		int meshId = core.getMeshId( coord );
+		core.finishChunk( coord, (meshId == -1) ? nextMesh++ : meshId );
+		count++;
+	}
+	return count;
+}
+
+// the sphere the game used to carve, voxel by voxel through setVoxelAt
+static void perVoxelSphere( TerrainCore &core, const PolyVox::Vector3DFloat &center, float radius, uint8_t material )
+{
+	for( int z = center.getZ() - radius; z <= center.getZ() + radius; z++ )
+	{
+		for( int y = center.getY() - radius; y <= center.getY() + radius; y++ )
+		{
+			for( int x = center.getX() - radius; x <= center.getX() + radius; x++ )
+			{
+				float dx = x - center.getX(), dy = y - center.getY(), dz = z - center.getZ();
+
+				if( dx*dx + dy*dy + dz*dz <= radius*radius && y >= 0 && y < CHUNK_SIZE )
+				{
+					core.setVoxelAt( PolyVox::Vector3DInt32( x, y, z ), PolyVox::Material8( material ) );
+				}
+			}
+		}
+	}
+}
+
+int benchEdit( int argc, char *argv[] )
+{
+	int edits = (argc > 0) ? atoi(argv[0]) : 20;
+
+	static const float radii[] = { 4, 8, 16, 32 };
+
+	TerrainCore core;
+	int nextMesh = 0;
+
+	// page in everything the brushes reach so generation isn't timed
+	for( int x = -2; x <= 2; x++ )
+	{
+		for( int z = -2; z <= 2; z++ )
+		{
+			core.prefetch( TerrainCore::toRegion( TerrainCore::chunkCoord( x, 0, z ) ) );
+		}
+	}
+	drain( core, nextMesh );
+
+	for( size_t r = 0; r < sizeof(radii)/sizeof(radii[0]); r++ )
+	{
+		float radius = radii[r];
+		double brushMs = 0, voxelMs = 0;
+		int brushChunks = 0, voxelChunks = 0;
+
+		for( int e = 0; e < edits; e++ )
+		{
+			// alternate digging and filling so every edit changes voxels, and
+			// move around so some edits straddle chunk borders
+			PolyVox::Vector3DFloat center( (e * 23) % 96 - 48, 32, (e * 41) % 96 - 48 );
+			uint8_t material = (e & 1) ? 1 : 0;
+
+			benchClock::time_point start = benchClock::now();
+			core.editSphere( center, radius, PolyVox::Material8( material ) );
+			brushMs += elapsedMs( start );
+			brushChunks += drain( core, nextMesh );
+
+			start = benchClock::now();
+			perVoxelSphere( core, center, radius, 1 - material );
+			voxelMs += elapsedMs( start );
+			voxelChunks += drain( core, nextMesh );
+		}
+
+		printf( "radius %4.0f  brush %8.3f ms  %5.1f chunks   per voxel %8.3f ms  %5.1f chunks\n", radius,
+				brushMs / edits, brushChunks / (double)edits, voxelMs / edits, voxelChunks / (double)edits );
+	}
+
+	return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * File:	benchFill.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench fill: voxels per second of generating blocks as the volume pages them in
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+#include "terrainMetrics.h"
+
+#include <cstdlib>
+#include <cstdio>
+
+// page in one layer of blocks along x and time it, the heightfields are
+// computed by prefetch before the timer starts
+static void pageLayer( TerrainCore &core, const char *name, int by, int columns )
+{
+	TerrainMetricsSample sample;
+	core.getMetrics().sample( sample );
+
+	for( int x = 0; x < columns; x++ )
+	{
+		core.prefetch( PolyVox::Region( PolyVox::Vector3DInt32( x*CHUNK_SIZE, by*CHUNK_SIZE, 0 ),
+					PolyVox::Vector3DInt32( x*CHUNK_SIZE + CHUNK_SIZE - 1, by*CHUNK_SIZE + CHUNK_SIZE - 1, CHUNK_SIZE - 1 ) ) );
+	}
+
+	core.getMetrics().sample( sample );
+
+	const double voxels = (double)columns * CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE;
+	const double ms = sample.timers[TIMER_PAGE_IN].totalMs;
+
+	printf( "%-8s %6d blocks %8.1f ms  %8.1f Mvoxels/s  %6.3f ns/voxel  noise %.1f ms\n", name, columns, ms,
+			voxels / (ms * 1000), ms * 1e6 / voxels, sample.timers[TIMER_NOISE].totalMs );
+}
+
+int benchFill( int argc, char *argv[] )
+{
+	int columns = (argc > 0) ? atoi(argv[0]) : 256;
+
+	TerrainCore core;
+
+	// the surface blocks are filled row by row into arrays, the solid ones
+	// under them and the empty ones over them as runs
+	pageLayer( core, "surface", 0, columns );
+	pageLayer( core, "solid", -1, columns );
+	pageLayer( core, "empty", 1, columns );
+
+	TerrainMetricsSample sample;
+	core.sampleMetrics( sample );
+	printf( "voxels   %.1f MB for %d blocks\n", sample.voxelBytes / 1048576.0, 3*columns );
+
+	return 0;
+}
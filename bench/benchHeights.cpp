@@ -0,0 +1,75 @@
+/*
+ * File:	benchHeights.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench heights: noise paid for flying out and back, with and without the heightfield cache
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+#include "terrainMetrics.h"
+#include "chunkJob.h"
+
+#include <cstdlib>
+#include <cstdio>
+
+// far enough that the blocks of the way out are paged out before the way back
+#define HEIGHTS_DISTANCE 12288
+
+static void run( const char *name, size_t capacity, int laps, float speed )
+{
+	TerrainCore core;
+	ChunkJob job( CHUNK_SIZE );
+	int nextMesh = 0;
+	size_t chunks = 0;
+
+	core.setHeightfieldCapacity( capacity );
+
+	// only what the flight costs
+	TerrainMetricsSample sample;
+	core.getMetrics().sample( sample );
+
+	benchClock::time_point start = benchClock::now();
+
+	for( int lap = 0; lap < 2*laps; lap++ )
+	{
+		const float dir = (lap % 2 == 0) ? 1 : -1;
+
+		for( float travelled = 0; travelled <= HEIGHTS_DISTANCE; travelled += speed )
+		{
+			const float x = (dir > 0) ? travelled : HEIGHTS_DISTANCE - travelled;
+			core.regenerate( PolyVox::Vector3DFloat( x, 33, 0 ), PolyVox::Vector3DFloat( dir, 0, 0 ) );
+
+			TerrainCore::chunkCoord coord;
+			while( core.nextChunk( coord ) )
+			{
+				job.region = TerrainCore::toRegion( coord );
+				job.coord = coord;
+				job.mesher = MESHER_GREEDY;
+				core.extractJob( job );
+
+				int meshId = core.getMeshId( coord );
+				core.finishChunk( coord, (meshId == -1) ? nextMesh++ : meshId );
+				chunks++;
+			}
+		}
+	}
+
+	double ms = elapsedMs( start );
+	core.getMetrics().sample( sample );
+	HeightfieldCacheStats stats = core.getHeightfieldStats();
+
+	printf( "%-10s %6zu chunks %8.1f ms  noise %7.1f ms in %5zu tiles  page in %7.1f ms  %5zu hits %5zu misses  %4zu tiles %5.1f MB\n",
+			name, chunks, ms, sample.timers[TIMER_NOISE].totalMs, sample.timers[TIMER_NOISE].count, sample.timers[TIMER_PAGE_IN].totalMs,
+			stats.hits, stats.misses, stats.tiles, stats.bytes / 1048576.0 );
+}
+
+int benchHeights( int argc, char *argv[] )
+{
+	int laps = (argc > 0) ? atoi(argv[0]) : 1;
+	float speed = (argc > 1) ? atof(argv[1]) : 16;
+
+	run( "uncached", 0, laps, speed );
+	run( "cached", HEIGHT_CACHE_TILES, laps, speed );
+
+	return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * File:	benchLod.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench lod: view range, triangles and mesh memory of the level of detail rings
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+#include "chunkMesh.h"
+#include "chunkJob.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+// the view range before level of detail, every chunk at full detail
+#define FLAT_DIST 5
+
+// fly along +x meshing up to budget chunks per frame, then let the window
+// settle and report what is resident
+static void run( const char *name, int levels, int radius, int frames, float speed, int budget )
+{
+	TerrainCore core( "", levels, radius );
+	ChunkJobPool pool( CHUNK_SIZE );
+
+	// the renderer's sections, evicted ones are reused like TerrainPager does
+	std::vector<size_t> sectionBytes, sectionTriangles;
+	std::vector<int> freeSections;
+	size_t liveBytes = 0, liveTriangles = 0, peakBytes = 0, peakTriangles = 0, peakChunks = 0;
+	size_t chunks = 0;
+	int holes = 0;
+
+	benchClock::time_point start = benchClock::now();
+
+	// the last frames stand still until everything queued is meshed
+	for( int frame = 0; frame < frames || core.getSchedulerStats().queued > 0; frame++ )
+	{
+		PolyVox::Vector3DFloat position( std::min( frame, frames ) * speed, 33, 0 );
+
+		core.regenerate( position, PolyVox::Vector3DFloat( 1, 0, 0 ) );
+
+		const std::vector<int> &evicted = core.getEvicted();
+		for( size_t i = 0; i < evicted.size(); i++ )
+		{
+			liveBytes -= sectionBytes[ evicted[i] ];
+			liveTriangles -= sectionTriangles[ evicted[i] ];
+			sectionBytes[ evicted[i] ] = sectionTriangles[ evicted[i] ] = 0;
+			freeSections.push_back( evicted[i] );
+		}
+
+		TerrainCore::chunkCoord coord;
+
+		for( int n = 0; (budget <= 0 || n < budget) && core.nextChunk( coord ); n++ )
+		{
+			ChunkJob *job = pool.acquire();
+			job->region = TerrainCore::toRegion( coord );
+			job->coord = coord;
+			job->mesher = MESHER_GREEDY;
+
+			core.extractJob( *job );
+
+			int meshId = core.getMeshId( coord );
+			if( meshId == -1 )
+			{
+				if( freeSections.empty() )
+				{
+					meshId = sectionBytes.size();
+					sectionBytes.push_back( 0 );
+					sectionTriangles.push_back( 0 );
+				}
+				else
+				{
+					meshId = freeSections.back();
+					freeSections.pop_back();
+				}
+			}
+
+			liveBytes += job->mesh.sizeInBytes() - sectionBytes[ meshId ];
+			liveTriangles += job->mesh.indexCount() / 3 - sectionTriangles[ meshId ];
+			sectionBytes[ meshId ] = job->mesh.sizeInBytes();
+			sectionTriangles[ meshId ] = job->mesh.indexCount() / 3;
+
+			peakBytes = std::max( peakBytes, liveBytes );
+			peakTriangles = std::max( peakTriangles, liveTriangles );
+
+			core.finishChunk( coord, meshId );
+			chunks++;
+
+			pool.release( job );
+		}
+
+		peakChunks = std::max( peakChunks, core.getChunkCount() );
+
+		// a hole is the ground one chunk ahead having no mesh at any level
+		PolyVox::Vector3DFloat ahead = position + PolyVox::Vector3DFloat( CHUNK_SIZE, 0, 0 );
+		TerrainCore::chunkCoord below = TerrainCore::toChunkCoord( PolyVox::Vector3DInt32( ahead.getX(), 0, ahead.getZ() ) );
+
+		while( below.lod < levels && core.getMeshId( below ) == -1 )
+		{
+			below = below.parent();
+		}
+		if( frame < frames && below.lod == levels )
+		{
+			holes++;
+		}
+	}
+
+	double ms = elapsedMs( start );
+
+	printf( "%-6s %d levels of %d  range %5d voxels  %4zu chunks (%4zu peak)  %7zu triangles (%7zu peak)  %6.1f MB (%6.1f peak)  %5zu meshed in %6.0f ms  %d holes\n",
+			name, levels, radius, core.getViewRange(), core.getChunkCount(), peakChunks, liveTriangles, peakTriangles,
+			liveBytes / 1048576.0, peakBytes / 1048576.0, chunks, ms, holes );
+}
+
+int benchLod( int argc, char *argv[] )
+{
+	int frames = (argc > 0) ? atoi(argv[0]) : 600;
+	float speed = (argc > 1) ? atof(argv[1]) : 2.0;
+	int budget = (argc > 2) ? atoi(argv[2]) : 8;
+
+	run( "flat", 1, FLAT_DIST, frames, speed, budget );
+	run( "lod", LOD_LEVELS, CHUNK_DIST, frames, speed, budget );
+
+	return 0;
+}
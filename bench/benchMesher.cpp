@@ -0,0 +1,72 @@
+/*
+ * File:	benchMesher.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench mesher: triangles and time per chunk, cubic against greedy mesher
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+#include "chunkMesh.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+struct MesherResult
+{
+	double ms;
+	size_t triangles;
+	size_t bytes;
+};
+
+int benchMesher( int argc, char *argv[] )
+{
+	int side = (argc > 0) ? atoi(argv[0]) : 4;
+
+	static const char *names[] = { "cubic", "greedy" };
+	static const MesherType types[] = { MESHER_CUBIC, MESHER_GREEDY };
+	MesherResult results[2] = { {0, 0, 0}, {0, 0, 0} };
+
+	TerrainCore core;
+
+	PolyVox::SurfaceMesh<PolyVox::PositionMaterial> surf_mesh;
+	std::vector<uint8_t> scratch;
+	ChunkMesh mesh;
+
+	for( int x = 0; x < side; x++ )
+	{
+		for( int z = 0; z < side; z++ )
+		{
+			PolyVox::Region region = TerrainCore::toRegion( TerrainCore::chunkCoord( x, 0, z ) );
+
+			// both meshers work on the same copy, only meshing is timed
+			PolyVox::RawVolume<PolyVox::Material8> snap( TerrainCore::toSnapshotRegion( TerrainCore::toLocalRegion( region ) ) );
+			core.snapshot( region, snap );
+
+			for( int m = 0; m < 2; m++ )
+			{
+				benchClock::time_point start = benchClock::now();
+				TerrainCore::meshSnapshot( snap, region, 0, types[m], surf_mesh, scratch, mesh );
+				results[m].ms += elapsedMs( start );
+
+				results[m].triangles += mesh.indexCount() / 3;
+				results[m].bytes += mesh.sizeInBytes();
+			}
+		}
+	}
+
+	int chunks = side * side;
+
+	for( int m = 0; m < 2; m++ )
+	{
+		printf( "%-7s %8.3f ms/chunk  %8zu triangles/chunk  %8zu bytes/chunk\n", names[m],
+				results[m].ms / chunks, results[m].triangles / chunks, results[m].bytes / chunks );
+	}
+
+	if( results[1].triangles > 0 )
+	{
+		printf( "greedy has %.1fx fewer triangles\n", (double)results[0].triangles / results[1].triangles );
+	}
+
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * File:	benchMetrics.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench metrics: fly over the terrain without a screen, writing the streaming metrics to a log
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+#include "terrainMetrics.h"
+#include "chunkJob.h"
+#include "chunkPipeline.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// frames at 60 per second, the workers run in between
+#define METRICS_FRAME_MS (1000.0 / 60)
+
+// voxels flown per frame
+#define METRICS_SPEED 2.0f
+
+// seconds between log lines
+#define METRICS_PERIOD 1.0
+
+// stands in for the renderer, keeps each chunk's mesh size as the memory
+// its buffers would hold
+struct MetricsUpload
+{
+	TerrainCore *core;
+	ChunkJobPool *pool;
+	std::vector<size_t> *meshBytes;
+
+	void operator()( ChunkJob *job ) const
+	{
+		int meshId = core->getMeshId( job->coord );
+		if( meshId == -1 )
+		{
+			meshId = meshBytes->size();
+			meshBytes->push_back( 0 );
+		}
+
+		(*meshBytes)[meshId] = job->mesh.sizeInBytes();
+
+		core->finishChunk( job->coord, meshId );
+		pool->release( job );
+	}
+};
+
+int benchMetrics( int argc, char *argv[] )
+{
+	double seconds = (argc > 0) ? atof(argv[0]) : 10;
+	MetricsFormat format = (argc > 1 && strcmp( argv[1], "json" ) == 0) ? METRICS_JSON : METRICS_CSV;
+	const char *path = (argc > 2) ? argv[2] : "-";
+
+	TerrainMetricsLog log( path, format, METRICS_PERIOD );
+	if( !log.isOpen() )
+	{
+		fprintf( stderr, "metrics: can't write %s\n", path );
+		return 1;
+	}
+
+	TerrainCore core;
+	ChunkJobPool pool( CHUNK_SIZE, &core.getMetrics() );
+	ChunkPipeline pipeline( core, pool );
+	std::vector<size_t> meshBytes;
+
+	MetricsUpload sim = { &core, &pool, &meshBytes };
+	const PolyVox::Vector3DFloat direction( 1, 0, 0 );
+
+	benchClock::time_point begin = benchClock::now();
+
+	for( int frame = 0; elapsedMs( begin ) < seconds * 1000; frame++ )
+	{
+		benchClock::time_point start = benchClock::now();
+		const PolyVox::Vector3DFloat position( frame * METRICS_SPEED, 33, 0 );
+
+		core.regenerate( position, direction );
+
+		// evicted chunks give their buffers up
+		const std::vector<int> &evicted = core.getEvicted();
+		for( size_t i = 0; i < evicted.size(); i++ )
+		{
+			meshBytes[ evicted[i] ] = 0;
+		}
+
+		TerrainCore::chunkCoord coord;
+		while( pipeline.canSubmit() && core.nextChunk( coord ) )
+		{
+			ChunkJob *job = pool.acquire();
+			job->region = TerrainCore::toRegion( coord );
+			job->coord = coord;
+			job->mesher = MESHER_GREEDY;
+			pipeline.submit( job );
+		}
+
+		pipeline.upload( position, UPLOAD_BUDGET_MS, sim );
+
+		if( log.due() )
+		{
+			TerrainMetricsSample sample;
+			core.sampleMetrics( sample );
+
+			ChunkPipelineStats stats = pipeline.getStats();
+			sample.generateQueued = stats.stages[STAGE_GENERATE].queued;
+			sample.meshQueued = stats.stages[STAGE_MESH].queued;
+			sample.uploadQueued = stats.stages[STAGE_UPLOAD].queued;
+
+			for( size_t i = 0; i < meshBytes.size(); i++ )
+			{
+				sample.meshBytes += meshBytes[i];
+			}
+
+			log.write( sample );
+		}
+
+		std::this_thread::sleep_until( start + std::chrono::microseconds( (int)(METRICS_FRAME_MS * 1000) ) );
+	}
+
+	return 0;
+}
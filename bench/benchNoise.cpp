@@ -0,0 +1,191 @@
+/*
+ * File:	benchNoise.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench noise: batch noise kernels against single samples, and fractal octave stacks
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+#include "noiseEngine.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#define FRACTAL_OCTAVES 5
+
+// what the octave loop looked like before NoiseEngine: a count known at run
+// time, one call through a function per sample
+template <typename T>
+static T __attribute__((noinline)) callSample( const NoiseEngine<T> &noise, T x, T y )
+{
+	return noise.sample( x, y, 0 );
+}
+
+template <typename T>
+static T runtimeFbm( const NoiseEngine<T> &noise, int octaves, T x, T y )
+{
+	T sum = 0, total = 0, amplitude = 1;
+
+	for( int o = 0; o < octaves; o++ )
+	{
+		sum += amplitude * callSample( noise, x, y );
+		total += amplitude;
+		amplitude *= T(0.5);
+		x *= 2;
+		y *= 2;
+	}
+	return sum / total;
+}
+
+template <typename T>
+static void benchFractal( const char *type, int samples, double scale )
+{
+	NoiseEngine<T> noise;
+	const int octaves = (samples > 0) ? FRACTAL_OCTAVES : 0;
+
+	double sum[3] = { 0, 0, 0 };
+	double ms[3];
+
+	benchClock::time_point start = benchClock::now();
+	for( int i = 0; i < samples; i++ )
+	{
+		sum[0] += runtimeFbm<T>( noise, octaves, (i & 1023) * scale, (i >> 10) * scale );
+	}
+	ms[0] = elapsedMs( start );
+
+	start = benchClock::now();
+	for( int i = 0; i < samples; i++ )
+	{
+		sum[1] += noise.template fractal<FRACTAL_OCTAVES, NOISE_FBM>( (i & 1023) * scale, (i >> 10) * scale );
+	}
+	ms[1] = elapsedMs( start );
+
+	start = benchClock::now();
+	for( int i = 0; i < samples; i++ )
+	{
+		sum[2] += noise.template fractal<FRACTAL_OCTAVES, NOISE_RIDGED>( (i & 1023) * scale, (i >> 10) * scale );
+	}
+	ms[2] = elapsedMs( start );
+
+	// the sums keep the loops from being thrown away, and the two fBm agree
+	printf( "%-7s %d octaves  runtime fbm %6.1f  template fbm %6.1f  ridged %6.1f Msamples/s  fbm difference %g  ridged mean %.3f\n",
+			type, FRACTAL_OCTAVES, samples / (ms[0] * 1000.0), samples / (ms[1] * 1000.0), samples / (ms[2] * 1000.0),
+			fabs( sum[0] - sum[1] ) / samples, sum[2] / samples );
+}
+
+// tiles of engines of different seeds made on threads at once match the
+// same tiles made one after the other
+static bool seedsAreIndependent( int tiles, double scale )
+{
+	const int seeds = 4;
+	std::vector<float> serial( seeds * tiles * CHUNK_SIZE * CHUNK_SIZE );
+	std::vector<float> parallel( serial.size() );
+
+	std::vector<NoiseEngine<float>*> engines;
+	for( int s = 0; s < seeds; s++ )
+	{
+		engines.push_back( new NoiseEngine<float>( s ) );
+	}
+
+	for( int s = 0; s < seeds; s++ )
+	{
+		for( int t = 0; t < tiles; t++ )
+		{
+			engines[s]->tile( t*CHUNK_SIZE*scale, 0, scale, CHUNK_SIZE, CHUNK_SIZE, &serial[(s*tiles + t) * CHUNK_SIZE * CHUNK_SIZE] );
+		}
+	}
+
+	std::vector<std::thread> threads;
+	for( int s = 0; s < seeds; s++ )
+	{
+		threads.push_back( std::thread( [&, s]()
+			{
+				for( int t = 0; t < tiles; t++ )
+				{
+					engines[s]->tile( t*CHUNK_SIZE*scale, 0, scale, CHUNK_SIZE, CHUNK_SIZE, &parallel[(s*tiles + t) * CHUNK_SIZE * CHUNK_SIZE] );
+				}
+			} ) );
+	}
+	for( size_t t = 0; t < threads.size(); t++ )
+	{
+		threads[t].join();
+	}
+
+	// and the seeds make different noise
+	bool distinct = !std::equal( serial.begin(), serial.begin() + tiles * CHUNK_SIZE * CHUNK_SIZE, serial.begin() + tiles * CHUNK_SIZE * CHUNK_SIZE );
+
+	for( int s = 0; s < seeds; s++ )
+	{
+		delete engines[s];
+	}
+
+	return serial == parallel && distinct;
+}
+
+// compare the noise kernels against double precision single samples
+int benchNoise( int argc, char *argv[] )
+{
+	const int tiles = (argc > 0) ? atoi(argv[0]) : 256;
+	const double scale = 1.0 / 150.0;
+
+	NoiseEngine<double> reference;
+	NoiseEngine<float> noise;
+
+	std::vector<float> ref( tiles * CHUNK_SIZE * CHUNK_SIZE );
+	std::vector<float> out( ref.size() );
+
+	benchClock::time_point start = benchClock::now();
+	for( int t = 0; t < tiles; t++ )
+	{
+		float *tile = &ref[t * CHUNK_SIZE * CHUNK_SIZE];
+
+		for( int j = 0; j < CHUNK_SIZE; j++ )
+		{
+			for( int i = 0; i < CHUNK_SIZE; i++ )
+			{
+				tile[j*CHUNK_SIZE + i] = reference.sample( (t*CHUNK_SIZE + i) * scale, j * scale, 0 );
+			}
+		}
+	}
+	double refMs = elapsedMs( start );
+
+	printf( "%-10s %10.1f Msamples/s\n", "reference", ref.size() / (refMs * 1000.0) );
+
+	const PerlinKernel kernels[] = { PERLIN_SCALAR, PERLIN_SSE2, PERLIN_AVX2 };
+	const char *names[] = { "scalar", "sse2", "avx2" };
+
+	for( int k = 0; k < 3; k++ )
+	{
+		if( !perlinKernelSupported( kernels[k] ) )
+		{
+			printf( "%-10s unsupported\n", names[k] );
+			continue;
+		}
+
+		start = benchClock::now();
+		for( int t = 0; t < tiles; t++ )
+		{
+			noise.tile( t*CHUNK_SIZE*scale, 0, scale, CHUNK_SIZE, CHUNK_SIZE, &out[t * CHUNK_SIZE * CHUNK_SIZE], kernels[k] );
+		}
+		double ms = elapsedMs( start );
+
+		double maxErr = 0;
+		for( size_t i = 0; i < out.size(); i++ )
+		{
+			maxErr = std::max( maxErr, (double)fabs( out[i] - ref[i] ) );
+		}
+
+		printf( "%-10s %10.1f Msamples/s  %5.2fx  max error %g\n", names[k], out.size() / (ms * 1000.0), refMs / ms, maxErr );
+	}
+
+	benchFractal<float>( "float", ref.size(), scale );
+	benchFractal<double>( "double", ref.size(), scale );
+
+	printf( "seeds on threads %s\n", seedsAreIndependent( tiles / 4 + 1, scale ) ? "match" : "DIFFER" );
+
+	return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * File:	benchPath.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench path: chunk generation, extraction and mesh building along a camera path
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+#include "chunkMesh.h"
+#include "chunkJob.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// float3 position and a packed colour, the vertex before ChunkVertex was packed
+#define FLOAT_VERTEX_BYTES 16
+
+// distance of the teleport in the middle of the path
+#define TELEPORT_DIST 4096
+
+// scripted camera path, fly along +x, teleport away and fly along +z
+static void cameraPath( int frame, int frames, float speed, PolyVox::Vector3DFloat &position, PolyVox::Vector3DFloat &direction )
+{
+	int turn = frames / 2;
+
+	if( frame < turn )
+	{
+		position = PolyVox::Vector3DFloat( frame * speed, 33, 0 );
+		direction = PolyVox::Vector3DFloat( 1, 0, 0 );
+	}
+	else
+	{
+		position = PolyVox::Vector3DFloat( turn * speed + TELEPORT_DIST, 33, (frame - turn) * speed );
+		direction = PolyVox::Vector3DFloat( 0, 0, 1 );
+	}
+}
+
+// fly the camera path, generating, extracting and meshing the chunks that come in range.
+// budget limits the chunks meshed per frame, like the work queue does in the game
+int benchPath( int argc, char *argv[] )
+{
+	int frames = (argc > 0) ? atoi(argv[0]) : 600;
+	float speed = (argc > 1) ? atof(argv[1]) : 2.0;
+	int budget = (argc > 2) ? atoi(argv[2]) : 4;
+	MesherType mesher = (argc > 3 && strcmp( argv[3], "greedy" ) == 0) ? MESHER_GREEDY : MESHER_CUBIC;
+
+	TerrainCore core;
+	ChunkJobPool pool( CHUNK_SIZE );
+
+	double prefetchMs = 0, snapshotMs = 0, meshMs = 0;
+	size_t chunks = 0, vertices = 0, indices = 0, bytes = 0;
+	size_t maxQueued = 0;
+	int holes = 0;
+
+	// the renderer's sections, evicted ones are reused like TerrainPager does
+	std::vector<size_t> sectionBytes;
+	std::vector<int> freeSections;
+	size_t liveBytes = 0, peakBytes = 0, peakChunks = 0;
+
+	size_t allocs = benchAllocations();
+	benchClock::time_point total = benchClock::now();
+
+	for( int frame = 0; frame < frames; frame++ )
+	{
+		PolyVox::Vector3DFloat position, direction;
+		cameraPath( frame, frames, speed, position, direction );
+
+		core.regenerate( position, direction );
+
+		const std::vector<int> &evicted = core.getEvicted();
+		for( size_t i = 0; i < evicted.size(); i++ )
+		{
+			liveBytes -= sectionBytes[ evicted[i] ];
+			sectionBytes[ evicted[i] ] = 0;
+			freeSections.push_back( evicted[i] );
+		}
+
+		maxQueued = std::max( maxQueued, core.getSchedulerStats().queued );
+
+		TerrainCore::chunkCoord coord;
+
+		for( int n = 0; (budget <= 0 || n < budget) && core.nextChunk( coord ); n++ )
+		{
+			ChunkJob *job = pool.acquire();
+			job->region = TerrainCore::toRegion( coord );
+			job->coord = coord;
+			job->mesher = mesher;
+
+			const PolyVox::Region &region = job->region;
+			const ChunkMesh &mesh = job->mesh;
+
+			// page in everything the extractor reads here so generation isn't
+			// counted as extraction time. Coarse chunks sample the generator
+			// instead
+			benchClock::time_point start = benchClock::now();
+			if( coord.lod == 0 )
+			{
+				core.prefetch( TerrainCore::toSnapshotRegion( region ) );
+			}
+			prefetchMs += elapsedMs( start );
+
+			start = benchClock::now();
+			core.snapshotJob( *job );
+			snapshotMs += elapsedMs( start );
+
+			start = benchClock::now();
+			TerrainCore::meshJob( *job );
+			meshMs += elapsedMs( start );
+
+			int meshId = core.getMeshId( coord );
+			if( meshId == -1 )
+			{
+				if( freeSections.empty() )
+				{
+					meshId = sectionBytes.size();
+					sectionBytes.push_back( 0 );
+				}
+				else
+				{
+					meshId = freeSections.back();
+					freeSections.pop_back();
+				}
+			}
+
+			liveBytes += mesh.sizeInBytes() - sectionBytes[ meshId ];
+			sectionBytes[ meshId ] = mesh.sizeInBytes();
+			peakBytes = std::max( peakBytes, liveBytes );
+
+			core.finishChunk( coord, meshId );
+
+			chunks++;
+			vertices += mesh.vertices.size();
+			indices += mesh.indexCount();
+			bytes += mesh.sizeInBytes();
+
+			pool.release( job );
+		}
+
+		peakChunks = std::max( peakChunks, core.getChunkCount() );
+
+		// a hole is the chunk one chunk ahead of the camera not being meshed
+		// yet at any level of detail
+		PolyVox::Vector3DFloat ahead = position + direction * (float)CHUNK_SIZE;
+		TerrainCore::chunkCoord below = TerrainCore::toChunkCoord( PolyVox::Vector3DInt32( ahead.getX(), 0, ahead.getZ() ) );
+
+		while( below.lod < LOD_LEVELS && core.getMeshId( below ) == -1 )
+		{
+			below = below.parent();
+		}
+		if( below.lod == LOD_LEVELS )
+		{
+			holes++;
+		}
+	}
+
+	double totalMs = elapsedMs( total );
+	allocs = benchAllocations() - allocs;
+	ChunkJobPoolStats poolStats = pool.getStats();
+	ChunkSchedulerStats stats = core.getSchedulerStats();
+
+	printf( "frames            %d (%d with a hole ahead)\n", frames, holes );
+	printf( "chunks meshed     %zu (%zu dropped, max %zu queued)\n", chunks, stats.dropped, maxQueued );
+	printf( "total             %.1f ms (%.1f chunks/s)\n", totalMs, chunks * 1000.0 / totalMs );
+	if( chunks > 0 )
+	{
+		printf( "generate/prefetch %.3f ms/chunk\n", prefetchMs / chunks );
+		printf( "snapshot          %.3f ms/chunk\n", snapshotMs / chunks );
+		printf( "mesh              %.3f ms/chunk\n", meshMs / chunks );
+		printf( "vertices          %zu (%zu indices) per chunk\n", vertices / chunks, indices / chunks );
+		printf( "mesh memory       %zu bytes per chunk\n", bytes / chunks );
+		// what the same chunks took in the older formats, float3 position and packed colour
+		printf( "  indexed float   %zu bytes per chunk\n", (vertices * FLOAT_VERTEX_BYTES + indices * sizeof(uint32_t)) / chunks );
+		printf( "  expanded float  %zu bytes per chunk\n", indices * FLOAT_VERTEX_BYTES / chunks );
+		printf( "live mesh memory  %.1f MB at end, %.1f MB peak\n", liveBytes / 1048576.0, peakBytes / 1048576.0 );
+		printf( "sections          %zu (%zu free), %zu chunks tracked at end, %zu peak\n",
+				sectionBytes.size(), freeSections.size(), core.getChunkCount(), peakChunks );
+		printf( "allocations       %.0f/s, %.1f per chunk\n", allocs * 1000.0 / totalMs, (double)allocs / chunks );
+		printf( "job pool          %zu jobs for %zu chunks, %zu regrown\n", poolStats.created, poolStats.acquired, poolStats.regrown );
+		printf( "request->visible  avg %.1f ms, p95 %.1f ms, max %.1f ms\n", stats.avgLatencyMs, stats.p95LatencyMs, stats.maxLatencyMs );
+	}
+
+	return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * File:	benchPipeline.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench pipeline: staged generate/mesh/upload against whole chunk jobs per thread
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+#include "chunkJob.h"
+#include "chunkPipeline.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+typedef TerrainCore::chunkCoord chunkCoord;
+
+struct LumpJob
+{
+	TerrainCore *core;
+	ChunkJobPool *pool;
+	const std::vector<chunkCoord> *chunks;
+	boost::atomic<size_t> next;
+};
+
+// what TerrainPager did on the Ogre WorkQueue, each request generating and
+// meshing a whole chunk
+static void lumpWorker( LumpJob *lump )
+{
+	for( size_t i = lump->next++; i < lump->chunks->size(); i = lump->next++ )
+	{
+		ChunkJob *job = lump->pool->acquire();
+		job->coord = (*lump->chunks)[i];
+		job->region = TerrainCore::toRegion( job->coord );
+
+		lump->core->extractJob( *job );
+		lump->pool->release( job );
+	}
+}
+
+static double runLump( const std::vector<chunkCoord> &chunks, int threads )
+{
+	// fresh volume every run so every chunk is generated again
+	TerrainCore core;
+	ChunkJobPool pool( CHUNK_SIZE );
+
+	LumpJob lump;
+	lump.core = &core;
+	lump.pool = &pool;
+	lump.chunks = &chunks;
+	lump.next = 0;
+
+	benchClock::time_point start = benchClock::now();
+
+	boost::thread_group group;
+	for( int t = 0; t < threads; t++ )
+	{
+		group.create_thread( boost::bind( &lumpWorker, &lump ) );
+	}
+	group.join_all();
+
+	return chunks.size() * 1000.0 / elapsedMs( start );
+}
+
+static double runPipeline( const std::vector<chunkCoord> &chunks, int threads, ChunkPipelineStats &stats )
+{
+	TerrainCore core;
+	ChunkJobPool pool( CHUNK_SIZE );
+	ChunkPipeline pipeline( core, pool, threads );
+
+	size_t next = 0, done = 0;
+
+	benchClock::time_point start = benchClock::now();
+
+	// the main thread feeds the pipeline and takes the meshes, as
+	// TerrainPager does every frame
+	while( done < chunks.size() )
+	{
+		while( next < chunks.size() && pipeline.canSubmit() )
+		{
+			ChunkJob *job = pool.acquire();
+			job->coord = chunks[next++];
+			job->region = TerrainCore::toRegion( job->coord );
+			pipeline.submit( job );
+		}
+
+		size_t uploaded = pipeline.upload( PolyVox::Vector3DFloat( 0, 0, 0 ), 1e9,
+				boost::bind( &ChunkJobPool::release, &pool, _1 ) );
+		done += uploaded;
+
+		if( uploaded == 0 )
+		{
+			boost::this_thread::yield();
+		}
+	}
+
+	double rate = chunks.size() * 1000.0 / elapsedMs( start );
+	stats = pipeline.getStats();
+
+	return rate;
+}
+
+int benchPipeline( int argc, char *argv[] )
+{
+	int maxThreads = (argc > 0) ? atoi(argv[0]) : boost::thread::hardware_concurrency();
+	int side = (argc > 1) ? atoi(argv[1]) : 8;
+
+	if( maxThreads < 1 )
+	{
+		maxThreads = 1;
+	}
+
+	// the surface chunks and the ones above and below them
+	std::vector<chunkCoord> chunks;
+	for( int x = 0; x < side; x++ )
+	{
+		for( int z = 0; z < side; z++ )
+		{
+			for( int y = -1; y <= 1; y++ )
+			{
+				chunks.push_back( chunkCoord( x, y, z ) );
+			}
+		}
+	}
+
+	for( int threads = 1; threads <= maxThreads; threads++ )
+	{
+		double lump = runLump( chunks, threads );
+
+		ChunkPipelineStats stats;
+		double staged = runPipeline( chunks, threads, stats );
+
+		printf( "%3d threads  whole jobs %7.1f chunks/s  staged %7.1f chunks/s  %5.2fx\n", threads, lump, staged, staged / lump );
+
+		static const char *names[CHUNK_STAGES] = { "generate", "mesh", "upload" };
+		for( int s = 0; s < STAGE_UPLOAD; s++ )
+		{
+			const ChunkStageStats &stage = stats.stages[s];
+
+			printf( "    %-8s %6zu chunks  %8.1f ms busy  %7.1f chunks/s per thread  peak queue %zu of %zu\n", names[s],
+					stage.processed, stage.busyMs, stage.processed * 1000.0 / stage.busyMs, stage.peakQueued, stage.capacity );
+		}
+		printf( "    upload   peak queue %zu of %zu  %zu steals\n", stats.stages[STAGE_UPLOAD].peakQueued,
+				stats.stages[STAGE_UPLOAD].capacity, stats.steals );
+	}
+
+	return 0;
+}
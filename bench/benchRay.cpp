@@ -0,0 +1,143 @@
+/*
+ * File:	benchRay.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench ray: raycast throughput of PolyVox's raycast against the occupancy raycaster
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+// blocks paged in around the origin, on a side
+#define RAY_AREA 6
+
+// rays handed to raycastBatch at once
+#define RAY_BATCH 64
+
+static float randomFloat( float lo, float hi )
+{
+	return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+// picks: from above the surface towards it, up to length voxels long
+static void makeRays( size_t count, float length, std::vector<VoxelRay> &rays )
+{
+	rays.resize( count );
+
+	for( size_t i = 0; i < count; i++ )
+	{
+		rays[i].start = PolyVox::Vector3DFloat( randomFloat( 0, RAY_AREA*CHUNK_SIZE ), randomFloat( 40, 100 ),
+				randomFloat( 0, RAY_AREA*CHUNK_SIZE ) );
+
+		PolyVox::Vector3DFloat dir( randomFloat( -1, 1 ), randomFloat( -1, 0.2f ), randomFloat( -1, 1 ) );
+		dir.normalise();
+		rays[i].dir = dir * length;
+	}
+}
+
+static void castBatches( TerrainCore *core, const std::vector<VoxelRay> *rays, int passes )
+{
+	std::vector<PolyVox::RaycastResult> results( RAY_BATCH );
+
+	for( int pass = 0; pass < passes; pass++ )
+	{
+		for( size_t i = 0; i < rays->size(); i += RAY_BATCH )
+		{
+			size_t count = std::min<size_t>( RAY_BATCH, rays->size() - i );
+			core->raycastBatch( &(*rays)[i], count, &results[0] );
+		}
+	}
+}
+
+static void run( TerrainCore &core, const char *name, float length, size_t count, int threads )
+{
+	std::vector<VoxelRay> rays;
+	makeRays( count, length, rays );
+
+	std::vector<PolyVox::RaycastResult> volumeResults( count ), results( count );
+
+	// PolyVox through the volume lock
+	benchClock::time_point start = benchClock::now();
+	for( size_t i = 0; i < count; i++ )
+	{
+		core.raycastVolume( rays[i].start, rays[i].dir, volumeResults[i] );
+	}
+	double volumeMs = elapsedMs( start );
+
+	start = benchClock::now();
+	for( size_t i = 0; i < count; i++ )
+	{
+		core.raycast( rays[i].start, rays[i].dir, results[i] );
+	}
+	double singleMs = elapsedMs( start );
+
+	start = benchClock::now();
+	castBatches( &core, &rays, 1 );
+	double batchMs = elapsedMs( start );
+
+	// the same rays from every thread at once, nothing to contend on
+	start = benchClock::now();
+	boost::thread_group group;
+	for( int t = 0; t < threads; t++ )
+	{
+		group.create_thread( boost::bind( &castBatches, &core, &rays, 1 ) );
+	}
+	group.join_all();
+	double threadsMs = elapsedMs( start );
+
+	size_t hits = 0, mismatches = 0;
+	for( size_t i = 0; i < count; i++ )
+	{
+		hits += results[i].foundIntersection;
+
+		if( results[i].foundIntersection != volumeResults[i].foundIntersection ||
+			(results[i].foundIntersection && results[i].intersectionVoxel != volumeResults[i].intersectionVoxel) )
+		{
+			mismatches++;
+		}
+	}
+
+	printf( "%-8s %6.1f voxels  PolyVox %6.2f Mrays/s  single %6.2f Mrays/s  batch %6.2f Mrays/s  %d threads %6.2f Mrays/s  %4.1f%% hit  %zu differ\n",
+			name, length, count / volumeMs / 1000, count / singleMs / 1000, count / batchMs / 1000, threads,
+			count * threads / threadsMs / 1000, 100.0 * hits / count, mismatches );
+}
+
+int benchRay( int argc, char *argv[] )
+{
+	size_t count = (argc > 0) ? atoi(argv[0]) : 100000;
+	int threads = (argc > 1) ? atoi(argv[1]) : boost::thread::hardware_concurrency();
+
+	if( threads < 1 )
+	{
+		threads = 1;
+	}
+
+	TerrainCore core;
+
+	// page the area in so both raycasters see the same voxels
+	for( int x = 0; x < RAY_AREA; x++ )
+	{
+		for( int z = 0; z < RAY_AREA; z++ )
+		{
+			core.prefetch( PolyVox::Region( PolyVox::Vector3DInt32( x*CHUNK_SIZE, -CHUNK_SIZE, z*CHUNK_SIZE ),
+						PolyVox::Vector3DInt32( (x+1)*CHUNK_SIZE - 1, 2*CHUNK_SIZE - 1, (z+1)*CHUNK_SIZE - 1 ) ) );
+		}
+	}
+
+	srand( 1 );
+
+	// CameraMan's collision probes, then the cursor pick
+	run( core, "probe", 0.5f, count, threads );
+	run( core, "pick", 200.0f, count / 10, threads );
+
+	printf( "occupancy %.1f MB\n", core.getOccupancyBytes() / 1048576.0 );
+
+	return 0;
+}
@@ -0,0 +1,347 @@
+/*
+ * File:	benchReplay.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench record/replay: drive the streaming with a recorded camera path and edits at a fixed timestep
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+#include "terrainMetrics.h"
+#include "voxelRecording.h"
+#include "chunkJob.h"
+#include "chunkPipeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+// synthetic recordings: voxels flown per second, a slow turn, and an edit
+// on the terrain ahead every so often
+#define RECORD_SPEED 120.0f
+#define RECORD_TURN 0.2f
+#define RECORD_HEIGHT 40.0f
+#define RECORD_EDIT_FRAMES 20
+#define RECORD_EDIT_RADIUS 2.0f
+
+// after the last frame the camera stays put this long for the pipeline to
+// catch up, edits still waiting then count as never remeshed
+#define REPLAY_DRAIN_SECONDS 10.0
+
+// frames between memory readings, they take the volume lock
+#define REPLAY_MEMORY_FRAMES 15
+
+// stands in for the renderer: keeps each chunk's mesh size as the memory
+// its buffers would hold, and the time every chunk took to become visible
+struct ReplayUpload
+{
+	TerrainCore *core;
+	ChunkJobPool *pool;
+	std::vector<size_t> *meshBytes;
+	std::vector<double> *visibleMs;
+
+	void operator()( ChunkJob *job ) const
+	{
+		int meshId = core->getMeshId( job->coord );
+		if( meshId == -1 )
+		{
+			meshId = meshBytes->size();
+			meshBytes->push_back( 0 );
+		}
+
+		(*meshBytes)[meshId] = job->mesh.sizeInBytes();
+
+		visibleMs->push_back( core->finishChunk( job->coord, meshId ) );
+		pool->release( job );
+	}
+};
+
+// an edit waiting for the meshed chunks it changed to be meshed again
+struct PendingEdit
+{
+	benchClock::time_point start;
+	std::vector<TerrainCore::chunkCoord> chunks;
+};
+
+static int floorDiv( int a, int b )
+{
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+// value below which p percent of sorted lie
+static double percentile( const std::vector<double> &sorted, int p )
+{
+	if( sorted.empty() )
+	{
+		return 0;
+	}
+	return sorted[ std::min( sorted.size() - 1, sorted.size() * p / 100 ) ];
+}
+
+static void printLatencies( const char *name, std::vector<double> &ms )
+{
+	std::sort( ms.begin(), ms.end() );
+
+	printf( "%-16s %6zu  p50 %8.1f  p95 %8.1f  p99 %8.1f  max %8.1f ms\n", name, ms.size(),
+			percentile( ms, 50 ), percentile( ms, 95 ), percentile( ms, 99 ), ms.empty() ? 0 : ms.back() );
+}
+
+// meshed chunks of every level the edit changed, they are remeshed once
+// no longer dirty
+static void editedChunks( TerrainCore &core, const RecordedEdit &edit, std::vector<TerrainCore::chunkCoord> &out )
+{
+	for( int lod = 0; lod < LOD_LEVELS; lod++ )
+	{
+		const int size = CHUNK_SIZE << lod;
+		int lo[3], hi[3];
+
+		for( int a = 0; a < 3; a++ )
+		{
+			// a brush border on a chunk face dirties the neighbour too
+			lo[a] = floorDiv( (int)floorf( edit.center[a] - edit.radius ) - 1, size );
+			hi[a] = floorDiv( (int)ceilf( edit.center[a] + edit.radius ) + 1, size );
+		}
+
+		for( int x = lo[0]; x <= hi[0]; x++ )
+		{
+			for( int y = lo[1]; y <= hi[1]; y++ )
+			{
+				for( int z = lo[2]; z <= hi[2]; z++ )
+				{
+					TerrainCore::chunkCoord coord( x, y, z, lod );
+
+					if( core.getMeshId( coord ) != -1 && !core.isCurrent( coord ) )
+					{
+						out.push_back( coord );
+					}
+				}
+			}
+		}
+	}
+}
+
+static int record( const char *path, double seconds )
+{
+	VoxelRecording rec;
+	TerrainCore core;
+
+	const int frames = (int)(seconds / rec.getTimestep());
+
+	for( int frame = 0; frame < frames; frame++ )
+	{
+		const float t = frame * rec.getTimestep();
+		const float yaw = RECORD_TURN * t;
+
+		// a turn about y, looking down -z at yaw 0
+		const float orientation[4] = { cosf( yaw / 2 ), 0, sinf( yaw / 2 ), 0 };
+		const float position[3] = { RECORD_SPEED * t, RECORD_HEIGHT, 0 };
+
+		if( frame % RECORD_EDIT_FRAMES == 0 )
+		{
+			// at the terrain ahead and below, adding and removing in turn
+			PolyVox::RaycastResult result;
+			core.raycast( PolyVox::Vector3DFloat( position[0], position[1], position[2] ),
+					PolyVox::Vector3DFloat( -sinf( yaw ) * 40, -40, -cosf( yaw ) * 40 ), result );
+
+			if( result.foundIntersection )
+			{
+				bool add = (frame / RECORD_EDIT_FRAMES) % 2 == 0;
+				const PolyVox::Vector3DInt32 &voxel = add ? result.previousVoxel : result.intersectionVoxel;
+
+				rec.addEdit( PolyVox::Vector3DFloat( voxel.getX(), voxel.getY(), voxel.getZ() ), RECORD_EDIT_RADIUS, add ? 1 : 0 );
+			}
+		}
+
+		rec.advance( rec.getTimestep(), position, orientation );
+	}
+
+	if( !rec.save( path ) )
+	{
+		return 1;
+	}
+
+	printf( "%s: %zu frames, %zu edits\n", path, rec.getFrames().size(), rec.getEdits().size() );
+	return 0;
+}
+
+static int replay( const char *path, int threads )
+{
+	VoxelRecording rec;
+	if( !rec.load( path ) )
+	{
+		return 1;
+	}
+
+	const std::vector<RecordedFrame> &frames = rec.getFrames();
+	const std::vector<RecordedEdit> &edits = rec.getEdits();
+
+	if( frames.empty() )
+	{
+		printf( "%s: no frames\n", path );
+		return 1;
+	}
+
+	TerrainCore core;
+	ChunkJobPool pool( CHUNK_SIZE, &core.getMetrics() );
+	ChunkPipeline pipeline( core, pool, threads );
+
+	std::vector<size_t> meshBytes;
+	std::vector<double> visibleMs;
+	std::vector<double> editMs;
+	std::vector<PendingEdit> pending;
+
+	ReplayUpload sim = { &core, &pool, &meshBytes, &visibleMs };
+
+	const std::chrono::microseconds timestep( (int64_t)(rec.getTimestep() * 1e6) );
+	const size_t drainFrames = (size_t)(REPLAY_DRAIN_SECONDS / rec.getTimestep());
+
+	size_t nextEdit = 0;
+	size_t peakVoxels = 0, peakOccupancy = 0, peakHeights = 0, peakMeshes = 0, peakTotal = 0;
+
+	benchClock::time_point begin = benchClock::now();
+	size_t frame;
+
+	for( frame = 0; frame < frames.size() + drainFrames; frame++ )
+	{
+		benchClock::time_point start = benchClock::now();
+		const RecordedFrame &camera = frames[ std::min( frame, frames.size() - 1 ) ];
+		const PolyVox::Vector3DFloat position = camera.getPosition();
+
+		if( frame >= frames.size() && pipeline.inFlight() == 0 && core.getSchedulerStats().queued == 0 && pending.empty() )
+		{
+			break;
+		}
+
+		for( ; nextEdit < edits.size() && edits[nextEdit].frame <= frame; nextEdit++ )
+		{
+			const RecordedEdit &edit = edits[nextEdit];
+
+			core.editSphere( PolyVox::Vector3DFloat( edit.center[0], edit.center[1], edit.center[2] ), edit.radius,
+					PolyVox::Material8( edit.material ) );
+
+			// edits which changed nothing visible have no latency
+			PendingEdit wait;
+			wait.start = start;
+			editedChunks( core, edit, wait.chunks );
+
+			if( !wait.chunks.empty() )
+			{
+				pending.push_back( wait );
+			}
+		}
+
+		core.regenerate( position, camera.getDirection() );
+
+		// evicted chunks give their buffers up
+		const std::vector<int> &evicted = core.getEvicted();
+		for( size_t i = 0; i < evicted.size(); i++ )
+		{
+			meshBytes[ evicted[i] ] = 0;
+		}
+
+		TerrainCore::chunkCoord coord;
+		while( pipeline.canSubmit() && core.nextChunk( coord ) )
+		{
+			ChunkJob *job = pool.acquire();
+			job->region = TerrainCore::toRegion( coord );
+			job->coord = coord;
+			job->mesher = MESHER_GREEDY;
+			pipeline.submit( job );
+		}
+
+		pipeline.upload( position, UPLOAD_BUDGET_MS, sim );
+
+		// an edit is done once each chunk it changed is meshed again or gone
+		for( size_t i = 0; i < pending.size(); )
+		{
+			std::vector<TerrainCore::chunkCoord> &chunks = pending[i].chunks;
+
+			for( size_t c = 0; c < chunks.size(); )
+			{
+				if( core.isCurrent( chunks[c] ) || core.getMeshId( chunks[c] ) == -1 )
+				{
+					chunks[c] = chunks.back();
+					chunks.pop_back();
+				}
+				else
+				{
+					c++;
+				}
+			}
+
+			if( chunks.empty() )
+			{
+				editMs.push_back( elapsedMs( pending[i].start ) );
+				pending[i] = pending.back();
+				pending.pop_back();
+			}
+			else
+			{
+				i++;
+			}
+		}
+
+		if( frame % REPLAY_MEMORY_FRAMES == 0 )
+		{
+			TerrainMetricsSample sample;
+			core.sampleMetrics( sample );
+
+			size_t meshes = 0;
+			for( size_t i = 0; i < meshBytes.size(); i++ )
+			{
+				meshes += meshBytes[i];
+			}
+
+			peakVoxels = std::max( peakVoxels, sample.voxelBytes );
+			peakOccupancy = std::max( peakOccupancy, sample.occupancyBytes );
+			peakHeights = std::max( peakHeights, sample.heightBytes );
+			peakMeshes = std::max( peakMeshes, meshes );
+			peakTotal = std::max( peakTotal, sample.voxelBytes + sample.occupancyBytes + sample.heightBytes + meshes );
+		}
+
+		std::this_thread::sleep_until( start + timestep );
+	}
+
+	struct rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+
+	printf( "%s: %zu frames at %.0f Hz, %zu edits, %zu frames to drain, %.1f s\n", path, frames.size(), 1 / rec.getTimestep(),
+			edits.size(), frame - std::min( frame, frames.size() ), elapsedMs( begin ) / 1000 );
+	printLatencies( "time to visible", visibleMs );
+	printLatencies( "edit to remesh", editMs );
+	if( !pending.empty() )
+	{
+		printf( "%zu edits never remeshed\n", pending.size() );
+	}
+	printf( "peak memory      voxels %.1f MB  occupancy %.1f MB  heights %.1f MB  meshes %.1f MB  total %.1f MB  process rss %.1f MB\n",
+			peakVoxels / 1048576.0, peakOccupancy / 1048576.0, peakHeights / 1048576.0, peakMeshes / 1048576.0, peakTotal / 1048576.0,
+			usage.ru_maxrss / 1024.0 );
+
+	return 0;
+}
+
+int benchRecord( int argc, char *argv[] )
+{
+	if( argc < 1 )
+	{
+		printf( "usage: voxel_bench record <file> [seconds]\n" );
+		return 1;
+	}
+
+	return record( argv[0], (argc > 1) ? atof(argv[1]) : 20 );
+}
+
+int benchReplay( int argc, char *argv[] )
+{
+	if( argc < 1 )
+	{
+		printf( "usage: voxel_bench replay <file> [threads]\n" );
+		return 1;
+	}
+
+	return replay( argv[0], (argc > 1) ? atoi(argv[1]) : 0 );
+}
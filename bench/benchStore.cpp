@@ -0,0 +1,106 @@
+/*
+ * File:	benchStore.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench store: edit blocks, page them out to the region store and back in
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+
+#include <cstdlib>
+#include <cstdio>
+
+// blocks paged in past the volume's limit of 1024, enough to evict every
+// edited one while the game would still be running
+#define EVICT_BLOCKS 1100
+
+static int countLost( TerrainCore &core, int side )
+{
+	int lost = 0;
+
+	for( int x = 0; x < side; x++ )
+	{
+		for( int z = 0; z < side; z++ )
+		{
+			if( core.getVoxelAt( PolyVox::Vector3DInt32( x*CHUNK_SIZE + 5, 10, z*CHUNK_SIZE + 5 ) ).getMaterial() != 0 )
+			{
+				lost++;
+			}
+		}
+	}
+	return lost;
+}
+
+int benchStore( int argc, char *argv[] )
+{
+	int side = (argc > 0) ? atoi(argv[0]) : 8;
+	const char *path = (argc > 1) ? argv[1] : "voxel_bench_world";
+
+	int blocks = side * side;
+	int lost, lostEvicted;
+	double generateMs, writeMs, loadMs;
+
+	// start from an empty world
+	{
+		RegionStore store( path, CHUNK_SIZE );
+		store.clear();
+	}
+
+	{
+		TerrainCore core( path );
+
+		benchClock::time_point start = benchClock::now();
+		for( int x = 0; x < side; x++ )
+		{
+			for( int z = 0; z < side; z++ )
+			{
+				core.prefetch( TerrainCore::toRegion( TerrainCore::chunkCoord( x, 0, z ) ) );
+			}
+		}
+		generateMs = elapsedMs( start );
+
+		// dig a hole into every block so all of them are stored
+		for( int x = 0; x < side; x++ )
+		{
+			for( int z = 0; z < side; z++ )
+			{
+				core.setVoxelAt( PolyVox::Vector3DInt32( x*CHUNK_SIZE + 5, 10, z*CHUNK_SIZE + 5 ), PolyVox::Material8(0) );
+			}
+		}
+
+		// page the edited blocks out by touching others, then back in
+		for( int i = 0; i < EVICT_BLOCKS; i++ )
+		{
+			core.prefetch( TerrainCore::toRegion( TerrainCore::chunkCoord( side + 1 + i, 0, 0 ) ) );
+		}
+		lostEvicted = countLost( core, side );
+
+		start = benchClock::now();
+		core.flushStore();
+		writeMs = elapsedMs( start );
+	}
+
+	{
+		TerrainCore core( path );
+
+		benchClock::time_point start = benchClock::now();
+		for( int x = 0; x < side; x++ )
+		{
+			for( int z = 0; z < side; z++ )
+			{
+				core.prefetch( TerrainCore::toRegion( TerrainCore::chunkCoord( x, 0, z ) ) );
+			}
+		}
+		loadMs = elapsedMs( start );
+
+		lost = countLost( core, side );
+	}
+
+	printf( "blocks            %d in %s\n", blocks, path );
+	printf( "generate          %.3f ms/block\n", generateMs / blocks );
+	printf( "write back        %.3f ms/block\n", writeMs / blocks );
+	printf( "load from store   %.3f ms/block (%.1fx faster than generating)\n", loadMs / blocks, generateMs / loadMs );
+	printf( "edits lost        %d after eviction, %d after reopening\n", lostEvicted, lost );
+
+	return (lost || lostEvicted) ? 1 : 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * File:	benchStream.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench stream: cost of the per frame streaming bookkeeping, no meshing
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+
+#include <cstdlib>
+#include <cstdio>
+
+// regenerate every frame and finish whatever got queued straight away
+static void run( TerrainCore &core, const char *name, int frames, float speed, float &x, int &nextMesh )
+{
+	size_t allocs = benchAllocations();
+	size_t queued = 0;
+
+	benchClock::time_point start = benchClock::now();
+
+	for( int frame = 0; frame < frames; frame++ )
+	{
+		x += speed;
+		core.regenerate( PolyVox::Vector3DFloat( x, 33, 0 ), PolyVox::Vector3DFloat( 1, 0, 0 ) );
+
+		TerrainCore::chunkCoord coord;
+		while( core.nextChunk( coord ) )
+		{
+			int meshId = core.getMeshId( coord );
+			core.finishChunk( coord, (meshId == -1) ? nextMesh++ : meshId );
+			queued++;
+		}
+	}
+
+	double ms = elapsedMs( start );
+	allocs = benchAllocations() - allocs;
+
+	printf( "%-12s %8.1f ns/frame  %6zu chunks queued  %zu allocations\n", name, ms * 1e6 / frames, queued, allocs );
+}
+
+int benchStream( int argc, char *argv[] )
+{
+	int frames = (argc > 0) ? atoi(argv[0]) : 100000;
+	float speed = (argc > 1) ? atof(argv[1]) : 2.0;
+
+	TerrainCore core;
+	int nextMesh = 0;
+	float x = 0;
+
+	// fill the window and get every buffer to its working size
+	run( core, "warm up", 1000, speed, x, nextMesh );
+
+	run( core, "standing", frames, 0, x, nextMesh );
+	run( core, "flying", frames, speed, x, nextMesh );
+
+	return 0;
+}
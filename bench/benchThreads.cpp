@@ -0,0 +1,90 @@
+/*
+ * File:	benchThreads.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench threads: chunk paging and extraction throughput from 1 to N threads
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+#include "chunkMesh.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+struct ThreadsJob
+{
+	TerrainCore *core;
+	const std::vector<TerrainCore::chunkCoord> *chunks;
+	boost::atomic<size_t> next;
+};
+
+static void worker( ThreadsJob *job )
+{
+	PolyVox::SurfaceMesh<PolyVox::PositionMaterial> surf_mesh;
+	ChunkMesh mesh;
+
+	for( size_t i = job->next++; i < job->chunks->size(); i = job->next++ )
+	{
+		job->core->extract( TerrainCore::toRegion( (*job->chunks)[i] ), surf_mesh );
+		buildChunkMesh( surf_mesh, mesh );
+	}
+}
+
+int benchThreads( int argc, char *argv[] )
+{
+	int maxThreads = (argc > 0) ? atoi(argv[0]) : boost::thread::hardware_concurrency();
+	int side = (argc > 1) ? atoi(argv[1]) : 8;
+
+	if( maxThreads < 1 )
+	{
+		maxThreads = 1;
+	}
+
+	std::vector<TerrainCore::chunkCoord> chunks;
+	for( int x = 0; x < side; x++ )
+	{
+		for( int z = 0; z < side; z++ )
+		{
+			chunks.push_back( TerrainCore::chunkCoord( x, 0, z ) );
+		}
+	}
+
+	double base = 0;
+
+	for( int threads = 1; threads <= maxThreads; threads++ )
+	{
+		// fresh volume every run so every chunk is generated again
+		TerrainCore core;
+
+		ThreadsJob job;
+		job.core = &core;
+		job.chunks = &chunks;
+		job.next = 0;
+
+		benchClock::time_point start = benchClock::now();
+
+		boost::thread_group group;
+		for( int t = 0; t < threads; t++ )
+		{
+			group.create_thread( boost::bind( &worker, &job ) );
+		}
+		group.join_all();
+
+		double ms = elapsedMs( start );
+		double rate = chunks.size() * 1000.0 / ms;
+
+		if( threads == 1 )
+		{
+			base = rate;
+		}
+
+		printf( "%3d threads %8.1f chunks/s  %5.2fx\n", threads, rate, rate / base );
+	}
+
+	return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * File:	benchUpload.cpp
+ * Author:	James Letendre
+ *
+ * voxel_bench upload: main thread upload time per frame after a teleport, with and without a budget
+ */
+#include "voxelBench.h"
+#include "terrainCore.h"
+#include "chunkJob.h"
+#include "chunkPipeline.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// frames at 60 per second, the workers run in between
+#define UPLOAD_FRAME_MS (1000.0 / 60)
+
+// where the camera lands, far enough that nothing around it is paged in
+#define TELEPORT_X 8192
+
+// stands in for the renderer: copies the mesh into a new buffer like
+// ChunkRenderable::update does, then spins for what the driver takes on top
+struct UploadSim
+{
+	TerrainCore *core;
+	ChunkJobPool *pool;
+	std::vector<std::vector<uint8_t> > *sections;
+	double driverUs;
+
+	void operator()( ChunkJob *job ) const
+	{
+		benchClock::time_point start = benchClock::now();
+
+		int meshId = core->getMeshId( job->coord );
+		if( meshId == -1 )
+		{
+			meshId = sections->size();
+			sections->push_back( std::vector<uint8_t>() );
+		}
+
+		std::vector<uint8_t> buffer( job->mesh.sizeInBytes() );
+		if( !job->mesh.vertices.empty() )
+		{
+			memcpy( &buffer[0], &job->mesh.vertices[0], std::min( buffer.size(), job->mesh.vertices.size() * sizeof(job->mesh.vertices[0]) ) );
+		}
+		(*sections)[meshId].swap( buffer );
+
+		core->finishChunk( job->coord, meshId );
+		pool->release( job );
+
+		while( elapsedMs( start ) * 1000 < driverUs )
+		{
+		}
+	}
+};
+
+static void run( const char *name, double budgetMs, double driverUs, int threads )
+{
+	TerrainCore core;
+	ChunkJobPool pool( CHUNK_SIZE );
+	ChunkPipeline pipeline( core, pool, threads );
+	std::vector<std::vector<uint8_t> > sections;
+
+	UploadSim sim = { &core, &pool, &sections, driverUs };
+	const PolyVox::Vector3DFloat direction( 1, 0, 0 );
+
+	std::vector<double> frameMs;
+	size_t uploaded = 0;
+	ChunkPipelineStats before = pipeline.getStats();
+
+	// settle at the origin, then teleport and stream everything around the
+	// new position in
+	for( int phase = 0; phase < 2; phase++ )
+	{
+		const PolyVox::Vector3DFloat position( phase * TELEPORT_X, 33, 0 );
+
+		if( phase == 1 )
+		{
+			before = pipeline.getStats();
+		}
+
+		for( int frame = 0; ; frame++ )
+		{
+			benchClock::time_point start = benchClock::now();
+
+			core.regenerate( position, direction );
+
+			TerrainCore::chunkCoord coord;
+			while( pipeline.canSubmit() && core.nextChunk( coord ) )
+			{
+				ChunkJob *job = pool.acquire();
+				job->region = TerrainCore::toRegion( coord );
+				job->coord = coord;
+				job->mesher = MESHER_GREEDY;
+				pipeline.submit( job );
+			}
+
+			size_t count = pipeline.upload( position, budgetMs, sim );
+
+			if( phase == 1 )
+			{
+				frameMs.push_back( pipeline.getStats().lastUploadMs );
+				uploaded += count;
+			}
+
+			if( frame > 0 && pipeline.inFlight() == 0 && core.getSchedulerStats().queued == 0 )
+			{
+				break;
+			}
+
+			std::this_thread::sleep_until( start + std::chrono::microseconds( (int)(UPLOAD_FRAME_MS * 1000) ) );
+		}
+	}
+
+	ChunkPipelineStats stats = pipeline.getStats();
+	std::sort( frameMs.begin(), frameMs.end() );
+
+	printf( "%-10s %5zu chunks in %4zu frames  upload ms/frame  p50 %6.2f  p99 %6.2f  max %6.2f  %6zu deferred over %4zu frames\n",
+			name, uploaded, frameMs.size(), frameMs[ frameMs.size() / 2 ], frameMs[ frameMs.size() * 99 / 100 ], frameMs.back(),
+			stats.deferred - before.deferred, stats.deferredFrames - before.deferredFrames );
+}
+
+int benchUpload( int argc, char *argv[] )
+{
+	double budgetMs = (argc > 0) ? atof(argv[0]) : UPLOAD_BUDGET_MS;
+	double driverUs = (argc > 1) ? atof(argv[1]) : 500;
+	int threads = (argc > 2) ? atoi(argv[2]) : 8;
+
+	char name[32];
+	snprintf( name, sizeof(name), "%.1f ms", budgetMs );
+
+	run( "unbudgeted", 1e9, driverUs, threads );
+	run( name, budgetMs, driverUs, threads );
+
+	return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * File:	voxelBench.cpp
+ * Author:	James Letendre
+ *
+ * Headless benchmarks of the terrain core
+ */
+#include "voxelBench.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#include <boost/atomic.hpp>
+
+static boost::atomic<size_t> allocations(0);
+
+// count every heap allocation so modes can check their steady state allocates nothing
+void* operator new( size_t size )
+{
+	allocations++;
+
+	void *ptr = malloc( size ? size : 1 );
+	if( !ptr )
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete( void *ptr ) throw()
+{
+	free( ptr );
+}
+
+size_t benchAllocations()
+{
+	return allocations.load();
+}
+
+int main( int argc, char *argv[] )
+{
+	if( argc > 1 && strcmp( argv[1], "noise" ) == 0 )
+	{
+		return benchNoise( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "table" ) == 0 )
+	{
+		return benchChunkTable( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "threads" ) == 0 )
+	{
+		return benchThreads( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "mesher" ) == 0 )
+	{
+		return benchMesher( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "store" ) == 0 )
+	{
+		return benchStore( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "stream" ) == 0 )
+	{
+		return benchStream( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "edit" ) == 0 )
+	{
+		return benchEdit( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "lod" ) == 0 )
+	{
+		return benchLod( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "cull" ) == 0 )
+	{
+		return benchCull( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "heights" ) == 0 )
+	{
+		return benchHeights( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "fill" ) == 0 )
+	{
+		return benchFill( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "record" ) == 0 )
+	{
+		return benchRecord( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "replay" ) == 0 )
+	{
+		return benchReplay( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "metrics" ) == 0 )
+	{
+		return benchMetrics( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "upload" ) == 0 )
+	{
+		return benchUpload( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "pipeline" ) == 0 )
+	{
+		return benchPipeline( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "collide" ) == 0 )
+	{
+		return benchCollide( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "ray" ) == 0 )
+	{
+		return benchRay( argc - 2, argv + 2 );
+	}
+	if( argc > 1 && strcmp( argv[1], "path" ) == 0 )
+	{
+		return benchPath( argc - 2, argv + 2 );
+	}
+	return benchPath( argc - 1, argv + 1 );
+}
@@ -0,0 +1,44 @@
+/*
+ * File:	voxelBench.h
+ * Author:	James Letendre
+ *
+ * Shared helpers for the voxel_bench modes
+ */
+#ifndef VOXEL_BENCH_H
+#define VOXEL_BENCH_H
+
+#include <chrono>
+#include <cstddef>
+
+typedef std::chrono::high_resolution_clock benchClock;
+
+inline double elapsedMs( const benchClock::time_point &start )
+{
+	return std::chrono::duration<double, std::milli>( benchClock::now() - start ).count();
+}
+
+// number of heap allocations made by the process so far
+size_t benchAllocations();
+
+// bench modes, argv holds only the arguments of the mode
+int benchPath( int argc, char *argv[] );
+int benchNoise( int argc, char *argv[] );
+int benchChunkTable( int argc, char *argv[] );
+int benchThreads( int argc, char *argv[] );
+int benchMesher( int argc, char *argv[] );
+int benchStore( int argc, char *argv[] );
+int benchStream( int argc, char *argv[] );
+int benchEdit( int argc, char *argv[] );
+int benchLod( int argc, char *argv[] );
+int benchCull( int argc, char *argv[] );
+int benchRay( int argc, char *argv[] );
+int benchCollide( int argc, char *argv[] );
+int benchPipeline( int argc, char *argv[] );
+int benchUpload( int argc, char *argv[] );
+int benchMetrics( int argc, char *argv[] );
+int benchRecord( int argc, char *argv[] );
+int benchReplay( int argc, char *argv[] );
+int benchHeights( int argc, char *argv[] );
+int benchFill( int argc, char *argv[] );
+
+#endif
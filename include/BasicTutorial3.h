@@ -20,9 +20,9 @@ This source file is part of the
 #include "BaseApplication.h"
 
 #include "terrainPager.h"
+#include "voxelRecording.h"
  
 #include <PolyVoxCore/SimpleInterface.h>
-#include <PolyVoxCore/LargeVolume.h>
 #include <PolyVoxCore/Material.h>
 
 class BasicTutorial3 : public BaseApplication
@@ -31,8 +31,18 @@ private:
 	TerrainPager *terrain;
 	Ogre::SceneNode *mCursor;
 
+	// streaming timers, queues and memory, toggled with N
+	OgreBites::ParamsPanel *mTerrainPanel;
+	Ogre::Real mTerrainPanelAge;
+
+	// camera path and edits for voxel_bench replay, toggled with F9
+	VoxelRecording mRecording;
+	bool mRecordingOn;
+
 	void doTerrainUpdate();
 	void createCursor( float radius );
+	void updateTerrainPanel();
+	void toggleRecording();
 
 public:
     BasicTutorial3(void);
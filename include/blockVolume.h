@@ -0,0 +1,140 @@
+/*
+ * File:	blockVolume.h
+ * Author:	James Letendre
+ *
+ * Paged volume of material blocks, run length compressed when not in use
+ */
+#ifndef BLOCK_VOLUME_H
+#define BLOCK_VOLUME_H
+
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include <PolyVoxCore/Material.h>
+#include <PolyVoxCore/Region.h>
+#include <PolyVoxCore/Vector.h>
+
+#include <boost/function.hpp>
+
+// Stands in for PolyVox's LargeVolume, whose blocks are out of reach of the
+// paging callbacks. Blocks are blockSize^3 materials, x fastest then y then
+// z like the region store's. The most recently used blocks are plain
+// arrays, the rest runs of (length-1, material). Past a limit the least
+// recently used blocks are paged out through the unload callback, touching
+// them again pages them in through the load callback. Not thread safe
+class BlockVolume
+{
+	public:
+		// a block handed to the paging callbacks, or to a caller writing
+		// it through its array
+		class Block
+		{
+			public:
+				// the voxels as an array, decompressed if needed
+				uint8_t *voxels();
+
+				// an array for a caller which writes every voxel, its
+				// contents are left undefined
+				uint8_t *overwrite();
+
+				// every voxel material, kept as runs without an array
+				void fill( uint8_t material );
+
+				// copy the voxels out, whichever form the block is in
+				void copyTo( uint8_t *out ) const;
+
+			private:
+				friend class BlockVolume;
+
+				BlockVolume *volume;
+				int bx, by, bz;
+
+				// NULL while the block is kept as runs, no runs are all empty
+				uint8_t *plain;
+				std::vector<uint8_t> runs;
+
+				uint64_t lastUse;
+		};
+
+		// called with the block and its region in voxels
+		typedef boost::function<void( Block &block, const PolyVox::Region &region )> PagingHandler;
+
+		// blockSize is a power of two
+		BlockVolume( const PagingHandler &load, const PagingHandler &unload, int blockSize );
+
+		// pages every block out
+		~BlockVolume();
+
+		PolyVox::Material8 getVoxelAt( int32_t x, int32_t y, int32_t z );
+		PolyVox::Material8 getVoxelAt( const PolyVox::Vector3DInt32 &pos )
+		{
+			return getVoxelAt( pos.getX(), pos.getY(), pos.getZ() );
+		}
+		void setVoxelAt( int32_t x, int32_t y, int32_t z, PolyVox::Material8 mat );
+
+		// the block at block coordinates, paged in if needed. Its array stays
+		// valid until another block is paged in or decompressed
+		Block &getBlock( int bx, int by, int bz )
+		{
+			return block( bx, by, bz );
+		}
+
+		// page in every block the region touches
+		void prefetch( const PolyVox::Region &region );
+
+		// page out every block
+		void flushAll();
+
+		// blocks kept at all, and of those the ones kept as arrays
+		void setMaxNumberOfBlocksInMemory( size_t blocks );
+		void setMaxNumberOfUncompressedBlocks( size_t blocks );
+
+		size_t calculateSizeInBytes() const;
+
+		// the volume is unbounded
+		PolyVox::Region getEnclosingRegion() const;
+
+	private:
+		// the block, paged in if needed, and marked as used
+		Block &block( int bx, int by, int bz );
+
+		// page out the least recently used block
+		void evictOldest();
+		void unload( Block &b );
+
+		// make room for one more array, compressing the least recently used
+		void reservePlain();
+		void compressOldest( size_t keep );
+		void compress( Block &b );
+
+		uint8_t *allocPlain();
+		void freePlain( uint8_t *plain );
+
+		static uint64_t key( int bx, int by, int bz );
+
+		PagingHandler loadHandler;
+		PagingHandler unloadHandler;
+
+		int blockSize;
+		int blockShift;
+		size_t blockVoxels;
+
+		size_t maxBlocks;
+		size_t maxUncompressed;
+
+		std::unordered_map<uint64_t, Block> blocks;
+		size_t uncompressed;
+		uint64_t useClock;
+
+		// the block of the previous access, most go to the same one
+		Block *last;
+		uint64_t lastKey;
+
+		// arrays of compressed blocks, reused
+		std::vector<uint8_t*> spare;
+		std::vector<uint8_t> encoded;
+};
+
+#endif
@@ -111,7 +111,11 @@ class CameraMan
 		bool mJump;
 		bool mFastMove;
 
+		// player's box, charHeight below the eye, charHeadroom above it and
+		// charRadius to each side
 		double charHeight;
+		double charRadius;
+		double charHeadroom;
 		double fallSpeedMax;
 		double jumpSpeed;
 		double gravityAccel;
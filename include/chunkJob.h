@@ -0,0 +1,98 @@
+/*
+ * File:	chunkJob.h
+ * Author:	James Letendre
+ *
+ * Buffers of a single chunk extraction, recycled through a pool
+ */
+#ifndef CHUNK_JOB_H
+#define CHUNK_JOB_H
+
+#include "chunkTable.h"
+#include "chunkMesh.h"
+#include "terrainMetrics.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <PolyVoxCore/RawVolume.h>
+#include <PolyVoxCore/SurfaceMesh.h>
+#include <PolyVoxCore/Material.h>
+
+#include <boost/thread/mutex.hpp>
+
+// surface extraction used for chunk meshes
+enum MesherType
+{
+	MESHER_CUBIC,		// PolyVox CubicSurfaceExtractor, one quad per voxel face
+	MESHER_GREEDY		// merges coplanar faces of the same material
+};
+
+// everything needed to extract one chunk, kept between chunks so the
+// buffers only grow until they fit the largest chunk
+struct ChunkJob
+{
+	// chunkSize is the width of a chunk in voxels
+	explicit ChunkJob( int chunkSize );
+
+	// world region and coordinates of the chunk
+	PolyVox::Region region;
+	ChunkTable::chunkCoord coord;
+	MesherType mesher;
+
+	// copy of the chunk and a one voxel border, in chunk local coordinates
+	PolyVox::RawVolume<PolyVox::Material8> snap;
+
+	// cubic mesher output, converted into mesh
+	PolyVox::SurfaceMesh<PolyVox::PositionMaterial> surf_mesh;
+
+	// greedy mesher working space
+	std::vector<uint8_t> scratch;
+
+	ChunkMesh mesh;
+};
+
+struct ChunkJobPoolStats
+{
+	// jobs ever created, and the ones waiting in the pool
+	size_t created;
+	size_t free;
+
+	// jobs handed out
+	size_t acquired;
+
+	// jobs which came back with a buffer grown past what they were given
+	size_t regrown;
+
+	// largest chunk seen so far, new jobs are reserved to this
+	size_t maxVertices;
+	size_t maxIndices;
+};
+
+class ChunkJobPool
+{
+	public:
+		// new and regrown jobs are counted into metrics if given
+		explicit ChunkJobPool( int chunkSize, TerrainMetrics *metrics = NULL );
+		~ChunkJobPool();
+
+		// a job from the pool, or a new one if it is empty. Safe from any thread
+		ChunkJob *acquire();
+
+		// give the job back once its mesh has been uploaded
+		void release( ChunkJob *job );
+
+		ChunkJobPoolStats getStats();
+
+	private:
+		// reserve the buffers of the job for the largest chunk seen
+		void reserve( ChunkJob *job );
+
+		int chunkSize;
+		TerrainMetrics *metrics;
+
+		boost::mutex mutex;
+		std::vector<ChunkJob*> freeJobs;
+		ChunkJobPoolStats stats;
+};
+
+#endif
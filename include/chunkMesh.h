@@ -0,0 +1,106 @@
+/*
+ * File:	chunkMesh.h
+ * Author:	James Letendre
+ *
+ * Renderer independent mesh of a single terrain chunk
+ */
+#ifndef CHUNK_MESH_H
+#define CHUNK_MESH_H
+
+#include <vector>
+#include <cstdint>
+
+#include <PolyVoxCore/SurfaceMesh.h>
+#include <PolyVoxCore/RawVolume.h>
+#include <PolyVoxCore/Material.h>
+
+// 8 byte vertex, uploaded to the renderer as is. Cube corners sit half a voxel
+// off the voxel centres, so the position is stored chunk relative plus half a
+// voxel which puts every corner on an integer in 0..chunk size (at most 255)
+struct ChunkVertex
+{
+	uint8_t x, y, z;
+
+	// always 1, read by the shader as the homogeneous coordinate
+	uint8_t w;
+
+	uint8_t material;
+	uint8_t pad[3];
+};
+
+// direction a face points in, the triangles of a mesh are grouped by it
+enum ChunkFace
+{
+	FACE_NEG_X,
+	FACE_POS_X,
+	FACE_NEG_Y,
+	FACE_POS_Y,
+	FACE_NEG_Z,
+	FACE_POS_Z,
+	CHUNK_FACES
+};
+
+struct ChunkMesh
+{
+	ChunkMesh() : lod(0)
+	{
+		for( int i = 0; i < 3; i++ )
+		{
+			boundsLo[i] = boundsHi[i] = 0;
+		}
+		for( int i = 0; i <= CHUNK_FACES; i++ )
+		{
+			faceStart[i] = 0;
+		}
+	}
+
+	// region the mesh was extracted from, vertex (0,0,0) is half a voxel below
+	// its lower corner
+	PolyVox::Region region;
+
+	// level of detail, one vertex unit is 1 << lod voxels
+	int lod;
+
+	// unique vertices of the surface, shared between faces through the indices
+	std::vector<ChunkVertex> vertices;
+
+	// triangle list, 16 bit if there are few enough vertices, otherwise 32 bit.
+	// Only one of them is filled
+	std::vector<uint16_t> indices16;
+	std::vector<uint32_t> indices32;
+
+	// extent of the vertices, in vertex units. Set by groupChunkFaces
+	uint8_t boundsLo[3], boundsHi[3];
+
+	// the triangles facing ChunkFace f are indices faceStart[f] up to
+	// faceStart[f+1]. Set by groupChunkFaces
+	uint32_t faceStart[CHUNK_FACES + 1];
+
+	void clear() { vertices.clear(); indices16.clear(); indices32.clear(); }
+	size_t indexCount() const { return indices16.size() + indices32.size(); }
+	size_t sizeInBytes() const
+	{
+		return vertices.size() * sizeof(ChunkVertex) + indices16.size() * sizeof(uint16_t) + indices32.size() * sizeof(uint32_t);
+	}
+};
+
+// convert an extracted surface into an indexed mesh of chunk relative vertices
+void buildChunkMesh( const PolyVox::SurfaceMesh<PolyVox::PositionMaterial> &surf_mesh, ChunkMesh &mesh );
+
+// append the four vertices of a quad spanning w along axis u and h along
+// axis v from origin, facing +d if side > 0 and -d otherwise. u x v must
+// point along +d. Indices are left to the caller
+void addChunkQuad( ChunkMesh &mesh, const int origin[3], int u, int v, int w, int h, int side, uint8_t material );
+
+// close the cracks between chunks of different detail: on the four sides of
+// the region, faces hidden by the border of the snapshot are added anyway
+// down to depth voxels below the top of each column
+void addSkirts( PolyVox::RawVolume<PolyVox::Material8> &snap, const PolyVox::Region &region, int depth, ChunkMesh &mesh );
+
+// sort the triangles of a finished mesh by the direction they face and
+// compute its bounds, so the renderer can cull both. Faces must be axis
+// aligned and wound counter clockwise. scratch is working space
+void groupChunkFaces( ChunkMesh &mesh, std::vector<uint8_t> &scratch );
+
+#endif
+
@@ -0,0 +1,230 @@
+/*
+ * File:	chunkPipeline.h
+ * Author:	James Letendre
+ *
+ * Generate, mesh and upload stages for chunk jobs on a work stealing thread pool
+ */
+#ifndef CHUNK_PIPELINE_H
+#define CHUNK_PIPELINE_H
+
+#include "chunkJob.h"
+#include "terrainMetrics.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+
+class TerrainCore;
+
+// main thread time per frame spent uploading meshes, see ChunkPipeline::upload
+#define UPLOAD_BUDGET_MS 2.0
+
+typedef std::chrono::steady_clock pipelineClock;
+
+enum ChunkStage
+{
+	STAGE_GENERATE,		// page in or sample the voxels, TerrainCore::snapshotJob
+	STAGE_MESH,			// extract the surface, TerrainCore::meshJob
+	STAGE_UPLOAD,		// main thread hands the mesh to the renderer
+	CHUNK_STAGES
+};
+
+struct ChunkStageStats
+{
+	// jobs waiting for the stage now, the most ever waiting, and the most
+	// allowed in the stage, waiting or being worked on
+	size_t queued;
+	size_t peakQueued;
+	size_t capacity;
+
+	// jobs through the stage and the time spent on them, summed over threads
+	size_t processed;
+	double busyMs;
+};
+
+struct ChunkPipelineStats
+{
+	ChunkStageStats stages[CHUNK_STAGES];
+
+	// jobs a worker took from another worker's queue
+	size_t steals;
+
+	// meshes left for a later frame by upload, summed over frames, and the
+	// frames which left any
+	size_t deferred;
+	size_t deferredFrames;
+
+	// main thread time of the last and the longest upload call
+	double lastUploadMs;
+	double maxUploadMs;
+
+	int threads;
+};
+
+// Every worker has a queue per stage. Submitted jobs are dealt out over the
+// generate queues, a generated job goes on the mesh queue of the worker which
+// generated it and a meshed one on the upload queue the main thread empties.
+// Workers take mesh work before generate work, their own before stealing from
+// the others, so one chunk is generated while the last one is meshed. A job
+// only enters a stage once the next one has room for it, so no stage holds
+// more than its capacity and a slow main thread stalls the workers instead
+// of piling up meshes
+class ChunkPipeline
+{
+	public:
+		// threads 0 is one per hardware thread, capacity 0 is two jobs per
+		// thread in each stage. Jobs left over at destruction go back to pool
+		ChunkPipeline( TerrainCore &core, ChunkJobPool &pool, int threads = 0, size_t capacity = 0 );
+		~ChunkPipeline();
+
+		// false if the generate stage is full
+		bool canSubmit() const { return slots[STAGE_GENERATE].load() < capacity; }
+
+		// queue the job for generation, false if the generate stage is full
+		bool submit( ChunkJob *job );
+
+		// hand meshed jobs to uploadJob( job ), the chunk nearest position
+		// first, until budgetMs have gone by. At least one is uploaded so the
+		// queue always moves, the rest wait for the next call. The job belongs
+		// to uploadJob afterwards. Returns the number uploaded. Main thread only
+		template <typename Upload>
+		size_t upload( const PolyVox::Vector3DFloat &position, double budgetMs, Upload uploadJob )
+		{
+			pipelineClock::time_point start = pipelineClock::now();
+			collectMeshed();
+
+			size_t count = 0;
+			double ms = 0;
+
+			while( !ready.empty() && (count == 0 || ms < budgetMs) )
+			{
+				// only a few jobs fit in the stage, a scan is cheaper than keeping them sorted
+				size_t nearest = 0;
+				float best = distanceTo( ready[0]->region, position );
+
+				for( size_t i = 1; i < ready.size(); i++ )
+				{
+					float d = distanceTo( ready[i]->region, position );
+					if( d < best )
+					{
+						best = d;
+						nearest = i;
+					}
+				}
+
+				ChunkJob *job = ready[nearest];
+				ready[nearest] = ready.back();
+				ready.pop_back();
+
+				{
+					TerrainTimerScope timer( &metrics, TIMER_UPLOAD );
+					uploadJob( job );
+				}
+				uploadedOne();
+				count++;
+
+				ms = std::chrono::duration<double, std::milli>( pipelineClock::now() - start ).count();
+			}
+
+			finishUpload( ms );
+			return count;
+		}
+
+		// meshed jobs waiting for upload
+		size_t uploadsWaiting();
+
+		// jobs submitted and not uploaded yet
+		size_t inFlight() const { return submitted.load() - popped.load(); }
+
+		int getThreads() const { return workers.size(); }
+
+		ChunkPipelineStats getStats() const;
+
+	private:
+		struct Worker
+		{
+			boost::mutex mutex;
+			std::deque<ChunkJob*> queues[STAGE_UPLOAD];
+		};
+
+		void workerLoop( size_t self );
+
+		// generate or mesh a job if there is one the next stage has room for
+		bool runOne( size_t self );
+
+		// a job of stage from self's queue, or stolen from another worker
+		bool take( size_t self, int stage, ChunkJob *&job );
+
+		// room for one more job in the stage, false if it is full
+		bool reserve( int stage );
+		void unreserve( int stage ) { slots[stage]--; }
+
+		void push( size_t worker, int stage, ChunkJob *job );
+
+		// wake sleeping workers, something changed they may be waiting for
+		void notify();
+
+		void queuedChanged( int stage, int delta );
+
+		// move what the workers meshed to ready
+		void collectMeshed();
+
+		// account for one uploaded job, and for the end of an upload call
+		void uploadedOne();
+		void finishUpload( double ms );
+
+		// distance from p to the nearest point of region, 0 inside it
+		static float distanceTo( const PolyVox::Region &region, const PolyVox::Vector3DFloat &p );
+
+		TerrainCore &core;
+		ChunkJobPool &pool;
+		TerrainMetrics &metrics;
+
+		size_t capacity;
+
+		std::vector<Worker*> workers;
+		boost::thread_group threads;
+
+		// meshed jobs in order, then moved to ready by the main thread. Both
+		// count towards the upload stage
+		boost::mutex upload_mutex;
+		std::deque<ChunkJob*> uploads;
+		std::vector<ChunkJob*> ready;
+
+		// main thread only
+		size_t deferred;
+		size_t deferredFrames;
+		double lastUploadMs;
+		double maxUploadMs;
+
+		// jobs holding a place in each stage, queued or being worked on. A
+		// place is taken before the job enters the stage and given back when
+		// it leaves
+		std::atomic<size_t> slots[CHUNK_STAGES];
+
+		std::atomic<size_t> queued[CHUNK_STAGES];
+		std::atomic<size_t> peakQueued[CHUNK_STAGES];
+		std::atomic<size_t> processed[CHUNK_STAGES];
+		std::atomic<uint64_t> busyNs[CHUNK_STAGES];
+		std::atomic<size_t> steals;
+
+		std::atomic<size_t> submitted;
+		std::atomic<size_t> popped;
+		size_t nextWorker;
+
+		// workers sleep here when there is nothing they can do, epoch changes
+		// whenever there may be
+		boost::mutex wake_mutex;
+		boost::condition_variable wake_cond;
+		uint64_t epoch;
+		bool stopping;
+};
+
+#endif
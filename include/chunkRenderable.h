@@ -0,0 +1,74 @@
+/*
+ * File:	chunkRenderable.h
+ * Author:	James Letendre
+ *
+ * Indexed hardware buffer mesh of a single terrain chunk
+ */
+#ifndef CHUNK_RENDERABLE_H
+#define CHUNK_RENDERABLE_H
+
+#include "chunkMesh.h"
+#include "chunkVisibility.h"
+
+#include <OgreSimpleRenderable.h>
+#include <OgreHardwareVertexBuffer.h>
+#include <OgreHardwareIndexBuffer.h>
+
+class ChunkRenderable : public Ogre::SimpleRenderable
+{
+	public:
+		ChunkRenderable( const Ogre::String &material );
+		virtual ~ChunkRenderable();
+
+		// copy the mesh into the hardware buffers, growing them if needed, and
+		// move the parent node to the chunk. Must be attached to its own node
+		void update( const ChunkMesh &mesh );
+
+		// draw nothing but keep the buffers for the next chunk
+		void clear();
+
+		// size of the hardware buffers
+		size_t getBufferBytes() const;
+
+		// SimpleRenderable interface
+		virtual Ogre::Real getSquaredViewDepth( const Ogre::Camera *cam ) const;
+		virtual Ogre::Real getBoundingRadius() const;
+
+		// queue only the face directions which can be seen from the camera
+		virtual void _notifyCurrentCamera( Ogre::Camera *cam );
+		virtual void _updateRenderQueue( Ogre::RenderQueue *queue );
+
+	private:
+		// a range of the chunk's indices drawn with its vertices and material
+		class FaceRange : public Ogre::Renderable
+		{
+			public:
+				FaceRange() : owner(NULL) {}
+
+				ChunkRenderable *owner;
+				Ogre::IndexData indexData;
+
+				virtual const Ogre::MaterialPtr &getMaterial() const { return owner->getMaterial(); }
+				virtual void getRenderOperation( Ogre::RenderOperation &op );
+				virtual void getWorldTransforms( Ogre::Matrix4 *xform ) const { owner->getWorldTransforms( xform ); }
+				virtual Ogre::Real getSquaredViewDepth( const Ogre::Camera *cam ) const { return owner->getSquaredViewDepth( cam ); }
+				virtual const Ogre::LightList &getLights() const { return owner->queryLights(); }
+		};
+
+		FaceRange ranges[CHUNK_MAX_RANGES];
+
+		// index ranges of the face directions, see ChunkMesh
+		uint32_t faceStart[CHUNK_FACES + 1];
+
+		// camera being rendered for
+		Ogre::Camera *viewCamera;
+
+		// make room for at least this many vertices and indices of the type
+		void reserve( size_t vertexCount, size_t indexCount, Ogre::HardwareIndexBuffer::IndexType indexType );
+
+		size_t vertexCapacity;
+		size_t indexCapacity;
+		Ogre::HardwareIndexBuffer::IndexType indexType;
+};
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * File:	chunkScheduler.h
+ * Author:	James Letendre
+ *
+ * Orders pending chunk work by distance and view direction
+ */
+#ifndef CHUNK_SCHEDULER_H
+#define CHUNK_SCHEDULER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include <PolyVoxCore/Vector.h>
+
+#include "chunkTable.h"
+
+struct ChunkSchedulerStats
+{
+	// chunks waiting to be handed out
+	size_t queued;
+
+	// chunks thrown away because they left the view range before being handed out
+	size_t dropped;
+
+	// chunks which made it to the screen
+	size_t completed;
+
+	// time from request to visible over the most recent chunks
+	double avgLatencyMs;
+	double p95LatencyMs;
+	double maxLatencyMs;
+};
+
+class ChunkScheduler
+{
+	public:
+		typedef ChunkTable::chunkCoord chunkCoord;
+
+		// chunkSize is the width of a chunk in voxels, capacity the number of
+		// chunks usually queued at once
+		explicit ChunkScheduler( int chunkSize, size_t capacity = 0 );
+
+		// camera moved, pending chunks are re-prioritized on the next pop
+		void setView( const PolyVox::Vector3DFloat &position, const PolyVox::Vector3DFloat &direction );
+
+		// queue the chunk, it must not already be queued
+		void push( const chunkCoord &coord );
+
+		// most important queued chunk, false if nothing is queued
+		bool pop( chunkCoord &coord );
+
+		// remove every queued chunk unwanted( coord ) is true for
+		template <typename Predicate>
+		void dropIf( Predicate unwanted, std::vector<chunkCoord> &out )
+		{
+			size_t kept = 0;
+
+			for( size_t i = 0; i < heap.size(); i++ )
+			{
+				if( unwanted( heap[i].coord ) )
+				{
+					out.push_back( heap[i].coord );
+					dropped++;
+				}
+				else
+				{
+					heap[kept++] = heap[i];
+				}
+			}
+
+			if( kept != heap.size() )
+			{
+				heap.resize( kept );
+				stale = true;
+			}
+		}
+
+		// a chunk requested latencyMs ago is now visible
+		void chunkVisible( double latencyMs );
+
+		size_t size() const { return heap.size(); }
+
+		ChunkSchedulerStats getStats() const;
+
+	private:
+		struct Entry
+		{
+			chunkCoord coord;
+			float priority;
+
+			// heap puts the largest first, we want the lowest priority value
+			bool operator<( const Entry &rhs ) const { return priority > rhs.priority; }
+		};
+
+		// lower is more important
+		float priority( const chunkCoord &coord ) const;
+
+		void reprioritize();
+
+		std::vector<Entry> heap;
+
+		int chunkSize;
+		PolyVox::Vector3DFloat viewPosition;
+		PolyVox::Vector3DFloat viewDirection;
+		bool stale;
+
+		size_t dropped;
+		size_t completed;
+
+		// ring buffer of the most recent request to visible latencies
+		std::vector<float> latencies;
+		size_t latencyNext;
+
+		// scratch for the percentiles
+		mutable std::vector<float> sorted;
+};
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * File:	chunkTable.h
+ * Author:	James Letendre
+ *
+ * Open addressed hash table holding the state of every known chunk
+ */
+#ifndef CHUNK_TABLE_H
+#define CHUNK_TABLE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// a chunk of level of detail lod covers chunkSize << lod voxels on each axis,
+// starting at its coordinates times that
+struct ChunkCoord
+{
+	int x, y, z;
+	int lod;
+
+	ChunkCoord() : x(0), y(0), z(0), lod(0) {}
+	ChunkCoord( int x, int y, int z, int lod = 0 ) : x(x), y(y), z(z), lod(lod) {}
+
+	bool operator==( const ChunkCoord &rhs ) const { return x == rhs.x && y == rhs.y && z == rhs.z && lod == rhs.lod; }
+	bool operator!=( const ChunkCoord &rhs ) const { return !(*this == rhs); }
+
+	bool operator<( const ChunkCoord &rhs ) const
+	{
+		if( lod != rhs.lod ) return lod < rhs.lod;
+		if( x != rhs.x ) return x < rhs.x;
+		if( y != rhs.y ) return y < rhs.y;
+		return z < rhs.z;
+	}
+
+	// the chunk of the next coarser level holding this one
+	ChunkCoord parent() const
+	{
+		return ChunkCoord( x >> 1, y >> 1, z >> 1, lod + 1 );
+	}
+};
+
+enum ChunkState
+{
+	CHUNK_FREE,			// unused table slot
+	CHUNK_NEW,			// known, never meshed
+	CHUNK_QUEUED,		// waiting in the scheduler
+	CHUNK_PROCESSING,	// being extracted
+	CHUNK_MESHED		// mesh is up to date unless dirty
+};
+
+struct ChunkRecord
+{
+	uint64_t key;
+
+	// renderer mesh the chunk lives in, -1 if none
+	int meshId;
+
+	uint8_t state;
+
+	// voxels changed since the chunk was queued
+	bool dirty;
+
+	// bumped on every change to the voxels of the chunk
+	uint32_t version;
+
+	// when the chunk was queued, microseconds of the steady clock
+	uint64_t requested;
+};
+
+class ChunkTable
+{
+	public:
+		typedef ChunkCoord chunkCoord;
+
+		// capacity is rounded up to a power of two
+		explicit ChunkTable( size_t capacity = 1024 );
+
+		// record of the chunk, NULL if it isn't in the table
+		ChunkRecord *find( const chunkCoord &coord )
+		{
+			uint64_t key = packKey( coord );
+
+			for( size_t i = hash(key) & mask;; i = (i + 1) & mask )
+			{
+				ChunkRecord &rec = slots[i];
+
+				if( rec.state == CHUNK_FREE )
+				{
+					return NULL;
+				}
+				if( rec.key == key )
+				{
+					return &rec;
+				}
+			}
+		}
+
+		// record of the chunk, added as CHUNK_NEW if it isn't in the table
+		ChunkRecord &insert( const chunkCoord &coord )
+		{
+			uint64_t key = packKey( coord );
+
+			for( size_t i = hash(key) & mask;; i = (i + 1) & mask )
+			{
+				ChunkRecord &rec = slots[i];
+
+				if( rec.key == key && rec.state != CHUNK_FREE )
+				{
+					return rec;
+				}
+				if( rec.state == CHUNK_FREE )
+				{
+					// keep the load factor under 1/2 so probes stay short
+					if( (count + 1) * 2 > slots.size() )
+					{
+						grow();
+						return insert( coord );
+					}
+
+					rec.key = key;
+					rec.meshId = -1;
+					rec.state = CHUNK_NEW;
+					rec.dirty = false;
+					rec.version = 0;
+					rec.requested = 0;
+					count++;
+					return rec;
+				}
+			}
+		}
+
+		// remove the chunk, returns false if it wasn't in the table
+		bool erase( const chunkCoord &coord );
+
+		void clear();
+
+		size_t size() const { return count; }
+		size_t capacity() const { return slots.size(); }
+
+		// slot access for iterating, free slots have state CHUNK_FREE
+		ChunkRecord &slot( size_t i ) { return slots[i]; }
+
+		// level of detail in the top 4 bits, then 20 bits per axis
+		static uint64_t packKey( const chunkCoord &coord )
+		{
+			return ((uint64_t)coord.lod << 60) | ((uint64_t)(coord.x & 0xfffff) << 40) |
+				((uint64_t)(coord.y & 0xfffff) << 20) | (uint64_t)(coord.z & 0xfffff);
+		}
+
+		static chunkCoord unpackKey( uint64_t key )
+		{
+			return chunkCoord( signExtend20( key >> 40 ), signExtend20( key >> 20 ), signExtend20( key ), (int)(key >> 60) );
+		}
+
+	private:
+		static int signExtend20( uint64_t v )
+		{
+			return (int)((int64_t)(v << 44) >> 44);
+		}
+
+		// 64 bit finalizer from murmur3, neighbouring chunks land far apart
+		static size_t hash( uint64_t key )
+		{
+			key ^= key >> 33;
+			key *= 0xff51afd7ed558ccdULL;
+			key ^= key >> 33;
+			key *= 0xc4ceb9fe1a85ec53ULL;
+			key ^= key >> 33;
+			return (size_t)key;
+		}
+
+		void grow();
+
+		std::vector<ChunkRecord> slots;
+		size_t mask;
+		size_t count;
+};
+
+#endif
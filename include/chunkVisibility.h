@@ -0,0 +1,73 @@
+/*
+ * File:	chunkVisibility.h
+ * Author:	James Letendre
+ *
+ * Chunk level visibility: frustum culling, face direction culling and draw lists
+ */
+#ifndef CHUNK_VISIBILITY_H
+#define CHUNK_VISIBILITY_H
+
+#include "chunkMesh.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <PolyVoxCore/Vector.h>
+
+// every face direction, see ChunkFace
+#define CHUNK_ALL_FACES ((1 << CHUNK_FACES) - 1)
+
+// most index ranges visibleRanges gives for one chunk
+#define CHUNK_MAX_RANGES 3
+
+// six planes facing inwards, a point p is inside if
+// normal.p + d >= 0 for every plane
+struct ViewFrustum
+{
+	float planes[6][4];
+
+	// perspective camera at position looking along direction, fovY in radians
+	void setPerspective( const PolyVox::Vector3DFloat &position, const PolyVox::Vector3DFloat &direction,
+			const PolyVox::Vector3DFloat &up, float fovY, float aspect, float nearDist, float farDist );
+
+	// false if the box lies entirely outside
+	bool intersects( const float lo[3], const float hi[3] ) const;
+};
+
+// one bit per ChunkFace, set for the directions whose faces inside the box
+// can be front facing seen from eye
+uint8_t visibleFaces( const float eye[3], const float lo[3], const float hi[3] );
+
+// merge the index ranges of the face directions in faces into as few
+// ranges as possible, returns how many
+int visibleRanges( uint8_t faces, const uint32_t faceStart[CHUNK_FACES + 1], uint32_t start[CHUNK_MAX_RANGES],
+		uint32_t count[CHUNK_MAX_RANGES] );
+
+// what a visibility pass needs to know of a meshed chunk
+struct ChunkDrawInfo
+{
+	int meshId;
+
+	// world space bounds of the mesh
+	float lo[3], hi[3];
+
+	uint32_t faceStart[CHUNK_FACES + 1];
+
+	// fill in from the mesh of the chunk
+	void set( int meshId, const ChunkMesh &mesh );
+};
+
+// a range of indices of a chunk's mesh to draw
+struct ChunkDraw
+{
+	int meshId;
+	uint32_t indexStart;
+	uint32_t indexCount;
+};
+
+// append the ranges of the chunks to draw seen from eye through frustum,
+// face direction culling is skipped unless cullFaces is set
+void buildDrawList( const ViewFrustum &frustum, const PolyVox::Vector3DFloat &eye, const std::vector<ChunkDrawInfo> &chunks,
+		bool cullFaces, std::vector<ChunkDraw> &out );
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * File:	greedyMesher.h
+ * Author:	James Letendre
+ *
+ * Greedy surface extraction, merges coplanar faces of the same material
+ */
+#ifndef GREEDY_MESHER_H
+#define GREEDY_MESHER_H
+
+#include "chunkMesh.h"
+
+#include <PolyVoxCore/RawVolume.h>
+#include <PolyVoxCore/Material.h>
+
+// mesh the region of the snapshot into maximal rectangles of same material
+// faces. The snapshot must cover the region plus a one voxel border, the
+// mesh covers the same faces CubicSurfaceExtractor would give. Merged quads
+// meet with T-junctions, so rasterization can leave the odd pixel crack.
+// scratch is working space, kept between calls it stops allocating
+void greedyMesh( PolyVox::RawVolume<PolyVox::Material8> &snap, const PolyVox::Region &region, ChunkMesh &mesh,
+		std::vector<uint8_t> &scratch );
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * File:	heightfieldCache.h
+ * Author:	James Letendre
+ *
+ * Surface noise of chunk columns, computed once and kept in an LRU cache
+ */
+#ifndef HEIGHTFIELD_CACHE_H
+#define HEIGHTFIELD_CACHE_H
+
+#include "noiseEngine.h"
+#include "terrainMetrics.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+// tiles kept, a full detail tile of 64 voxel columns is about 17KB
+#define HEIGHT_CACHE_TILES 512
+
+// surface noise over the columns of a chunk of some level of detail and a
+// one sample border. Sample (i, j) stands for the column at lower corner +
+// (i - 1, j - 1) * step + step / 2, step being 1 << lod, the same samples
+// TerrainCore::snapshotLod takes
+struct HeightTile
+{
+	int size;
+	std::vector<float> samples;
+
+	// of the tile's own samples, the border left out
+	float minimum, maximum;
+
+	// sample of column (i, j) of the tile, 0 to size - 1
+	float at( int i, int j ) const { return samples[ (j + 1)*(size + 2) + i + 1 ]; }
+};
+
+struct HeightfieldCacheStats
+{
+	size_t tiles;
+	size_t capacity;
+	size_t bytes;
+
+	// tiles found, computed, and dropped for newer ones
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+};
+
+// Tiles are immutable once made, a reader keeps its tile alive after it is
+// evicted, so only finding one takes the lock. Two threads missing the same
+// tile at once both compute it and the first one in is kept
+class HeightfieldCache
+{
+	public:
+		typedef std::shared_ptr<const HeightTile> tilePtr;
+
+		// tiles are size columns of noise sampled at 1/scale per voxel.
+		// Computing tiles is timed as TIMER_NOISE into metrics if given
+		HeightfieldCache( const NoiseEngine<float> &noise, int size, double scale, size_t capacity = HEIGHT_CACHE_TILES,
+				TerrainMetrics *metrics = NULL );
+
+		// tile of the chunk column x, z of level lod, computed if needed.
+		// Safe from any thread
+		tilePtr get( int x, int z, int lod );
+
+		// fewer than the tiles held evicts the oldest. 0 keeps nothing, every
+		// get computes its tile
+		void setCapacity( size_t tiles );
+
+		HeightfieldCacheStats getStats();
+
+	private:
+		struct Entry
+		{
+			tilePtr tile;
+			std::list<uint64_t>::iterator used;
+		};
+
+		void build( int x, int z, int lod, HeightTile &tile ) const;
+
+		// drop the least recently used tiles until at most capacity are held
+		void trim();
+
+		const NoiseEngine<float> &noise;
+		const int size;
+		const double scale;
+		TerrainMetrics *metrics;
+
+		boost::mutex mutex;
+		std::unordered_map<uint64_t, Entry> tiles;
+
+		// keys, most recently used first
+		std::list<uint64_t> lru;
+
+		size_t capacity;
+		size_t hits;
+		size_t misses;
+		size_t evictions;
+};
+
+#endif
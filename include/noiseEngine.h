@@ -0,0 +1,143 @@
+/*
+ * File:	noiseEngine.h
+ * Author:	James Letendre
+ *
+ * Seeded Perlin noise with fractal octave stacks unrolled at compile time
+ */
+#ifndef NOISE_ENGINE_H
+#define NOISE_ENGINE_H
+
+#include "perlinNoise.h"
+
+#include <cmath>
+#include <cstdint>
+
+// octaves are summed as they are, or folded into ridges
+enum NoiseFractal
+{
+	NOISE_FBM,		// sum of octaves, -1 to 1
+	NOISE_RIDGED	// sum of (1 - |octave|)^2, sharp crests, scaled to -1 to 1
+};
+
+// one octave folded for the fractal
+template <typename T, NoiseFractal Fractal>
+struct NoiseFold
+{
+	static T fold( T n ) { return n; }
+};
+
+template <typename T>
+struct NoiseFold<T, NOISE_RIDGED>
+{
+	static T fold( T n )
+	{
+		T r = 1 - std::fabs( n );
+		return 2 * r * r - 1;
+	}
+};
+
+template <typename T> class NoiseEngine;
+
+// octaves Octaves down to 1 of a fractal, each at twice the frequency and
+// gain times the amplitude of the last. Recursion rather than a loop so the
+// octave count is a constant and the stack is inlined into one expression
+template <typename T, int Octaves, NoiseFractal Fractal>
+struct NoiseOctaves
+{
+	static T sum( const NoiseEngine<T> &noise, T x, T y, T gain, T amplitude )
+	{
+		return amplitude * NoiseFold<T, Fractal>::fold( noise.sample( x, y, 0 ) ) +
+			NoiseOctaves<T, Octaves - 1, Fractal>::sum( noise, 2 * x, 2 * y, gain, amplitude * gain );
+	}
+
+	// the amplitudes added up, to scale the sum back to -1 to 1
+	static T total( T gain, T amplitude )
+	{
+		return amplitude + NoiseOctaves<T, Octaves - 1, Fractal>::total( gain, amplitude * gain );
+	}
+};
+
+template <typename T, NoiseFractal Fractal>
+struct NoiseOctaves<T, 0, Fractal>
+{
+	static T sum( const NoiseEngine<T> &, T, T, T, T ) { return 0; }
+	static T total( T, T ) { return 0; }
+};
+
+// Perlin noise from a permutation made from seed, seed 0 being Ken Perlin's
+// own. Holds no shared state, so threads may share a const engine or each
+// own one, and engines of different seeds run side by side. T is the
+// precision of single samples, float or double. Tiles are always float
+template <typename T>
+class NoiseEngine
+{
+	public:
+		explicit NoiseEngine( uint32_t seed = 0 ) : seed(seed)
+		{
+			perlinPermutation( seed, p );
+		}
+
+		uint32_t getSeed() const { return seed; }
+
+		// one octave at a point, -1 to 1
+		T sample( T x, T y, T z ) const
+		{
+			const T fx = std::floor( x ), fy = std::floor( y ), fz = std::floor( z );
+
+			const int X = (int)fx & 255, Y = (int)fy & 255, Z = (int)fz & 255;
+
+			x -= fx;
+			y -= fy;
+			z -= fz;
+
+			const T u = fade( x ), v = fade( y ), w = fade( z );
+
+			const int A = p[X  ]+Y, AA = p[A]+Z, AB = p[A+1]+Z,
+				B = p[X+1]+Y, BA = p[B]+Z, BB = p[B+1]+Z;
+
+			return lerp( w,
+					lerp( v,
+						lerp( u, grad( p[AA  ], x  , y  , z   ), grad( p[BA  ], x-1, y  , z   ) ),
+						lerp( u, grad( p[AB  ], x  , y-1, z   ), grad( p[BB  ], x-1, y-1, z   ) ) ),
+					lerp( v,
+						lerp( u, grad( p[AA+1], x  , y  , z-1 ), grad( p[BA+1], x-1, y  , z-1 ) ),
+						lerp( u, grad( p[AB+1], x  , y-1, z-1 ), grad( p[BB+1], x-1, y-1, z-1 ) ) ) );
+		}
+
+		// Octaves octaves of the z = 0 plane from frequency 1 up, -1 to 1
+		template <int Octaves, NoiseFractal Fractal>
+		T fractal( T x, T y, T gain = T(0.5) ) const
+		{
+			static_assert( Octaves > 0, "a fractal needs at least one octave" );
+
+			return NoiseOctaves<T, Octaves, Fractal>::sum( *this, x, y, gain, 1 ) /
+				NoiseOctaves<T, Octaves, Fractal>::total( gain, 1 );
+		}
+
+		// one octave over a countX by countY tile of the z = 0 plane,
+		// out[j*countX + i] = sample( x + i*step, y + j*step, 0 )
+		void tile( double x, double y, double step, int countX, int countY, float *out, PerlinKernel kernel = PERLIN_BEST ) const
+		{
+			perlinNoiseTile( p, x, y, step, countX, countY, out, kernel );
+		}
+
+	private:
+		static T fade( T t ) { return t * t * t * (t * (t * 6 - 15) + 10); }
+		static T lerp( T t, T a, T b ) { return a + t * (b - a); }
+
+		// low 4 bits of the hash pick one of 12 gradient directions
+		static T grad( int hash, T x, T y, T z )
+		{
+			const int h = hash & 15;
+			const T u = h<8 ? x : y,
+				  v = h<4 ? y : h==12||h==14 ? x : z;
+			return ((h&1) == 0 ? u : -u) + ((h&2) == 0 ? v : -v);
+		}
+
+		uint32_t seed;
+
+		// the permutation twice over, so lookups of +1 don't wrap
+		int p[512];
+};
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ * File:	occupancyGrid.h
+ * Author:	James Letendre
+ *
+ * One bit per voxel solid/empty copy of the paged in blocks, readable without locks
+ */
+#ifndef OCCUPANCY_GRID_H
+#define OCCUPANCY_GRID_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <PolyVoxCore/Vector.h>
+#include <PolyVoxCore/Raycast.h>
+
+// voxels on a side of a block, a row of x fits a 64 bit word
+#define OCCUPANCY_BLOCK 64
+#define OCCUPANCY_SHIFT 6
+
+enum OccupancyState
+{
+	OCCUPANCY_UNKNOWN,		// not in the grid
+	OCCUPANCY_EMPTY,
+	OCCUPANCY_SOLID,
+	OCCUPANCY_MIXED			// look at the bits
+};
+
+struct OccupancyBlock
+{
+	// bit x of rows[ y + z*OCCUPANCY_BLOCK ] is set for solid voxels, block
+	// relative coordinates
+	std::atomic<uint64_t> rows[OCCUPANCY_BLOCK*OCCUPANCY_BLOCK];
+
+	bool solid( int x, int y, int z ) const
+	{
+		return (rows[ y + z*OCCUPANCY_BLOCK ].load( std::memory_order_relaxed ) >> x) & 1;
+	}
+};
+
+// Writers change the grid one at a time, the caller serializes them. Any
+// number of readers may look at it at the same time between beginRead and
+// endRead, without taking a lock. Blocks and tables a writer replaces are
+// freed by reclaim once no reader is left which could still see them
+class OccupancyGrid
+{
+	public:
+		OccupancyGrid();
+		~OccupancyGrid();
+
+		// the whole block is solid or empty
+		void setUniform( int bx, int by, int bz, bool solid );
+
+		// OCCUPANCY_BLOCK*OCCUPANCY_BLOCK rows laid out as in OccupancyBlock
+		void setRows( int bx, int by, int bz, const uint64_t *rows );
+
+		// change one voxel of a block in the grid, others are ignored
+		void setVoxel( int x, int y, int z, bool solid );
+
+		// drop the block, readers see it as unknown
+		void forget( int bx, int by, int bz );
+
+		// free what was replaced or forgotten if no reader is active
+		void reclaim();
+
+		void beginRead() const { readers.fetch_add( 1 ); }
+		void endRead() const { readers.fetch_sub( 1 ); }
+
+		// state of the block, block is set to its bits if it is mixed. Readers only
+		OccupancyState lookup( int bx, int by, int bz, const OccupancyBlock *&block ) const;
+
+		// blocks with bits, and everything held
+		size_t getMixedBlocks() const { return mixedBlocks; }
+		size_t getBytes() const;
+
+	private:
+		// block pointers of uniform blocks
+		static OccupancyBlock *const emptyBlock;
+		static OccupancyBlock *const solidBlock;
+
+		static bool isBits( const OccupancyBlock *block ) { return block != NULL && block != emptyBlock && block != solidBlock; }
+
+		struct Slot
+		{
+			// 0 for a free slot, keys never leave a table
+			std::atomic<uint64_t> key;
+			std::atomic<OccupancyBlock*> block;
+		};
+
+		struct Table
+		{
+			size_t mask;
+			size_t used;
+			Slot *slots;
+		};
+
+		// empty table of size slots, a power of two
+		static Table *newTable( size_t size );
+		static void deleteTable( Table *t );
+
+		// block key with the top bit set so it is never 0
+		static uint64_t key( int bx, int by, int bz );
+		static size_t hash( uint64_t key );
+
+		// slot of the key, added if missing. Writers only
+		Slot &insert( uint64_t key );
+
+		// the table copied without forgotten blocks into one twice the live size
+		void rebuild();
+
+		// point the slot at block, retiring what it pointed to
+		void replace( Slot &slot, OccupancyBlock *block );
+
+		std::atomic<Table*> table;
+		mutable std::atomic<int> readers;
+
+		std::vector<OccupancyBlock*> retiredBlocks;
+		std::vector<Table*> retiredTables;
+
+		size_t mixedBlocks;
+};
+
+// Amanatides and Woo walk of the voxels along start to start + dir. Voxel i
+// spans i - 0.5 to i + 0.5 as with PolyVox's Raycast, and result is filled
+// in the same way. Blocks the grid doesn't hold are asked of fallback:
+// blockState( bx, by, bz ) gives their state, with OCCUPANCY_MIXED meaning
+// solid( x, y, z ) is asked per voxel. Empty blocks are crossed in one step.
+// The caller must be between beginRead and endRead
+template <typename Fallback>
+void castOccupancyRay( const OccupancyGrid &grid, Fallback &fallback, const PolyVox::Vector3DFloat &start,
+		const PolyVox::Vector3DFloat &dir, PolyVox::RaycastResult &result )
+{
+	const float p[3] = { start.getX() + 0.5f, start.getY() + 0.5f, start.getZ() + 0.5f };
+	const float d[3] = { dir.getX(), dir.getY(), dir.getZ() };
+
+	// t runs from 0 at start to 1 at start + dir
+	int v[3], step[3];
+	float tMax[3], tDelta[3];
+
+	for( int a = 0; a < 3; a++ )
+	{
+		v[a] = (int)floorf( p[a] );
+		step[a] = (d[a] > 0) ? 1 : ((d[a] < 0) ? -1 : 0);
+		tDelta[a] = step[a] ? 1.0f / fabsf( d[a] ) : HUGE_VALF;
+		tMax[a] = step[a] ? ((v[a] + (step[a] > 0)) - p[a]) / d[a] : HUGE_VALF;
+	}
+
+	result.foundIntersection = false;
+	result.previousVoxel = PolyVox::Vector3DInt32( v[0], v[1], v[2] );
+
+	int block[3] = { 0, 0, 0 };
+	bool haveBlock = false;
+	OccupancyState state = OCCUPANCY_UNKNOWN;
+	bool askFallback = false;
+	const OccupancyBlock *bits = NULL;
+
+	for( ;; )
+	{
+		const int b[3] = { v[0] >> OCCUPANCY_SHIFT, v[1] >> OCCUPANCY_SHIFT, v[2] >> OCCUPANCY_SHIFT };
+
+		if( !haveBlock || b[0] != block[0] || b[1] != block[1] || b[2] != block[2] )
+		{
+			block[0] = b[0]; block[1] = b[1]; block[2] = b[2];
+			haveBlock = true;
+
+			state = grid.lookup( b[0], b[1], b[2], bits );
+			askFallback = (state == OCCUPANCY_UNKNOWN);
+			if( askFallback )
+			{
+				state = fallback.blockState( b[0], b[1], b[2] );
+			}
+
+			if( state == OCCUPANCY_EMPTY )
+			{
+				// jump to where the ray leaves the block
+				float tExit = HUGE_VALF;
+				int exitAxis = 0;
+
+				for( int a = 0; a < 3; a++ )
+				{
+					if( step[a] == 0 )
+					{
+						continue;
+					}
+
+					float t = ((b[a] + (step[a] > 0)) * OCCUPANCY_BLOCK - p[a]) / d[a];
+					if( t < tExit )
+					{
+						tExit = t;
+						exitAxis = a;
+					}
+				}
+
+				if( tExit > 1 )
+				{
+					return;
+				}
+
+				for( int a = 0; a < 3; a++ )
+				{
+					const int lo = b[a] * OCCUPANCY_BLOCK;
+
+					if( a == exitAxis )
+					{
+						v[a] = (step[a] > 0) ? lo + OCCUPANCY_BLOCK : lo - 1;
+					}
+					else
+					{
+						v[a] = std::min( std::max( (int)floorf( p[a] + d[a] * tExit ), lo ), lo + OCCUPANCY_BLOCK - 1 );
+					}
+
+					tMax[a] = step[a] ? ((v[a] + (step[a] > 0)) - p[a]) / d[a] : HUGE_VALF;
+				}
+
+				result.previousVoxel = PolyVox::Vector3DInt32( v[0] - (exitAxis == 0) * step[0],
+						v[1] - (exitAxis == 1) * step[1], v[2] - (exitAxis == 2) * step[2] );
+				continue;
+			}
+		}
+
+		bool solid;
+		if( state == OCCUPANCY_SOLID )
+		{
+			solid = true;
+		}
+		else if( askFallback )
+		{
+			solid = fallback.solid( v[0], v[1], v[2] );
+		}
+		else
+		{
+			solid = bits->solid( v[0] & (OCCUPANCY_BLOCK-1), v[1] & (OCCUPANCY_BLOCK-1), v[2] & (OCCUPANCY_BLOCK-1) );
+		}
+
+		if( solid )
+		{
+			result.foundIntersection = true;
+			result.intersectionVoxel = PolyVox::Vector3DInt32( v[0], v[1], v[2] );
+			return;
+		}
+
+		result.previousVoxel = PolyVox::Vector3DInt32( v[0], v[1], v[2] );
+
+		int axis = (tMax[0] < tMax[1]) ? 0 : 1;
+		if( tMax[2] < tMax[axis] )
+		{
+			axis = 2;
+		}
+
+		if( tMax[axis] > 1 )
+		{
+			return;
+		}
+
+		v[axis] += step[axis];
+		tMax[axis] += tDelta[axis];
+	}
+}
+
+#endif
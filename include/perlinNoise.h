@@ -8,7 +8,26 @@
 #ifndef PERLIN_NOISE_H
 #define PERLIN_NOISE_H
 
-void initPerlinNoise();
-double perlinNoise( double x = 0.0, double y = 0.0, double z = 0.0 );
+#include <cstdint>
+
+// batch kernels, PERLIN_BEST picks the fastest one the cpu supports
+enum PerlinKernel
+{
+	PERLIN_BEST,
+	PERLIN_SCALAR,
+	PERLIN_SSE2,
+	PERLIN_AVX2
+};
+
+// fill p[0..511] with the permutation of seed twice over. Seed 0 is Ken
+// Perlin's reference permutation, see NoiseEngine
+void perlinPermutation( uint32_t seed, int *p );
+
+// fill a countX by countY tile of the z = 0 plane of the noise of
+// permutation p, out[j*countX + i] = noise( x + i*step, y + j*step )
+void perlinNoiseTile( const int *p, double x, double y, double step, int countX, int countY, float *out, PerlinKernel kernel = PERLIN_BEST );
+
+// can the kernel run on this cpu
+bool perlinKernelSupported( PerlinKernel kernel );
 
 #endif
@@ -0,0 +1,74 @@
+/*
+ * File:	perlinNoiseKernels.h
+ * Author:	James Letendre
+ *
+ * Float Perlin noise kernels for the z = 0 plane, used by perlinNoiseTile
+ */
+
+#ifndef PERLIN_NOISE_KERNELS_H
+#define PERLIN_NOISE_KERNELS_H
+
+#include <cmath>
+
+// the tile is split into an integer cell and a small float offset so float
+// precision doesn't depend on how far from the origin we are
+struct PerlinAxis
+{
+	int cell;
+	float frac;
+
+	PerlinAxis( double v )
+	{
+		double fl = floor(v);
+		cell = (int)fl;
+		frac = v - fl;
+	}
+};
+
+inline float perlinFade( float t )
+{
+	return t * t * t * (t * (t * 6 - 15) + 10);
+}
+
+inline float perlinLerp( float t, float a, float b )
+{
+	return a + t * (b - a);
+}
+
+// grad() with z = 0
+inline float perlinGrad2( int hash, float x, float y )
+{
+	int h = hash & 15;
+	float u = h<8 ? x : y,
+		  v = h<4 ? y : h==12||h==14 ? x : 0;
+	return ((h&1) == 0 ? u : -u) + ((h&2) == 0 ? v : -v);
+}
+
+// single sample, X and Y are already wrapped to 0..255
+inline float perlinSample2( const int *p, int X, float x, int Y, float y )
+{
+	float u = perlinFade(x),
+		  v = perlinFade(y);
+
+	int A = p[X  ]+Y, AA = p[A], AB = p[A+1],
+		B = p[X+1]+Y, BA = p[B], BB = p[B+1];
+
+	return perlinLerp(v,
+			perlinLerp(u, perlinGrad2(p[AA], x  , y  ), perlinGrad2(p[BA], x-1, y  )),
+			perlinLerp(u, perlinGrad2(p[AB], x  , y-1), perlinGrad2(p[BB], x-1, y-1)));
+}
+
+// sample i of a row starting at the given x axis
+inline float perlinRowSample( const int *p, const PerlinAxis &ax, float step, int i, int Y, float y )
+{
+	float t = ax.frac + i*step;
+	float fl = floorf(t);
+
+	return perlinSample2( p, (ax.cell + (int)fl) & 255, t - fl, Y, y );
+}
+
+void perlinNoiseTileScalar( const int *p, double x, double y, double step, int countX, int countY, float *out );
+void perlinNoiseTileSSE2( const int *p, double x, double y, double step, int countX, int countY, float *out );
+void perlinNoiseTileAVX2( const int *p, double x, double y, double step, int countX, int countY, float *out );
+
+#endif
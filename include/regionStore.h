@@ -0,0 +1,199 @@
+/*
+ * File:	regionStore.h
+ * Author:	James Letendre
+ *
+ * On disk store of modified volume blocks, grouped into region files
+ */
+#ifndef REGION_STORE_H
+#define REGION_STORE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+
+// blocks per side of a region file
+#define REGION_BLOCKS 16
+
+// Each region file holds REGION_BLOCKS^3 blocks: a header, a table with the
+// offset, length and checksum of every block, then the run length encoded
+// blocks. Reads use pread, writes are queued and done by a writer thread in
+// batches: the data of every block, one sync per file, then the table
+// entries. A block is never overwritten in place, its new copy goes to free
+// space and the old one is only reused once the table points away from it.
+// Files are in host byte order
+class RegionStore
+{
+	public:
+		// blocks are blockSize voxels on a side, region files go in directory
+		// which is created if needed
+		RegionStore( const std::string &directory, int blockSize );
+
+		// writes every queued block before returning
+		~RegionStore();
+
+		// read the block at block coordinates, voxels are materials with x
+		// fastest then y then z. false if the block isn't stored or the stored
+		// copy fails its checks
+		bool load( int bx, int by, int bz, std::vector<uint8_t> &voxels );
+
+		// queue the block to be written, takes the contents of voxels
+		void store( int bx, int by, int bz, std::vector<uint8_t> &voxels );
+
+		// wait until every queued block is on disk
+		void flush();
+
+		// keys of every stored block, including queued ones
+		void list( std::vector<uint64_t> &keys );
+
+		// delete every region file, starts a new world
+		void clear();
+
+		// key of a block, 21 bits per axis
+		static uint64_t blockKey( int bx, int by, int bz )
+		{
+			return ((uint64_t)(bx & 0x1fffff) << 42) | ((uint64_t)(by & 0x1fffff) << 21) | (uint64_t)(bz & 0x1fffff);
+		}
+
+		// block coordinates of a key
+		static void unpackBlockKey( uint64_t key, int &bx, int &by, int &bz )
+		{
+			bx = (int)((int64_t)(key << 1) >> 43);
+			by = (int)((int64_t)(key << 22) >> 43);
+			bz = (int)((int64_t)(key << 43) >> 43);
+		}
+
+	private:
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t blockSize;
+			uint32_t regionBlocks;
+		};
+
+		struct Entry
+		{
+			// 0 length means the block isn't stored
+			uint32_t offset;
+			uint32_t length;
+			uint32_t checksum;
+			uint32_t voxels;
+		};
+
+		// a block of the batch being written
+		struct Write
+		{
+			uint64_t key;
+			uint64_t region;
+
+			// its copy in inflight
+			const std::vector<uint8_t> *voxels;
+
+			uint32_t entryOffset;
+			Entry old;
+			Entry entry;
+
+			// the data is written, then the table entry points at it
+			bool written;
+			bool stored;
+		};
+
+		// a file of the batch, synced once for all its blocks
+		struct Sync
+		{
+			// a dup, the file may be closed while it is synced
+			int fd;
+
+			// extents released before the batch, free once the sync is done
+			size_t released;
+			bool ok;
+		};
+
+		// an open region file and the space in it no table entry uses
+		struct RegionFile
+		{
+			int fd;
+
+			// free extents by offset, never adjacent
+			std::map<uint32_t, uint32_t> freeSpace;
+
+			// extents given up since the last sync, the table entries
+			// pointing away from them may not be on disk yet
+			std::vector<std::pair<uint32_t, uint32_t> > released;
+
+			// end of the used part of the file
+			uint32_t end;
+		};
+
+		// key of the region holding the block
+		static uint64_t regionKey( int bx, int by, int bz );
+
+		// file of the region holding the block, NULL if it doesn't exist and
+		// create is false. Caller holds io_mutex
+		RegionFile *openRegion( int bx, int by, int bz, bool create );
+		void closeAll();
+
+		// find the free space of a newly opened file from its table
+		static bool scanFreeSpace( RegionFile &file );
+
+		// offset of length bytes of free space, taken out of the free list
+		static uint32_t allocate( RegionFile &file, uint32_t length );
+		static void release( RegionFile &file, uint32_t offset, uint32_t length );
+
+		// compress the block and write it to free space, its table entry is
+		// left alone. Caller holds io_mutex
+		void writeData( Write &w, std::map<uint64_t, Sync> &syncs );
+
+		// point the table at the written copy, false if it failed. Caller
+		// holds io_mutex
+		bool writeEntry( Write &w );
+
+		// write the blocks of a batch, taking io_mutex around the writes but
+		// not the syncs
+		void writeBatch( std::vector<Write> &batch );
+
+		void writerLoop();
+
+		std::string directory;
+		int blockSize;
+
+		// open region files by region key
+		std::map<uint64_t, RegionFile> files;
+
+		// counts closeAll calls, the files of a batch stay open unless it changes
+		uint32_t generation;
+
+		// serializes file access
+		boost::mutex io_mutex;
+		std::vector<uint8_t> compressed;
+
+		// blocks waiting to be written, newest copy of each block only
+		boost::mutex pending_mutex;
+		boost::condition_variable pending_cond;
+		boost::condition_variable flushed_cond;
+		std::unordered_map<uint64_t, std::vector<uint8_t> > pending;
+		std::deque<uint64_t> order;
+
+		// blocks of the batch being written, a load finds a block here until
+		// its table entry is written
+		std::unordered_map<uint64_t, std::vector<uint8_t> > inflight;
+
+		// times a block failed to be written, it is queued again until
+		// MAX_WRITE_RETRIES
+		std::unordered_map<uint64_t, int> failures;
+		bool writing;
+		bool stopping;
+
+		boost::thread writer;
+};
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * File:	runLength.h
+ * Author:	James Letendre
+ *
+ * Run length coding of voxel materials, used in memory and in region files
+ */
+#ifndef RUN_LENGTH_H
+#define RUN_LENGTH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// runs of (length-1, material), terrain is mostly long runs of one material
+inline void runLengthEncode( const uint8_t *voxels, size_t count, std::vector<uint8_t> &out )
+{
+	out.clear();
+
+	for( size_t i = 0; i < count; )
+	{
+		uint8_t material = voxels[i];
+		size_t run = 1;
+
+		while( run < 256 && i + run < count && voxels[i + run] == material )
+		{
+			run++;
+		}
+
+		out.push_back( run - 1 );
+		out.push_back( material );
+		i += run;
+	}
+}
+
+// count voxels of one material, without going through an array
+inline void runLengthFill( uint8_t material, size_t count, std::vector<uint8_t> &out )
+{
+	out.clear();
+	out.reserve( 2 * ((count + 255) / 256) );
+
+	for( size_t i = 0; i < count; i += 256 )
+	{
+		out.push_back( (count - i >= 256) ? 255 : count - i - 1 );
+		out.push_back( material );
+	}
+}
+
+// false if the runs don't add up to exactly count voxels
+inline bool runLengthDecode( const uint8_t *data, size_t size, uint8_t *voxels, size_t count )
+{
+	size_t pos = 0;
+
+	for( size_t i = 0; i + 1 < size; i += 2 )
+	{
+		size_t run = data[i] + 1;
+
+		if( pos + run > count )
+		{
+			return false;
+		}
+
+		memset( voxels + pos, data[i + 1], run );
+		pos += run;
+	}
+
+	return (size % 2) == 0 && pos == count;
+}
+
+#endif
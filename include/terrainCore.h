@@ -0,0 +1,402 @@
+/*
+ * File:	terrainCore.h
+ * Author:	James Letendre
+ *
+ * Renderer independent voxel terrain: paging, chunk bookkeeping and extraction
+ */
+#ifndef TERRAIN_CORE_H
+#define TERRAIN_CORE_H
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "chunkTable.h"
+#include "chunkScheduler.h"
+#include "chunkMesh.h"
+#include "chunkJob.h"
+#include "regionStore.h"
+#include "occupancyGrid.h"
+#include "voxelCollision.h"
+#include "terrainMetrics.h"
+#include "noiseEngine.h"
+#include "heightfieldCache.h"
+#include "blockVolume.h"
+
+#include <PolyVoxCore/RawVolume.h>
+#include <PolyVoxCore/SimpleInterface.h>
+#include <PolyVoxCore/Material.h>
+#include <PolyVoxCore/Raycast.h>
+
+#include <boost/thread/mutex.hpp>
+
+#define CHUNK_SIZE 64
+
+// chunks of every level of detail meshed around the camera, in chunks of
+// that level, and above and below it
+#define CHUNK_DIST 1
+#define CHUNK_DIST_Y 2
+
+// levels of detail, chunks of level n are 1 << n times as large and meshed
+// from every (1 << n)th voxel. Each level surrounds the finer one so the view
+// range doubles with every level
+#define LOD_LEVELS 6
+#define LOD_MAX_LEVELS 8
+
+// a box of voxels copied out of the volume, see copyRegion and paste
+struct VoxelClipboard
+{
+	int width, height, depth;
+
+	// materials, x fastest then y then z
+	std::vector<uint8_t> voxels;
+};
+
+// a ray from start to start + dir, see TerrainCore::raycastBatch
+struct VoxelRay
+{
+	PolyVox::Vector3DFloat start;
+	PolyVox::Vector3DFloat dir;
+};
+
+class TerrainCore
+{
+	public:
+		typedef ChunkTable::chunkCoord chunkCoord;
+
+		// with a storePath modified blocks are kept in region files there and
+		// survive paging, otherwise they are regenerated when paged back in.
+		// lodLevels rings of radius chunks each are kept meshed. seed picks
+		// the generated world, worlds of any seeds can exist side by side
+		explicit TerrainCore( const std::string &storePath = "", int lodLevels = LOD_LEVELS, int radius = CHUNK_DIST, uint32_t seed = 0 );
+
+		// writes every modified block to the store
+		~TerrainCore();
+
+		// write every modified block to the store and wait for it to finish,
+		// pages out the whole volume
+		void flushStore();
+
+		// queue the chunks around position which need a new or updated mesh,
+		// forget queued chunks which went out of range and evict chunks which
+		// are no longer needed. A chunk replaced by chunks of another level is
+		// kept until those are all meshed
+		void regenerate( const PolyVox::Vector3DFloat &position, const PolyVox::Vector3DFloat &direction );
+
+		// mesh ids of the chunks evicted by the last regenerate, the renderer
+		// should release them for reuse
+		const std::vector<int> &getEvicted() const { return evicted; }
+
+		// number of chunks being tracked
+		size_t getChunkCount() const { return chunks.size(); }
+
+		// voxels from the camera's chunk to the nearest side of the outermost
+		// ring, 0 before the first regenerate
+		int getViewRange() const;
+
+		// most important queued chunk, it is marked as processing until
+		// finishChunk is called. false if nothing is queued
+		bool nextChunk( chunkCoord &coord );
+
+		// mesh of the chunk has been built and is visible, remember which mesh
+		// it went into. Returns the milliseconds since the chunk was queued
+		double finishChunk( const chunkCoord &coord, int meshId );
+
+		// the chunk is meshed and no voxel changed since
+		bool isCurrent( const chunkCoord &coord );
+
+		ChunkSchedulerStats getSchedulerStats() const { return scheduler.getStats(); }
+
+		// mesh id of the chunk, -1 if it has no mesh yet
+		int getMeshId( const chunkCoord &coord );
+
+		// page in the voxels of the region snapshot reads from the volume,
+		// generating them if needed
+		void prefetch( const PolyVox::Region &region );
+
+		// copy the region and a one voxel border around it out of the volume.
+		// The copy is in region local coordinates, so one snapshot volume
+		// covering toSnapshotRegion( toLocalRegion( region ) ) does for any chunk
+		void snapshot( const PolyVox::Region &region, PolyVox::RawVolume<PolyVox::Material8> &snap );
+
+		// sample every (1 << coord.lod)th voxel of the chunk and a one sample
+		// border into snap. Untouched terrain comes straight from the
+		// column's heightfield, edited chunks from the volume
+		void snapshotLod( const chunkCoord &coord, PolyVox::RawVolume<PolyVox::Material8> &snap );
+
+		// snapshot the job's chunk at its level of detail, safe to call from
+		// worker threads
+		void snapshotJob( ChunkJob &job );
+
+		// mesh a job snapshotted with snapshotJob into job.mesh, timed into
+		// metrics if given
+		static void meshJob( ChunkJob &job, TerrainMetrics *metrics = NULL );
+
+		// extract the region into new/updated mesh, safe to call from worker threads.
+		// The volume is only locked while the region is copied, extraction runs on
+		// the copy so any number of chunks can be extracted at once
+		void extract( const PolyVox::Region &region, PolyVox::SurfaceMesh<PolyVox::PositionMaterial> &surf_mesh );
+
+		// snapshot the job's region and mesh it with the job's mesher into
+		// job.mesh, safe to call from worker threads
+		void extractJob( ChunkJob &job );
+
+		// mesh the region from a snapshot taken with snapshot() or at level of
+		// detail lod with snapshotLod(), surf_mesh and scratch are working space
+		// for the cubic and greedy mesher. Timed into metrics if given
+		static void meshSnapshot( PolyVox::RawVolume<PolyVox::Material8> &snap, const PolyVox::Region &region, int lod, MesherType mesher,
+				PolyVox::SurfaceMesh<PolyVox::PositionMaterial> &surf_mesh, std::vector<uint8_t> &scratch, ChunkMesh &mesh,
+				TerrainMetrics *metrics = NULL );
+
+		// mesher for new chunk meshes, changing it remeshes every chunk
+		void setMesher( MesherType type );
+		MesherType getMesher() const { return mesher; }
+
+		// raycast from start to start + dir. Walks a bit per voxel copy of the
+		// volume without taking the volume lock, so it is safe from any thread
+		// and doesn't wait for extraction. Blocks which aren't paged in are
+		// taken as generated
+		void raycast( const PolyVox::Vector3DFloat &start, const PolyVox::Vector3DFloat &dir, PolyVox::RaycastResult &result );
+
+		// raycast every ray, cheaper per ray than raycast
+		void raycastBatch( const VoxelRay *rays, size_t count, PolyVox::RaycastResult *results );
+
+		// voxel by voxel raycast through the volume under the volume lock, the
+		// walk PolyVox's Raycast does. Pages in every block it crosses, kept as
+		// the reference raycast is checked against
+		void raycastVolume( const PolyVox::Vector3DFloat &start, const PolyVox::Vector3DFloat &dir, PolyVox::RaycastResult &result );
+
+		// move every body as far as the terrain lets it this tick, see
+		// sweepOccupancyBox. Lock free like raycast
+		void collide( CollisionBody *bodies, size_t count );
+
+		// memory held by the raycast copy of the volume
+		size_t getOccupancyBytes() const { return occupancy.getBytes(); }
+
+		// lowest and highest generated surface over the columns of the chunk,
+		// edits aside. For coarse queries which shouldn't touch voxels
+		void surfaceRange( const chunkCoord &coord, double &lowest, double &highest );
+
+		// surface noise of chunk columns, shared by generation, coarse chunks,
+		// raycasts and collision
+		HeightfieldCacheStats getHeightfieldStats() { return heightfield.getStats(); }
+		void setHeightfieldCapacity( size_t tiles ) { heightfield.setCapacity( tiles ); }
+
+		// stage timers of the streaming work, the pipeline and renderer add theirs
+		TerrainMetrics &getMetrics() { return metrics; }
+
+		// read the timers and fill in the scheduler and voxel memory gauges
+		void sampleMetrics( TerrainMetricsSample &sample );
+
+		// paging callbacks, called by the volume with volume_mutex held
+		void volume_load( BlockVolume::Block &block, const PolyVox::Region &region );
+		void volume_unload( BlockVolume::Block &block, const PolyVox::Region &region );
+
+		// volume interface
+		PolyVox::Region getEnclosingRegion() { return volume.getEnclosingRegion(); }
+		PolyVox::Material8 getVoxelAt( const PolyVox::Vector3DInt32 &vec );
+		void setVoxelAt( const PolyVox::Vector3DInt32 &vec, PolyVox::Material8 mat );
+
+		// brush edits. Each takes the volume lock once and queues the chunks
+		// it changed, and the neighbours of any chunk border it changed, as
+		// one batch
+		void editSphere( const PolyVox::Vector3DFloat &center, float radius, PolyVox::Material8 mat );
+		void editBox( const PolyVox::Region &box, PolyVox::Material8 mat );
+
+		// vertical cylinder standing on base
+		void editCylinder( const PolyVox::Vector3DFloat &base, float radius, int height, PolyVox::Material8 mat );
+
+		// replace every voxel of material from inside box with to
+		void editFill( const PolyVox::Region &box, PolyVox::Material8 from, PolyVox::Material8 to );
+
+		// copy box out of the volume
+		void copyRegion( const PolyVox::Region &box, VoxelClipboard &clip );
+
+		// write the clipboard with its lower corner at origin, empty voxels of
+		// the clipboard are skipped unless pasteEmpty is set
+		void paste( const VoxelClipboard &clip, const PolyVox::Vector3DInt32 &origin, bool pasteEmpty );
+
+		// full detail chunk holding the voxel
+		static chunkCoord toChunkCoord( const PolyVox::Vector3DInt32 &vec );
+
+		// convert chunk coordinates of any level into region
+		static const PolyVox::Region toRegion( const chunkCoord &coord );
+
+		// region moved to the origin, what a snapshot of it is meshed as
+		static const PolyVox::Region toLocalRegion( const PolyVox::Region &region );
+
+		// region grown by one voxel on every side, what the extractor reads
+		static const PolyVox::Region toSnapshotRegion( const PolyVox::Region &region );
+
+	private:
+		// first so it outlives everything timed into it
+		TerrainMetrics metrics;
+
+		// the generated surface, read only once constructed
+		NoiseEngine<float> surfaceNoise;
+		HeightfieldCache heightfield;
+
+		// the volume pages and decompresses blocks even on reads, so every
+		// access to it goes through this lock
+		boost::mutex volume_mutex;
+
+		// modified blocks, NULL if there is no store
+		RegionStore *store;
+
+		// keys of the blocks changed since they were paged in, under volume_mutex
+		std::unordered_set<uint64_t> modifiedBlocks;
+		std::vector<uint8_t> blockVoxels;
+
+		// generate the noise terrain of a block and its occupancy straight
+		// into the block: all solid and all empty blocks are filled as runs,
+		// rows of the rest are set whole except where the surface crosses them
+		void generate( BlockVolume::Block &block, const PolyVox::Region &region );
+
+		// compute the heightfields generating the blocks of region would
+		// need, so the noise isn't made under volume_mutex
+		void warmHeightfield( const PolyVox::Region &region );
+
+		// solid voxels of the paged in blocks for the raycasts. Changed with
+		// volume_mutex held, read without it
+		OccupancyGrid occupancy;
+		std::vector<uint64_t> occupancyRows;
+
+		// block key of the block holding the voxel
+		static uint64_t toBlockKey( const PolyVox::Vector3DInt32 &vec );
+
+		// keys of the chunks which can have a surface the generator didn't
+		// make: edited chunks, stored ones, their neighbours and the coarser
+		// chunks holding them. Only changed by the main thread with
+		// volume_mutex held
+		std::unordered_set<uint64_t> editedChunks;
+
+		// add the full detail chunk and the coarser ones holding it
+		void markEdited( const chunkCoord &coord );
+
+		// the volume to page, after everything volume_load and volume_unload
+		// use so it pages out before they are destroyed
+		BlockVolume volume;
+
+		// true if layer y of region is still as generated and all material,
+		// so it needn't be paged in. Caller holds volume_mutex
+		bool generatedLayer( const PolyVox::Region &region, int y, uint8_t &material ) const;
+
+		// false if the chunk is known to be all solid or all empty, those are
+		// never queued
+		bool hasSurface( const chunkCoord &coord ) const;
+
+		MesherType mesher;
+
+		// mesh id, state and dirty flag of every known chunk
+		ChunkTable chunks;
+
+		// chunks waiting to be extracted, nearest first
+		ChunkScheduler scheduler;
+		std::vector<chunkCoord> dropped;
+
+		// box of chunks of one level, inclusive, in that level's coordinates
+		struct ChunkBox
+		{
+			int lo[3], hi[3];
+
+			bool contains( const chunkCoord &coord ) const
+			{
+				return coord.x >= lo[0] && coord.x <= hi[0] && coord.y >= lo[1] && coord.y <= hi[1] &&
+					coord.z >= lo[2] && coord.z <= hi[2];
+			}
+		};
+
+		// the chunks meshed at one level of detail: those in box which aren't
+		// in the hole the next finer level covers
+		struct LodRing
+		{
+			// chunk of this level the camera is in, only moved once the
+			// camera is a little past its border
+			chunkCoord center;
+
+			ChunkBox box;
+			ChunkBox hole;
+			bool hasHole;
+
+			bool contains( const chunkCoord &coord ) const
+			{
+				return box.contains( coord ) && !(hasHole && hole.contains( coord ));
+			}
+		};
+
+		int lodLevels;
+		int radius;
+
+		// rings of the current and the previous window
+		std::vector<LodRing> rings;
+		std::vector<LodRing> lastRings;
+		bool haveCenter;
+
+		// move the ring centers with the camera, true if any of them moved
+		bool recenter( const PolyVox::Vector3DFloat &position );
+
+		// boxes and holes of the rings from their centers
+		void layoutRings();
+
+		// is the chunk part of the current window
+		bool wanted( const chunkCoord &coord ) const
+		{
+			return coord.lod < lodLevels && rings[ coord.lod ].contains( coord );
+		}
+		bool unwanted( const chunkCoord &coord ) const { return !wanted( coord ); }
+
+		// how far the chunks drawn in place of an unwanted chunk are
+		enum Coverage
+		{
+			COVER_NONE,			// nothing is, the chunk is out of range
+			COVER_PENDING,		// some aren't meshed yet
+			COVER_READY			// all of them are meshed
+		};
+		Coverage coverage( const chunkCoord &coord );
+		Coverage childCoverage( const chunkCoord &coord );
+
+		// wanted chunk has a mesh, or needs none
+		bool ready( const chunkCoord &coord );
+
+		std::vector<chunkCoord> evictCoords;
+		std::vector<int> evicted;
+
+		// unwanted chunks kept until their replacement is meshed, they are
+		// looked at again whenever a chunk finishes
+		size_t retiring;
+		bool chunkFinished;
+
+		// forget every unwanted chunk which isn't queued or being extracted,
+		// once whatever replaces it is meshed or if it is out of range
+		void evictUnwanted();
+
+		// a ring center moved, drop and evict what went out of range and
+		// queue what came into range
+		void moveWindow();
+
+		// chunks changed since the last regenerate, may hold duplicates and
+		// chunks which are no longer dirty
+		std::vector<chunkCoord> dirtyChunks;
+
+		// queue the dirty chunks in range
+		void serviceDirty();
+
+		// queue the chunk if it is new or dirty and not already queued
+		void queueChunk( ChunkRecord &rec, const chunkCoord &coord );
+
+		// flag the chunk for remeshing
+		void markDirty( const chunkCoord &coord );
+
+		// write brush( x, y, z, current, out ) into every voxel of bounds it
+		// returns true for, then mark what changed
+		template <typename Brush>
+		void applyBrush( const PolyVox::Region &bounds, const Brush &brush );
+
+		// chunks and blocks touched by the current brush, one flag per chunk
+		// or block of the brush bounds
+		std::vector<uint8_t> editChunks;
+		std::vector<uint8_t> editBlocks;
+};
+
+#endif
+
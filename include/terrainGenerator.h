@@ -12,10 +12,12 @@
 #include <cstdio>
 #include <cmath>
 
+#include "noiseEngine.h"
+
 class TerrainGenerator
 {
 	public:
-		TerrainGenerator( uint32_t size, float scaleFact );
+		TerrainGenerator( uint32_t size, float scaleFact, uint32_t seed = 0 );
 		
 		// get width/height of map
 		uint32_t width() const { return _size; }
@@ -24,6 +26,10 @@ class TerrainGenerator
 		// get value of height map at position
 		float get( double x, double y ) const;
 
+		// get countX by countY values of the height map starting at x,y,
+		// out[j*countX + i] = get( x+i, y+j )
+		void getTile( double x, double y, uint32_t countX, uint32_t countY, float *out ) const;
+
 //		vector3df getNormal(uint32_t x, uint32_t y, float s) const;
 
 		//float *getHeightMap() { return heightMap; }
@@ -42,6 +48,7 @@ class TerrainGenerator
 		uint32_t _size;
 		float _scaleFact;
 		float* heightMap;
+		NoiseEngine<float> noise;
 
 };
 
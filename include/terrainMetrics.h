@@ -0,0 +1,173 @@
+/*
+ * File:	terrainMetrics.h
+ * Author:	James Letendre
+ *
+ * Timers and counters of the streaming pipeline, sampled for display and logs
+ */
+#ifndef TERRAIN_METRICS_H
+#define TERRAIN_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+#include <boost/thread/mutex.hpp>
+
+enum TerrainTimer
+{
+	TIMER_NOISE,		// heightfield tiles computed for generated blocks, coarse chunks and raycasts
+	TIMER_PAGE_IN,		// volume.prefetch, generating or loading blocks
+	TIMER_EXTRACT,		// cubic or greedy surface extraction
+	TIMER_MESH_BUILD,	// packing the surface into a ChunkMesh, skirts and face groups
+	TIMER_UPLOAD,		// handing a mesh to the renderer, main thread
+	TIMER_LOCK_WAIT,	// waiting for volume_mutex
+	TERRAIN_TIMERS
+};
+
+struct TerrainTimerSample
+{
+	size_t count;
+	double totalMs;
+	double maxMs;
+};
+
+// one reading of the metrics. Timers and chunks cover the interval since
+// the previous reading, the rest is the state at the time of the reading
+struct TerrainMetricsSample
+{
+	double seconds;
+	double intervalSeconds;
+
+	TerrainTimerSample timers[TERRAIN_TIMERS];
+
+	size_t chunks;
+	double chunksPerSecond;
+
+	// ChunkJobs the pool had to allocate, and jobs which came back with
+	// buffers grown past what the pool reserved
+	size_t jobsCreated;
+	double jobsCreatedPerSecond;
+	size_t jobsRegrown;
+	double jobsRegrownPerSecond;
+
+	// chunks waiting for the scheduler, and in the generate, mesh and
+	// upload stages of the pipeline
+	size_t scheduled;
+	size_t generateQueued;
+	size_t meshQueued;
+	size_t uploadQueued;
+
+	size_t voxelBytes;
+	size_t occupancyBytes;
+	size_t heightBytes;
+	size_t meshBytes;
+};
+
+typedef std::chrono::steady_clock metricsClock;
+
+// Counters are atomics, any thread may add to them. Readings are taken by
+// one thread at a time
+class TerrainMetrics
+{
+	public:
+		TerrainMetrics();
+
+		void add( TerrainTimer timer, uint64_t ns );
+
+		// a chunk mesh became visible
+		void chunkDone() { chunks++; }
+
+		// the ChunkJobPool allocated a job, or a job regrew its buffers
+		void jobCreated() { jobsCreated++; }
+		void jobRegrown() { jobsRegrown++; }
+
+		// timers, chunks and jobs since the previous reading, the gauges are left zero
+		void sample( TerrainMetricsSample &out );
+
+		static const char *timerName( TerrainTimer timer );
+
+	private:
+		std::atomic<uint64_t> count[TERRAIN_TIMERS];
+		std::atomic<uint64_t> totalNs[TERRAIN_TIMERS];
+		std::atomic<uint64_t> maxNs[TERRAIN_TIMERS];
+		std::atomic<uint64_t> chunks;
+		std::atomic<uint64_t> jobsCreated;
+		std::atomic<uint64_t> jobsRegrown;
+
+		metricsClock::time_point start;
+		metricsClock::time_point last;
+		uint64_t lastCount[TERRAIN_TIMERS];
+		uint64_t lastTotalNs[TERRAIN_TIMERS];
+		uint64_t lastChunks;
+		uint64_t lastJobsCreated;
+		uint64_t lastJobsRegrown;
+};
+
+// times its own lifetime into one of the timers
+class TerrainTimerScope
+{
+	public:
+		TerrainTimerScope( TerrainMetrics *metrics, TerrainTimer timer ) :
+			metrics(metrics), timer(timer), start( metricsClock::now() )
+		{
+		}
+
+		~TerrainTimerScope()
+		{
+			if( metrics )
+			{
+				metrics->add( timer, std::chrono::duration_cast<std::chrono::nanoseconds>( metricsClock::now() - start ).count() );
+			}
+		}
+
+	private:
+		TerrainMetrics *metrics;
+		TerrainTimer timer;
+		metricsClock::time_point start;
+};
+
+// scoped_lock which counts the time spent waiting for the mutex
+class TimedLock : public boost::unique_lock<boost::mutex>
+{
+	public:
+		TimedLock( boost::mutex &mutex, TerrainMetrics &metrics ) :
+			boost::unique_lock<boost::mutex>( mutex, boost::defer_lock )
+		{
+			TerrainTimerScope wait( &metrics, TIMER_LOCK_WAIT );
+			lock();
+		}
+};
+
+enum MetricsFormat
+{
+	METRICS_CSV,		// header line, then one line per reading
+	METRICS_JSON		// one object per line
+};
+
+// readings written to a file every so often, for runs without a screen
+class TerrainMetricsLog
+{
+	public:
+		// path "-" is stdout
+		TerrainMetricsLog( const std::string &path, MetricsFormat format, double periodSeconds );
+		~TerrainMetricsLog();
+
+		bool isOpen() const { return out != NULL; }
+
+		// true once periodSeconds have gone by since the last write
+		bool due() const;
+
+		void write( const TerrainMetricsSample &sample );
+
+	private:
+		FILE *out;
+		MetricsFormat format;
+		double periodSeconds;
+		bool wroteHeader;
+		metricsClock::time_point last;
+};
+
+#endif
@@ -7,83 +7,113 @@
 #ifndef TERRAIN_PAGER_H
 #define TERRAIN_PAGER_H
 
-#include <map>
+#include "terrainCore.h"
+#include "chunkMesh.h"
+#include "chunkRenderable.h"
+#include "chunkPipeline.h"
 
-#include <PolyVoxCore/LargeVolume.h>
-#include <PolyVoxCore/SimpleInterface.h>
-#include <PolyVoxCore/Material.h>
-#include <PolyVoxCore/Raycast.h>
+#include <vector>
 
 #include <OgreSceneManager.h>
-#include <OgreManualObject.h>
-#include <OgreWorkQueue.h>
 
-class TerrainPager : public Ogre::WorkQueue::RequestHandler, public Ogre::WorkQueue::ResponseHandler
+class TerrainPager
 {
 	public:
-		typedef std::pair<int,int> chunkCoord;
-		
+		typedef TerrainCore::chunkCoord chunkCoord;
+
 		TerrainPager( Ogre::SceneManager *sceneMgr, Ogre::SceneNode *node );
 
-		// regenerate the mesh for our new position, if needed
-		void regenerateMesh( const Ogre::Vector3 &position );
+		// destroys the chunk renderables and their scene nodes, the scene
+		// manager doesn't own objects it didn't create
+		~TerrainPager();
+
+		// regenerate the mesh for our new position and view direction, if needed
+		void regenerateMesh( const Ogre::Vector3 &position, const Ogre::Vector3 &direction );
+
+		// write every edited block to disk
+		void save() { core.flushStore(); }
+
+		// mesher for chunk meshes, changing it remeshes every chunk
+		void setMesher( MesherType type ) { core.setMesher( type ); }
+		MesherType getMesher() const { return core.getMesher(); }
+
+		ChunkSchedulerStats getSchedulerStats() const { return core.getSchedulerStats(); }
+		ChunkJobPoolStats getPoolStats() { return pool.getStats(); }
+		ChunkPipelineStats getPipelineStats() const { return pipeline.getStats(); }
 
-		// raycast into the volume
-		void raycast( const PolyVox::Vector3DFloat &start, const PolyVox::Vector3DFloat &dir, PolyVox::RaycastResult &result );
+		// stage timers since the last call, queue depths and memory held by
+		// voxels and chunk meshes. Main thread only
+		void sampleMetrics( TerrainMetricsSample &sample );
 
-		static void volume_load( const PolyVox::ConstVolumeProxy<PolyVox::Material8> &vol, const PolyVox::Region &region );
-		static void volume_unload( const PolyVox::ConstVolumeProxy<PolyVox::Material8> &vol, const PolyVox::Region &region );
+		// main thread time each frame may spend uploading chunk meshes, the
+		// rest wait for later frames. At least one chunk is uploaded a frame
+		void setUploadBudget( double ms ) { uploadBudgetMs = ms; }
+		double getUploadBudget() const { return uploadBudgetMs; }
+
+		// lock free raycasts into the volume
+		void raycast( const PolyVox::Vector3DFloat &start, const PolyVox::Vector3DFloat &dir, PolyVox::RaycastResult &result ) { core.raycast( start, dir, result ); }
+		void raycastBatch( const VoxelRay *rays, size_t count, PolyVox::RaycastResult *results ) { core.raycastBatch( rays, count, results ); }
+
+		// move bodies through the terrain, stopping at solid voxels
+		void collide( CollisionBody *bodies, size_t count ) { core.collide( bodies, count ); }
 
 		// volume interface
-		PolyVox::Region getEnclosingRegion() { return volume.getEnclosingRegion(); }
-		PolyVox::Material8 getVoxelAt( const PolyVox::Vector3DInt32 &vec );
-		void setVoxelAt( const PolyVox::Vector3DInt32 &vec, PolyVox::Material8 mat );
+		PolyVox::Region getEnclosingRegion() { return core.getEnclosingRegion(); }
+		PolyVox::Material8 getVoxelAt( const PolyVox::Vector3DInt32 &vec ) { return core.getVoxelAt( vec ); }
+		void setVoxelAt( const PolyVox::Vector3DInt32 &vec, PolyVox::Material8 mat ) { core.setVoxelAt( vec, mat ); }
+
+		// brush edits, the changed chunks are remeshed together
+		void editSphere( const PolyVox::Vector3DFloat &center, float radius, PolyVox::Material8 mat ) { core.editSphere( center, radius, mat ); }
+		void editBox( const PolyVox::Region &box, PolyVox::Material8 mat ) { core.editBox( box, mat ); }
+		void editCylinder( const PolyVox::Vector3DFloat &base, float radius, int height, PolyVox::Material8 mat ) { core.editCylinder( base, radius, height, mat ); }
+		void editFill( const PolyVox::Region &box, PolyVox::Material8 from, PolyVox::Material8 to ) { core.editFill( box, from, to ); }
+		void copyRegion( const PolyVox::Region &box, VoxelClipboard &clip ) { core.copyRegion( box, clip ); }
+		void paste( const VoxelClipboard &clip, const PolyVox::Vector3DInt32 &origin, bool pasteEmpty ) { core.paste( clip, origin, pasteEmpty ); }
 
 		// lock
 		void lock() { mutex.lock(); }
 		void unlock() { mutex.unlock(); }
 	private:
-		// Request handler interface
-		virtual bool canHandleRequest (const Ogre::WorkQueue::Request *req, const Ogre::WorkQueue *srcQ);
-		virtual Ogre::WorkQueue::Response* handleRequest (const Ogre::WorkQueue::Request *req, const Ogre::WorkQueue *srcQ);
+		// upload the finished chunks nearest position first, within the upload budget
+		void uploadFinished( const Ogre::Vector3 &position );
+		void uploadJob( ChunkJob *job );
+
+		// put the mesh of the chunk into its renderable, taking a free one if it has none
+		void uploadChunk( const chunkCoord &coord, const ChunkMesh &mesh );
 
-		// Response handler interface
-		virtual bool canHandleResponse (const Ogre::WorkQueue::Response *res, const Ogre::WorkQueue *srcQ);
-		virtual void handleResponse (const Ogre::WorkQueue::Response *res, const Ogre::WorkQueue *srcQ);
+		// renderable for a chunk, reusing an evicted one if possible
+		int allocRenderable();
 
-		// extract the region into new/updated mesh
-		void extract( const PolyVox::Region &region, PolyVox::SurfaceMesh<PolyVox::PositionMaterial> &surf_mesh );
-		void genMesh( const PolyVox::Region &region, const PolyVox::SurfaceMesh<PolyVox::PositionMaterial> &surf_mesh );
+		// empty the renderables of evicted chunks and keep them for reuse
+		void releaseEvicted();
 
-		// convert the region into the chunk coordinates
-		chunkCoord toChunkCoord( const PolyVox::Vector3DInt32 &vec );
+		// the paged volume and chunk bookkeeping
+		TerrainCore core;
 
-		// convert chunk coordinates into region
-		const PolyVox::Region toRegion( const chunkCoord &coord );
+		// extraction buffers, recycled once a chunk is uploaded
+		ChunkJobPool pool;
 
-		// the volume to page
-		PolyVox::LargeVolume<PolyVox::Material8> volume;
+		// generates and meshes chunks in the background, the meshes are
+		// uploaded by regenerateMesh. Holds at most a few chunks per stage so
+		// the scheduler and not the pipeline decides what is extracted next
+		ChunkPipeline pipeline;
+		double uploadBudgetMs;
 
-		// the ogre mesh
-		Ogre::ManualObject *manObj;
+		// one mesh per chunk, indexed by the chunk's mesh id
+		Ogre::SceneNode *node;
+		std::vector<ChunkRenderable*> renderables;
+
+		// emptied renderables of evicted chunks, the number of renderables is
+		// bounded by the chunks in range rather than every chunk ever visited
+		std::vector<int> freeRenderables;
 
 		// last player position
 		Ogre::Vector3 lastPosition;
 
-		// Work queue for loading terrain in the background
-		Ogre::WorkQueue *extractQueue;
-		int queueChannel;
-		static boost::mutex req_mutex;
-		boost::mutex resp_mutex;
 		boost::mutex mutex;
 
 		// initialized
 		bool init;
-
-		// mapping from chunk coord to mesh id
-		std::map<chunkCoord, int> chunkToMesh;
-		std::map<chunkCoord, bool> chunkProcessing;
-		std::map<chunkCoord, bool> chunkDirty;
 };
 
 #endif
@@ -0,0 +1,220 @@
+/*
+ * File:	voxelCollision.h
+ * Author:	James Letendre
+ *
+ * Swept box collision of moving bodies against the occupancy grid
+ */
+#ifndef VOXEL_COLLISION_H
+#define VOXEL_COLLISION_H
+
+#include "occupancyGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <PolyVoxCore/Vector.h>
+
+// bodies stop this far short of the voxel they run into, so the next tick
+// doesn't start touching it
+#define COLLISION_SKIN 0.001f
+
+// sides of a body that ran into a voxel, see CollisionBody::blocked
+enum CollisionSide
+{
+	COLLIDE_NEG_X = 1 << 0,
+	COLLIDE_POS_X = 1 << 1,
+	COLLIDE_NEG_Y = 1 << 2,		// standing on the ground
+	COLLIDE_POS_Y = 1 << 3,
+	COLLIDE_NEG_Z = 1 << 4,
+	COLLIDE_POS_Z = 1 << 5
+};
+
+// an axis aligned box moving through the terrain, see TerrainCore::collide
+struct CollisionBody
+{
+	// corners of the box in voxel coordinates, voxel i spans i - 0.5 to i + 0.5
+	PolyVox::Vector3DFloat lo, hi;
+
+	// how far the body wants to move this tick
+	PolyVox::Vector3DFloat move;
+
+	// set by the sweep: how far it got, lo and hi are moved by it, and the
+	// CollisionSide bits of what stopped it
+	PolyVox::Vector3DFloat moved;
+	uint8_t blocked;
+};
+
+// solid voxels out of the grid, or fallback for blocks it doesn't hold, see
+// castOccupancyRay. Remembers the last block so neighbouring voxels are cheap.
+// The caller must be between beginRead and endRead
+template <typename Fallback>
+class OccupancyProbe
+{
+	public:
+		OccupancyProbe( const OccupancyGrid &grid, Fallback &fallback ) :
+			grid(grid), fallback(fallback), haveBlock(false), state(OCCUPANCY_UNKNOWN), askFallback(false), bits(NULL)
+		{
+		}
+
+		OccupancyState blockState( int bx, int by, int bz )
+		{
+			if( !haveBlock || bx != block[0] || by != block[1] || bz != block[2] )
+			{
+				block[0] = bx; block[1] = by; block[2] = bz;
+				haveBlock = true;
+
+				state = grid.lookup( bx, by, bz, bits );
+				askFallback = (state == OCCUPANCY_UNKNOWN);
+				if( askFallback )
+				{
+					state = fallback.blockState( bx, by, bz );
+				}
+			}
+			return state;
+		}
+
+		bool solid( int x, int y, int z )
+		{
+			switch( blockState( x >> OCCUPANCY_SHIFT, y >> OCCUPANCY_SHIFT, z >> OCCUPANCY_SHIFT ) )
+			{
+				case OCCUPANCY_EMPTY:
+					return false;
+				case OCCUPANCY_SOLID:
+					return true;
+				default:
+					break;
+			}
+
+			if( askFallback )
+			{
+				return fallback.solid( x, y, z );
+			}
+			return bits->solid( x & (OCCUPANCY_BLOCK-1), y & (OCCUPANCY_BLOCK-1), z & (OCCUPANCY_BLOCK-1) );
+		}
+
+	private:
+		const OccupancyGrid &grid;
+		Fallback &fallback;
+
+		int block[3];
+		bool haveBlock;
+		OccupancyState state;
+		bool askFallback;
+		const OccupancyBlock *bits;
+};
+
+// first and last voxel overlapping lo to hi on one axis, touching doesn't count
+inline int collisionFirstVoxel( float lo ) { return (int)floorf( lo + 0.5f ); }
+inline int collisionLastVoxel( float hi ) { return (int)ceilf( hi + 0.5f ) - 1; }
+
+// Move body by body.move as far as the voxels let it. Resolved one axis at
+// a time, y first so bodies settle on the ground before sliding along it. Each
+// axis looks at every voxel in the slab the box sweeps through, so fast bodies
+// can't tunnel. Voxels the box already overlaps are ignored, letting it get
+// out of an edit that filled it in. Sweeps whose blocks are all empty skip the
+// voxels altogether
+template <typename Fallback>
+void sweepOccupancyBox( OccupancyProbe<Fallback> &probe, CollisionBody &body )
+{
+	float lo[3] = { body.lo.getX(), body.lo.getY(), body.lo.getZ() };
+	float hi[3] = { body.hi.getX(), body.hi.getY(), body.hi.getZ() };
+	float move[3] = { body.move.getX(), body.move.getY(), body.move.getZ() };
+
+	body.blocked = 0;
+
+	// every block the sweep touches empty, nothing to hit
+	int first[3], last[3];
+	for( int a = 0; a < 3; a++ )
+	{
+		first[a] = collisionFirstVoxel( std::min( lo[a], lo[a] + move[a] ) ) >> OCCUPANCY_SHIFT;
+		last[a] = collisionLastVoxel( std::max( hi[a], hi[a] + move[a] ) ) >> OCCUPANCY_SHIFT;
+	}
+
+	bool empty = true;
+	for( int bz = first[2]; bz <= last[2] && empty; bz++ )
+	{
+		for( int by = first[1]; by <= last[1] && empty; by++ )
+		{
+			for( int bx = first[0]; bx <= last[0] && empty; bx++ )
+			{
+				empty = (probe.blockState( bx, by, bz ) == OCCUPANCY_EMPTY);
+			}
+		}
+	}
+
+	if( !empty )
+	{
+		static const int order[3] = { 1, 0, 2 };
+
+		for( int o = 0; o < 3; o++ )
+		{
+			const int a = order[o];
+			const int b = (a + 1) % 3;
+			const int c = (a + 2) % 3;
+
+			if( move[a] == 0 )
+			{
+				continue;
+			}
+
+			// the face of the box in the slab, on the other axes where the
+			// earlier axes left it
+			const int b0 = collisionFirstVoxel( lo[b] ), b1 = collisionLastVoxel( hi[b] );
+			const int c0 = collisionFirstVoxel( lo[c] ), c1 = collisionLastVoxel( hi[c] );
+
+			// voxel layers past the leading face, nearest first
+			const int dir = (move[a] > 0) ? 1 : -1;
+			const int start = (dir > 0) ? (int)ceilf( hi[a] + 0.5f ) : (int)floorf( lo[a] - 0.5f );
+			const int end = (dir > 0) ? collisionLastVoxel( hi[a] + move[a] ) : collisionFirstVoxel( lo[a] + move[a] );
+
+			for( int i = start; (end - i) * dir >= 0; i += dir )
+			{
+				bool hit = false;
+				int v[3];
+				v[a] = i;
+
+				for( v[c] = c0; v[c] <= c1 && !hit; v[c]++ )
+				{
+					for( v[b] = b0; v[b] <= b1 && !hit; v[b]++ )
+					{
+						hit = probe.solid( v[0], v[1], v[2] );
+					}
+				}
+
+				if( hit )
+				{
+					// stop at the voxel face, never back up
+					if( dir > 0 )
+					{
+						move[a] = std::max( 0.0f, std::min( move[a], (i - 0.5f - COLLISION_SKIN) - hi[a] ) );
+					}
+					else
+					{
+						move[a] = std::min( 0.0f, std::max( move[a], (i + 0.5f + COLLISION_SKIN) - lo[a] ) );
+					}
+
+					body.blocked |= 1 << (2*a + (dir > 0));
+					break;
+				}
+			}
+
+			lo[a] += move[a];
+			hi[a] += move[a];
+		}
+	}
+	else
+	{
+		for( int a = 0; a < 3; a++ )
+		{
+			lo[a] += move[a];
+			hi[a] += move[a];
+		}
+	}
+
+	body.moved = PolyVox::Vector3DFloat( move[0], move[1], move[2] );
+	body.lo = PolyVox::Vector3DFloat( lo[0], lo[1], lo[2] );
+	body.hi = PolyVox::Vector3DFloat( hi[0], hi[1], hi[2] );
+}
+
+#endif
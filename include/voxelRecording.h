@@ -0,0 +1,78 @@
+/*
+ * File:	voxelRecording.h
+ * Author:	James Letendre
+ *
+ * Camera path and voxel edits recorded at a fixed timestep, for replaying
+ */
+#ifndef VOXEL_RECORDING_H
+#define VOXEL_RECORDING_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <PolyVoxCore/Vector.h>
+
+// frames per second of new recordings
+#define RECORDING_RATE 60
+
+// camera at the end of one timestep
+struct RecordedFrame
+{
+	float position[3];
+
+	// camera orientation as a quaternion w, x, y, z. The camera looks down -z
+	float orientation[4];
+
+	PolyVox::Vector3DFloat getPosition() const;
+	PolyVox::Vector3DFloat getDirection() const;
+};
+
+// a sphere of material, made before the camera moves to frame
+struct RecordedEdit
+{
+	uint32_t frame;
+	float center[3];
+	float radius;
+	uint32_t material;
+};
+
+class VoxelRecording
+{
+	public:
+		explicit VoxelRecording( double timestep = 1.0 / RECORDING_RATE );
+
+		// seconds between frames
+		double getTimestep() const { return timestep; }
+
+		// let seconds go by with the camera at position and orientation, adding
+		// a frame for every timestep completed. The rest carries over to the
+		// next call, so frames keep a fixed rate whatever the frame rate was
+		void advance( double seconds, const float position[3], const float orientation[4] );
+
+		// an edit made now, replayed before the next frame
+		void addEdit( const PolyVox::Vector3DFloat &center, float radius, uint8_t material );
+
+		const std::vector<RecordedFrame> &getFrames() const { return frames; }
+		const std::vector<RecordedEdit> &getEdits() const { return edits; }
+
+		void clear();
+
+		// false and a message on stdout if the file can't be written or
+		// isn't a recording
+		bool save( const std::string &path ) const;
+		bool load( const std::string &path );
+
+	private:
+		double timestep;
+
+		// time since the last frame
+		double pending;
+
+		std::vector<RecordedFrame> frames;
+
+		// in frame order
+		std::vector<RecordedEdit> edits;
+};
+
+#endif
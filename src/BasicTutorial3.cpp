@@ -17,8 +17,7 @@ This source file is part of the
  
 #include <vector>
 #include <cassert>
-
-#include "perlinNoise.h"
+#include <iostream>
 
 #include "BasicTutorial3.h"
 #include "PolyVoxCore/SimpleInterface.h"
@@ -29,51 +28,22 @@ This source file is part of the
 #define VOXEL_SCALE 1.0
 #define MODIFY_RADIUS 0.5
 
+// seconds between refreshes of the terrain panel
+#define TERRAIN_PANEL_PERIOD 0.5
+
+// recordings are written here, relative to the working directory
+#define RECORDING_PATH "replay.vxr"
+
 using namespace std;
 
 void BasicTutorial3::doTerrainUpdate()
 {
-	terrain->regenerateMesh( mCamera->getPosition() );
+	terrain->regenerateMesh( mCamera->getPosition(), mCamera->getDirection() );
 }
 
-void createSphereInVolume(TerrainPager* volData, float fRadius, PolyVox::Vector3DInt32 _center, uint8_t material)
+static PolyVox::Vector3DFloat toFloat( const PolyVox::Vector3DInt32 &vec )
 {
-	PolyVox::Vector3DFloat center( _center.getX(), _center.getY(), _center.getZ() );
-
-	//This vector hold the position of the center of the volume
-	PolyVox::Region volRegion(volData->getEnclosingRegion());
-
-	//This three-level for loop iterates over every voxel in the volume
-	for (int z = max(center.getZ() - fRadius, (float)volRegion.getLowerCorner().getZ()); z < min(center.getZ() + fRadius, (float)volRegion.getUpperCorner().getZ()); z++)
-	{
-		for (int y = max(center.getY() - fRadius, (float)volRegion.getLowerCorner().getY()); y < min(center.getY() + fRadius, (float)volRegion.getUpperCorner().getY()); y++)
-		{
-			for (int x = max(center.getX() - fRadius, (float)volRegion.getLowerCorner().getX()); x < min(center.getX() + fRadius, (float)volRegion.getUpperCorner().getX()); x++)
-			{
-				//Store our current position as a vector...
-				PolyVox::Vector3DFloat v3dCurrentPos(x,y,z);
-				//And compute how far the current position is from the center of the volume
-				float fDistToCenter = (v3dCurrentPos - center).length();
-
-				//If the current voxel is less than 'radius' units from the center then we make it solid.
-				if(fDistToCenter <= fRadius)
-				{
-					PolyVox::Vector3DInt32 point(x,y,z);
-
-					if( volRegion.containsPoint(point) )
-					{
-						//Get the old voxel
-						PolyVox::Material<uint8_t>  voxel = volData->getVoxelAt(point);
-
-						voxel.setMaterial(material);
-
-						//Wrte the voxel value into the volume
-						volData->setVoxelAt( point, voxel);
-					}
-				}
-			}
-		}
-	}
+	return PolyVox::Vector3DFloat( vec.getX(), vec.getY(), vec.getZ() );
 }
 
 void BasicTutorial3::createCursor( float radius )
@@ -110,7 +80,7 @@ void BasicTutorial3::createCursor( float radius )
 
 //-------------------------------------------------------------------------------------
 BasicTutorial3::BasicTutorial3(void)
-	: terrain(NULL)
+	: terrain(NULL), mTerrainPanel(NULL), mTerrainPanelAge(0), mRecordingOn(false)
 {
 }
 //-------------------------------------------------------------------------------------
@@ -120,6 +90,21 @@ BasicTutorial3::~BasicTutorial3(void)
 //-------------------------------------------------------------------------------------
 void BasicTutorial3::destroyScene(void)
 {
+	// keep the edits for next time
+	if( terrain )
+	{
+		terrain->save();
+	}
+
+	if( mRecordingOn )
+	{
+		toggleRecording();
+	}
+
+	// before the scene manager goes, the chunk renderables are attached to it
+	mCameraMan->setTerrain(NULL);
+	delete terrain;
+	terrain = NULL;
 }
 //-------------------------------------------------------------------------------------
 void BasicTutorial3::createScene(void)
@@ -164,10 +149,71 @@ void BasicTutorial3::createScene(void)
 	mSceneMgr->setSkyPlane(true, plane, "Examples/CloudySky", 500, 20, true, 0.5, 150, 150);
 }
 //-------------------------------------------------------------------------------------
+void BasicTutorial3::updateTerrainPanel()
+{
+	TerrainMetricsSample sample;
+	terrain->sampleMetrics( sample );
+
+	mTerrainPanel->setParamValue( 0, Ogre::StringConverter::toString( (float)sample.chunksPerSecond, 1 ) );
+
+	// main thread and worker time per second, and the longest single one
+	for( int t = 0; t < TERRAIN_TIMERS; t++ )
+	{
+		double perSecond = (sample.intervalSeconds > 0) ? sample.timers[t].totalMs / sample.intervalSeconds : 0;
+
+		mTerrainPanel->setParamValue( 1 + t, Ogre::StringConverter::toString( (float)perSecond, 4 ) + " ms/s, max " +
+				Ogre::StringConverter::toString( (float)sample.timers[t].maxMs, 3 ) );
+	}
+
+	mTerrainPanel->setParamValue( 1 + TERRAIN_TIMERS, Ogre::StringConverter::toString( sample.scheduled ) );
+	mTerrainPanel->setParamValue( 2 + TERRAIN_TIMERS, Ogre::StringConverter::toString( sample.generateQueued ) + " / " +
+			Ogre::StringConverter::toString( sample.meshQueued ) + " / " + Ogre::StringConverter::toString( sample.uploadQueued ) );
+	mTerrainPanel->setParamValue( 3 + TERRAIN_TIMERS, Ogre::StringConverter::toString( (float)(sample.voxelBytes / 1048576.0), 4 ) );
+	mTerrainPanel->setParamValue( 4 + TERRAIN_TIMERS, Ogre::StringConverter::toString( (float)(sample.occupancyBytes / 1048576.0), 4 ) );
+	mTerrainPanel->setParamValue( 5 + TERRAIN_TIMERS, Ogre::StringConverter::toString( (float)(sample.heightBytes / 1048576.0), 4 ) );
+	mTerrainPanel->setParamValue( 6 + TERRAIN_TIMERS, Ogre::StringConverter::toString( (float)(sample.meshBytes / 1048576.0), 4 ) );
+	mTerrainPanel->setParamValue( 7 + TERRAIN_TIMERS, Ogre::StringConverter::toString( (float)sample.jobsCreatedPerSecond, 1 ) + " / " +
+			Ogre::StringConverter::toString( (float)sample.jobsRegrownPerSecond, 1 ) );
+}
+//-------------------------------------------------------------------------------------
+void BasicTutorial3::toggleRecording()
+{
+	mRecordingOn = !mRecordingOn;
+
+	if( mRecordingOn )
+	{
+		mRecording.clear();
+		std::cout << "Recording to " << RECORDING_PATH << ", F9 to stop" << std::endl;
+	}
+	else if( mRecording.save( RECORDING_PATH ) )
+	{
+		std::cout << "Recorded " << mRecording.getFrames().size() << " frames and " << mRecording.getEdits().size()
+			<< " edits to " << RECORDING_PATH << std::endl;
+	}
+}
+//-------------------------------------------------------------------------------------
 void BasicTutorial3::createFrameListener(void)
 {
 	BaseApplication::createFrameListener();
 
+	// same order as updateTerrainPanel fills them in
+	Ogre::StringVector items;
+	items.push_back("Chunks/s");
+	for( int t = 0; t < TERRAIN_TIMERS; t++ )
+	{
+		items.push_back( TerrainMetrics::timerName( (TerrainTimer)t ) );
+	}
+	items.push_back("Scheduled");
+	items.push_back("Gen/Mesh/Upload");
+	items.push_back("Voxels MB");
+	items.push_back("Occupancy MB");
+	items.push_back("Heights MB");
+	items.push_back("Meshes MB");
+	items.push_back("Jobs new/regrown/s");
+
+	mTerrainPanel = mTrayMgr->createParamsPanel(OgreBites::TL_NONE, "TerrainPanel", 300, items);
+	mTerrainPanel->hide();
+
 	// set event listener
 	mMouse->setEventCallback(this);
 	mKeyboard->setEventCallback(this);
@@ -216,8 +262,26 @@ bool BasicTutorial3::frameRenderingQueued(const Ogre::FrameEvent& evt)
 
 	mCursor->setVisible(result.foundIntersection);
 
+	if( mRecordingOn )
+	{
+		const Ogre::Vector3 &pos = mCamera->getPosition();
+		const Ogre::Quaternion &rot = mCamera->getOrientation();
+
+		const float position[3] = { pos.x / VOXEL_SCALE, pos.y / VOXEL_SCALE, pos.z / VOXEL_SCALE };
+		const float orientation[4] = { rot.w, rot.x, rot.y, rot.z };
+
+		mRecording.advance( evt.timeSinceLastFrame, position, orientation );
+	}
+
 	doTerrainUpdate();
 
+	mTerrainPanelAge += evt.timeSinceLastFrame;
+	if( mTerrainPanel->isVisible() && mTerrainPanelAge >= TERRAIN_PANEL_PERIOD )
+	{
+		updateTerrainPanel();
+		mTerrainPanelAge = 0;
+	}
+
 	return ret;
 }
 
@@ -240,18 +304,48 @@ bool BasicTutorial3::keyPressed( const OIS::KeyEvent& evt )
 
 		if( result.foundIntersection )
 		{
-			if( evt.key == OIS::KC_E )
-			{
-				createSphereInVolume( terrain, MODIFY_RADIUS, result.previousVoxel, 1 );
-			}
-			else if( evt.key == OIS::KC_R)
+			// add in front of the hit voxel, or remove it
+			PolyVox::Vector3DFloat center = toFloat( evt.key == OIS::KC_E ? result.previousVoxel : result.intersectionVoxel );
+			uint8_t material = (evt.key == OIS::KC_E) ? 1 : 0;
+
+			terrain->editSphere( center, MODIFY_RADIUS, PolyVox::Material8( material ) );
+
+			if( mRecordingOn )
 			{
-				createSphereInVolume( terrain, MODIFY_RADIUS, result.intersectionVoxel, 0 );
+				mRecording.addEdit( center, MODIFY_RADIUS, material );
 			}
 
 			doTerrainUpdate();
 		}
 	}
+	else if( evt.key == OIS::KC_M )
+	{
+		// toggle between the cubic and greedy mesher
+		terrain->setMesher( terrain->getMesher() == MESHER_CUBIC ? MESHER_GREEDY : MESHER_CUBIC );
+	}
+	else if( evt.key == OIS::KC_F9 )
+	{
+		toggleRecording();
+	}
+	else if( evt.key == OIS::KC_N )
+	{
+		// toggle the terrain streaming panel
+		if( mTerrainPanel->getTrayLocation() == OgreBites::TL_NONE )
+		{
+			mTrayMgr->moveWidgetToTray( mTerrainPanel, OgreBites::TL_TOPLEFT, 0 );
+			mTerrainPanel->show();
+
+			// start the first interval now rather than when it was last hidden
+			TerrainMetricsSample sample;
+			terrain->sampleMetrics( sample );
+			mTerrainPanelAge = 0;
+		}
+		else
+		{
+			mTrayMgr->removeWidgetFromTray( mTerrainPanel );
+			mTerrainPanel->hide();
+		}
+	}
 
 	return ret;
 }
@@ -304,8 +398,6 @@ extern "C" {
 #endif
 		{
 			// Create application object
-			initPerlinNoise();
-
 			BasicTutorial3 app;
 
 			try {
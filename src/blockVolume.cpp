@@ -0,0 +1,350 @@
+/*
+ * File:	blockVolume.cpp
+ * Author:	James Letendre
+ *
+ * Paged volume of material blocks, run length compressed when not in use
+ */
+#include "blockVolume.h"
+#include "runLength.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// arrays kept for reuse once their blocks are compressed
+#define MAX_SPARE_BLOCKS 4
+
+uint8_t *BlockVolume::Block::voxels()
+{
+	if( plain == NULL )
+	{
+		volume->reservePlain();
+		plain = volume->allocPlain();
+		volume->uncompressed++;
+
+		if( runs.empty() )
+		{
+			memset( plain, 0, volume->blockVoxels );
+		}
+		else
+		{
+			runLengthDecode( &runs[0], runs.size(), plain, volume->blockVoxels );
+			std::vector<uint8_t>().swap( runs );
+		}
+	}
+	return plain;
+}
+
+uint8_t *BlockVolume::Block::overwrite()
+{
+	if( plain == NULL )
+	{
+		volume->reservePlain();
+		plain = volume->allocPlain();
+		volume->uncompressed++;
+
+		std::vector<uint8_t>().swap( runs );
+	}
+	return plain;
+}
+
+void BlockVolume::Block::fill( uint8_t material )
+{
+	if( plain != NULL )
+	{
+		volume->freePlain( plain );
+		plain = NULL;
+		volume->uncompressed--;
+	}
+
+	if( material == 0 )
+	{
+		std::vector<uint8_t>().swap( runs );
+	}
+	else
+	{
+		runLengthFill( material, volume->blockVoxels, runs );
+	}
+}
+
+void BlockVolume::Block::copyTo( uint8_t *out ) const
+{
+	if( plain != NULL )
+	{
+		memcpy( out, plain, volume->blockVoxels );
+	}
+	else if( runs.empty() )
+	{
+		memset( out, 0, volume->blockVoxels );
+	}
+	else
+	{
+		runLengthDecode( &runs[0], runs.size(), out, volume->blockVoxels );
+	}
+}
+
+BlockVolume::BlockVolume( const PagingHandler &load, const PagingHandler &unload, int blockSize ) :
+	loadHandler(load), unloadHandler(unload), blockSize(blockSize), blockShift(0),
+	blockVoxels( (size_t)blockSize * blockSize * blockSize ), maxBlocks(1024), maxUncompressed(32),
+	uncompressed(0), useClock(0), last(NULL), lastKey(0)
+{
+	while( (1 << blockShift) < blockSize )
+	{
+		blockShift++;
+	}
+}
+
+BlockVolume::~BlockVolume()
+{
+	flushAll();
+
+	for( size_t i = 0; i < spare.size(); i++ )
+	{
+		delete [] spare[i];
+	}
+}
+
+PolyVox::Material8 BlockVolume::getVoxelAt( int32_t x, int32_t y, int32_t z )
+{
+	Block &b = block( x >> blockShift, y >> blockShift, z >> blockShift );
+	const int mask = blockSize - 1;
+
+	// reading an all empty block needn't decompress it
+	if( b.plain == NULL && b.runs.empty() )
+	{
+		return PolyVox::Material8( 0 );
+	}
+
+	return PolyVox::Material8( b.voxels()[ (((z & mask) << blockShift) + (y & mask)) * blockSize + (x & mask) ] );
+}
+
+void BlockVolume::setVoxelAt( int32_t x, int32_t y, int32_t z, PolyVox::Material8 mat )
+{
+	Block &b = block( x >> blockShift, y >> blockShift, z >> blockShift );
+	const int mask = blockSize - 1;
+
+	b.voxels()[ (((z & mask) << blockShift) + (y & mask)) * blockSize + (x & mask) ] = mat.getMaterial();
+}
+
+void BlockVolume::prefetch( const PolyVox::Region &region )
+{
+	const PolyVox::Vector3DInt32 &lower = region.getLowerCorner();
+	const PolyVox::Vector3DInt32 &upper = region.getUpperCorner();
+
+	for( int bz = lower.getZ() >> blockShift; bz <= (upper.getZ() >> blockShift); bz++ )
+	{
+		for( int by = lower.getY() >> blockShift; by <= (upper.getY() >> blockShift); by++ )
+		{
+			for( int bx = lower.getX() >> blockShift; bx <= (upper.getX() >> blockShift); bx++ )
+			{
+				block( bx, by, bz );
+			}
+		}
+	}
+}
+
+void BlockVolume::flushAll()
+{
+	for( std::unordered_map<uint64_t, Block>::iterator it = blocks.begin(); it != blocks.end(); ++it )
+	{
+		unload( it->second );
+	}
+
+	blocks.clear();
+	last = NULL;
+}
+
+void BlockVolume::setMaxNumberOfBlocksInMemory( size_t blocks )
+{
+	maxBlocks = std::max( blocks, (size_t)1 );
+
+	while( this->blocks.size() > maxBlocks )
+	{
+		evictOldest();
+	}
+}
+
+void BlockVolume::setMaxNumberOfUncompressedBlocks( size_t blocks )
+{
+	maxUncompressed = std::max( blocks, (size_t)1 );
+	compressOldest( maxUncompressed );
+}
+
+size_t BlockVolume::calculateSizeInBytes() const
+{
+	size_t bytes = sizeof(*this) + (uncompressed + spare.size()) * blockVoxels + encoded.capacity();
+
+	for( std::unordered_map<uint64_t, Block>::const_iterator it = blocks.begin(); it != blocks.end(); ++it )
+	{
+		bytes += sizeof(uint64_t) + sizeof(Block) + it->second.runs.capacity();
+	}
+	return bytes;
+}
+
+PolyVox::Region BlockVolume::getEnclosingRegion() const
+{
+	const int32_t lo = std::numeric_limits<int32_t>::min(), hi = std::numeric_limits<int32_t>::max();
+
+	return PolyVox::Region( PolyVox::Vector3DInt32( lo, lo, lo ), PolyVox::Vector3DInt32( hi, hi, hi ) );
+}
+
+BlockVolume::Block &BlockVolume::block( int bx, int by, int bz )
+{
+	const uint64_t k = key( bx, by, bz );
+
+	if( last != NULL && lastKey == k )
+	{
+		return *last;
+	}
+
+	std::unordered_map<uint64_t, Block>::iterator it = blocks.find( k );
+	if( it != blocks.end() )
+	{
+		last = &it->second;
+		lastKey = k;
+		last->lastUse = ++useClock;
+		return *last;
+	}
+
+	if( blocks.size() >= maxBlocks )
+	{
+		evictOldest();
+	}
+
+	// new blocks are empty until the handler fills them in
+	Block &b = blocks[k];
+	b.volume = this;
+	b.bx = bx;
+	b.by = by;
+	b.bz = bz;
+	b.plain = NULL;
+	b.lastUse = ++useClock;
+
+	last = &b;
+	lastKey = k;
+
+	PolyVox::Vector3DInt32 lower( bx << blockShift, by << blockShift, bz << blockShift );
+	loadHandler( b, PolyVox::Region( lower, lower + PolyVox::Vector3DInt32( blockSize - 1, blockSize - 1, blockSize - 1 ) ) );
+
+	return b;
+}
+
+void BlockVolume::evictOldest()
+{
+	std::unordered_map<uint64_t, Block>::iterator oldest = blocks.end();
+
+	for( std::unordered_map<uint64_t, Block>::iterator it = blocks.begin(); it != blocks.end(); ++it )
+	{
+		if( oldest == blocks.end() || it->second.lastUse < oldest->second.lastUse )
+		{
+			oldest = it;
+		}
+	}
+
+	if( oldest == blocks.end() )
+	{
+		return;
+	}
+
+	unload( oldest->second );
+
+	if( last == &oldest->second )
+	{
+		last = NULL;
+	}
+	blocks.erase( oldest );
+}
+
+void BlockVolume::unload( Block &b )
+{
+	PolyVox::Vector3DInt32 lower( b.bx << blockShift, b.by << blockShift, b.bz << blockShift );
+	unloadHandler( b, PolyVox::Region( lower, lower + PolyVox::Vector3DInt32( blockSize - 1, blockSize - 1, blockSize - 1 ) ) );
+
+	if( b.plain != NULL )
+	{
+		freePlain( b.plain );
+		b.plain = NULL;
+		uncompressed--;
+	}
+}
+
+void BlockVolume::reservePlain()
+{
+	compressOldest( maxUncompressed - 1 );
+}
+
+void BlockVolume::compressOldest( size_t keep )
+{
+	while( uncompressed > keep )
+	{
+		Block *oldest = NULL;
+
+		for( std::unordered_map<uint64_t, Block>::iterator it = blocks.begin(); it != blocks.end(); ++it )
+		{
+			if( it->second.plain != NULL && (oldest == NULL || it->second.lastUse < oldest->lastUse) )
+			{
+				oldest = &it->second;
+			}
+		}
+
+		if( oldest == NULL )
+		{
+			return;
+		}
+		compress( *oldest );
+	}
+}
+
+void BlockVolume::compress( Block &b )
+{
+	runLengthEncode( b.plain, blockVoxels, encoded );
+
+	// all empty blocks keep no runs
+	bool empty = true;
+	for( size_t i = 1; i < encoded.size() && empty; i += 2 )
+	{
+		empty = (encoded[i] == 0);
+	}
+
+	if( empty )
+	{
+		std::vector<uint8_t>().swap( b.runs );
+	}
+	else
+	{
+		b.runs.assign( encoded.begin(), encoded.end() );
+	}
+
+	freePlain( b.plain );
+	b.plain = NULL;
+	uncompressed--;
+}
+
+uint8_t *BlockVolume::allocPlain()
+{
+	if( spare.empty() )
+	{
+		return new uint8_t[blockVoxels];
+	}
+
+	uint8_t *plain = spare.back();
+	spare.pop_back();
+	return plain;
+}
+
+void BlockVolume::freePlain( uint8_t *plain )
+{
+	if( spare.size() < MAX_SPARE_BLOCKS )
+	{
+		spare.push_back( plain );
+	}
+	else
+	{
+		delete [] plain;
+	}
+}
+
+uint64_t BlockVolume::key( int bx, int by, int bz )
+{
+	return ((uint64_t)(bx & 0x1fffff) << 42) | ((uint64_t)(by & 0x1fffff) << 21) | (uint64_t)(bz & 0x1fffff);
+}
@@ -23,6 +23,8 @@ CameraMan::CameraMan(Ogre::Camera* cam) :
 	gravityAccel = 10.0;
 	jumpSpeed = 5.0;
 	charHeight = 2.0;
+	charRadius = 0.4;
+	charHeadroom = 0.25;
 }
 
 CameraMan::~CameraMan() {}
@@ -127,115 +129,38 @@ bool CameraMan::frameRenderingQueued(const Ogre::FrameEvent& evt)
 	}
 	mVelocity.y = y_tmp;
 
-	// terrain handling, raycast each unit direction
-	PolyVox::RaycastResult resultXH;
-	PolyVox::RaycastResult resultXL;
-	PolyVox::RaycastResult resultY;
-	PolyVox::RaycastResult resultZH;
-	PolyVox::RaycastResult resultZL;
-
-	double width = 0.5;
-	PolyVox::Vector3DFloat cameraPos( mCamera->getPosition().x, mCamera->getPosition().y,						mCamera->getPosition().z );
-	PolyVox::Vector3DFloat cameraPosH( mCamera->getPosition().x, mCamera->getPosition().y + width,				mCamera->getPosition().z );
-	PolyVox::Vector3DFloat cameraPosL( mCamera->getPosition().x, mCamera->getPosition().y - charHeight + width,	mCamera->getPosition().z );
-
-	if( mVelocity.x > 0 )
-	{
-		mTerrain->raycast( cameraPosH, PolyVox::Vector3DFloat( width, 0, 0), resultXH);
-		mTerrain->raycast( cameraPosL, PolyVox::Vector3DFloat( width, 0, 0), resultXL);
-	}
-	else if( mVelocity.x < 0 )
+	// fall no faster than fallSpeedMax
+	if( mVelocity.y < -fallSpeedMax )
 	{
-		mTerrain->raycast( cameraPosH, PolyVox::Vector3DFloat(-width, 0, 0), resultXH);
-		mTerrain->raycast( cameraPosL, PolyVox::Vector3DFloat(-width, 0, 0), resultXL);
-	}
-	else
-	{
-		resultXH.foundIntersection = false;
-		resultXL.foundIntersection = false;
+		mVelocity.y = -fallSpeedMax;
 	}
 
-	if( mVelocity.y > 0 )
-	{
-		mTerrain->raycast( cameraPosH, PolyVox::Vector3DFloat( 0, width, 0), resultY);
-	}
-	else if( mVelocity.y < 0 )
-	{
-		mTerrain->raycast( cameraPosL, PolyVox::Vector3DFloat( 0,-width, 0), resultY);
-	}
-	else
-	{
-		resultY.foundIntersection = false;
-	}
+	// terrain handling, sweep the player's box through the voxels
+	Ogre::Vector3 camPos( mCamera->getPosition() );
+	Ogre::Vector3 move( mVelocity * evt.timeSinceLastFrame );
 
-	if( mVelocity.z > 0 )
-	{
-		mTerrain->raycast( cameraPosH, PolyVox::Vector3DFloat( 0, 0, width), resultZH);
-		mTerrain->raycast( cameraPosL, PolyVox::Vector3DFloat( 0, 0, width), resultZL);
-	}
-	else if( mVelocity.z < 0 )
-	{
-		mTerrain->raycast( cameraPosH, PolyVox::Vector3DFloat( 0, 0,-width), resultZH);
-		mTerrain->raycast( cameraPosL, PolyVox::Vector3DFloat( 0, 0,-width), resultZL);
-	}
-	else
-	{
-		resultZH.foundIntersection = false;
-		resultZL.foundIntersection = false;
-	}
+	CollisionBody body;
+	body.lo = PolyVox::Vector3DFloat( camPos.x - charRadius, camPos.y - charHeight, camPos.z - charRadius );
+	body.hi = PolyVox::Vector3DFloat( camPos.x + charRadius, camPos.y + charHeadroom, camPos.z + charRadius );
+	body.move = PolyVox::Vector3DFloat( move.x, move.y, move.z );
 
-	Ogre::Vector3 camPos( mCamera->getPosition() );
-	// handle horizontal movement
-	if( resultXH.foundIntersection || resultXL.foundIntersection )
+	mTerrain->collide( &body, 1 );
+
+	// stop on whatever we ran into
+	if( body.blocked & (COLLIDE_NEG_X | COLLIDE_POS_X) )
 	{
 		mVelocity.x = 0;
-		
-		if( resultXH.foundIntersection )
-		{
-			camPos.x = resultXH.previousVoxel.getX();
-		}
-		else
-		{
-			camPos.x = resultXL.previousVoxel.getX();
-		}
-	}
-	if( resultZH.foundIntersection || resultZL.foundIntersection )
-	{
-		mVelocity.z = 0;
-
-		if( resultZH.foundIntersection )
-		{
-			camPos.z = resultZH.previousVoxel.getZ();
-		}
-		else
-		{
-			camPos.z = resultZL.previousVoxel.getZ();
-		}
 	}
-
-	// handle ground/ceiling
-	if( resultY.foundIntersection )
+	if( body.blocked & (COLLIDE_NEG_Y | COLLIDE_POS_Y) )
 	{
-		camPos.y = resultY.previousVoxel.getY();
-		if( mVelocity.y < 0 )
-		{
-			camPos.y += charHeight - 1.0;
-		}
-
 		mVelocity.y = 0;
 	}
-	else
+	if( body.blocked & (COLLIDE_NEG_Z | COLLIDE_POS_Z) )
 	{
-		if( mVelocity.y < -fallSpeedMax )
-		{
-			mVelocity.y = -fallSpeedMax;
-		}
+		mVelocity.z = 0;
 	}
 
-	// set new position, not in a voxel
-	mCamera->setPosition( camPos );
-
-	if (mVelocity != Ogre::Vector3::ZERO) mCamera->move(mVelocity * evt.timeSinceLastFrame);
+	mCamera->move( Ogre::Vector3( body.moved.getX(), body.moved.getY(), body.moved.getZ() ) );
 
 	return true;
 }
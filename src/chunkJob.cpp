@@ -0,0 +1,125 @@
+/*
+ * File:	chunkJob.cpp
+ * Author:	James Letendre
+ *
+ * Buffers of a single chunk extraction, recycled through a pool
+ */
+#include "chunkJob.h"
+
+#include <algorithm>
+
+// headroom over the largest chunk seen, so a slightly bigger one doesn't regrow
+static size_t withHeadroom( size_t count )
+{
+	return count + count / 4;
+}
+
+static PolyVox::Region localSnapshotRegion( int chunkSize )
+{
+	return PolyVox::Region( PolyVox::Vector3DInt32( -1, -1, -1 ), PolyVox::Vector3DInt32( chunkSize, chunkSize, chunkSize ) );
+}
+
+ChunkJob::ChunkJob( int chunkSize ) :
+	mesher(MESHER_CUBIC), snap( localSnapshotRegion( chunkSize ) )
+{
+}
+
+ChunkJobPool::ChunkJobPool( int chunkSize, TerrainMetrics *metrics ) :
+	chunkSize(chunkSize), metrics(metrics)
+{
+	stats.created = 0;
+	stats.free = 0;
+	stats.acquired = 0;
+	stats.regrown = 0;
+	stats.maxVertices = 0;
+	stats.maxIndices = 0;
+}
+
+ChunkJobPool::~ChunkJobPool()
+{
+	for( size_t i = 0; i < freeJobs.size(); i++ )
+	{
+		delete freeJobs[i];
+	}
+}
+
+void ChunkJobPool::reserve( ChunkJob *job )
+{
+	size_t vertices = withHeadroom( stats.maxVertices );
+	size_t indices = withHeadroom( stats.maxIndices );
+
+	job->surf_mesh.m_vecVertices.reserve( vertices );
+	job->surf_mesh.m_vecTriangleIndices.reserve( indices );
+	job->mesh.vertices.reserve( vertices );
+
+	// small chunks use 16 bit indices, big ones 32 bit
+	if( vertices <= 65536 )
+	{
+		job->mesh.indices16.reserve( indices );
+	}
+	else
+	{
+		job->mesh.indices32.reserve( indices );
+	}
+}
+
+ChunkJob *ChunkJobPool::acquire()
+{
+	boost::mutex::scoped_lock lock(mutex);
+
+	stats.acquired++;
+
+	if( !freeJobs.empty() )
+	{
+		ChunkJob *job = freeJobs.back();
+		freeJobs.pop_back();
+		return job;
+	}
+
+	ChunkJob *job = new ChunkJob( chunkSize );
+	reserve( job );
+	stats.created++;
+
+	if( metrics )
+	{
+		metrics->jobCreated();
+	}
+
+	return job;
+}
+
+void ChunkJobPool::release( ChunkJob *job )
+{
+	boost::mutex::scoped_lock lock(mutex);
+
+	size_t vertices = std::max( job->surf_mesh.getNoOfVertices(), (uint32_t)job->mesh.vertices.size() );
+	size_t indices = std::max( job->surf_mesh.getNoOfIndices(), (uint32_t)job->mesh.indexCount() );
+
+	// the job outgrew what the pool sized it for
+	if( vertices > withHeadroom( stats.maxVertices ) || indices > withHeadroom( stats.maxIndices ) )
+	{
+		stats.regrown++;
+
+		if( metrics )
+		{
+			metrics->jobRegrown();
+		}
+	}
+
+	stats.maxVertices = std::max( stats.maxVertices, vertices );
+	stats.maxIndices = std::max( stats.maxIndices, indices );
+
+	// bring the rest of its buffers up to the largest chunk, once
+	reserve( job );
+
+	freeJobs.push_back( job );
+}
+
+ChunkJobPoolStats ChunkJobPool::getStats()
+{
+	boost::mutex::scoped_lock lock(mutex);
+
+	ChunkJobPoolStats out = stats;
+	out.free = freeJobs.size();
+	return out;
+}
@@ -0,0 +1,297 @@
+/*
+ * File:	chunkMesh.cpp
+ * Author:	James Letendre
+ *
+ * Renderer independent mesh of a single terrain chunk
+ */
+#include "chunkMesh.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+void buildChunkMesh( const PolyVox::SurfaceMesh<PolyVox::PositionMaterial> &surf_mesh, ChunkMesh &mesh )
+{
+	const std::vector<PolyVox::PositionMaterial>& vecVertices = surf_mesh.getVertices();
+	const std::vector<uint32_t>& vecIndices = surf_mesh.getIndices();
+
+	mesh.clear();
+	mesh.region = surf_mesh.m_Region;
+
+	if( surf_mesh.m_vecLodRecords.empty() )
+	{
+		return;
+	}
+
+	unsigned int uLodLevel = 0;
+	int beginIndex = surf_mesh.m_vecLodRecords[uLodLevel].beginIndex;
+	int endIndex = surf_mesh.m_vecLodRecords[uLodLevel].endIndex;
+
+	mesh.vertices.resize( vecVertices.size() );
+
+	for( size_t i = 0; i < vecVertices.size(); i++ )
+	{
+		// extractor positions are relative to the region and end in .5
+		const PolyVox::Vector3DFloat &pos = vecVertices[i].getPosition();
+
+		ChunkVertex &out = mesh.vertices[i];
+		out.x = (uint8_t)(pos.getX() + 0.5f);
+		out.y = (uint8_t)(pos.getY() + 0.5f);
+		out.z = (uint8_t)(pos.getZ() + 0.5f);
+		out.w = 1;
+		out.material = vecVertices[i].getMaterial() - 1;
+		out.pad[0] = out.pad[1] = out.pad[2] = 0;
+	}
+
+	if( vecVertices.size() <= 65536 )
+	{
+		mesh.indices16.assign( vecIndices.begin() + beginIndex, vecIndices.begin() + endIndex );
+	}
+	else
+	{
+		mesh.indices32.assign( vecIndices.begin() + beginIndex, vecIndices.begin() + endIndex );
+	}
+}
+
+void addChunkQuad( ChunkMesh &mesh, const int origin[3], int u, int v, int w, int h, int side, uint8_t material )
+{
+	int corners[4][3];
+
+	for( int c = 0; c < 4; c++ )
+	{
+		corners[c][0] = origin[0];
+		corners[c][1] = origin[1];
+		corners[c][2] = origin[2];
+	}
+
+	// counter clockwise seen from the front, u x v points along +d
+	corners[1][u] += w;
+	corners[2][u] += w;
+	corners[2][v] += h;
+	corners[3][v] += h;
+
+	static const int order[2][4] = { {0, 3, 2, 1}, {0, 1, 2, 3} };
+
+	for( int c = 0; c < 4; c++ )
+	{
+		const int *corner = corners[ order[side > 0][c] ];
+
+		ChunkVertex out;
+		out.x = corner[0];
+		out.y = corner[1];
+		out.z = corner[2];
+		out.w = 1;
+		out.material = material;
+		out.pad[0] = out.pad[1] = out.pad[2] = 0;
+
+		mesh.vertices.push_back( out );
+	}
+}
+
+void addSkirts( PolyVox::RawVolume<PolyVox::Material8> &snap, const PolyVox::Region &region, int depth, ChunkMesh &mesh )
+{
+	const PolyVox::Vector3DInt32 &lower = region.getLowerCorner();
+	const int dims[3] = { region.getWidthInVoxels(), region.getHeightInVoxels(), region.getDepthInVoxels() };
+	const size_t firstVertex = mesh.vertices.size();
+
+	// the x and z sides, u runs up the column so runs merge vertically
+	for( int d = 0; d < 3; d += 2 )
+	{
+		const int u = (d == 0) ? 1 : 0;
+		const int v = (d == 0) ? 2 : 1;
+		const int across = 2 - d;
+
+		for( int side = -1; side <= 1; side += 2 )
+		{
+			const int slice = (side > 0) ? dims[d] - 1 : 0;
+
+			for( int i = 0; i < dims[across]; i++ )
+			{
+				int pos[3];
+				pos[d] = slice;
+				pos[across] = i;
+
+				// top of the column along the side
+				int top = dims[1] - 1;
+				for( ; top >= 0; top-- )
+				{
+					pos[1] = top;
+					if( snap.getVoxelAt( lower.getX() + pos[0], lower.getY() + pos[1], lower.getZ() + pos[2] ).getMaterial() != 0 )
+					{
+						break;
+					}
+				}
+
+				for( int y = top; y >= 0 && y > top - depth; )
+				{
+					pos[1] = y;
+					uint8_t material = snap.getVoxelAt( lower.getX() + pos[0], lower.getY() + pos[1], lower.getZ() + pos[2] ).getMaterial();
+
+					pos[d] += side;
+					uint8_t outside = snap.getVoxelAt( lower.getX() + pos[0], lower.getY() + pos[1], lower.getZ() + pos[2] ).getMaterial();
+					pos[d] -= side;
+
+					// empty voxels have no face, exposed ones got one from the mesher
+					if( material == 0 || outside == 0 )
+					{
+						y--;
+						continue;
+					}
+
+					// merge the run of the same material downwards
+					int run = 1;
+					while( y - run >= 0 && y - run > top - depth )
+					{
+						pos[1] = y - run;
+						uint8_t below = snap.getVoxelAt( lower.getX() + pos[0], lower.getY() + pos[1], lower.getZ() + pos[2] ).getMaterial();
+
+						pos[d] += side;
+						uint8_t belowOutside = snap.getVoxelAt( lower.getX() + pos[0], lower.getY() + pos[1], lower.getZ() + pos[2] ).getMaterial();
+						pos[d] -= side;
+
+						if( below != material || belowOutside == 0 )
+						{
+							break;
+						}
+						run++;
+					}
+
+					int origin[3];
+					origin[d] = (side > 0) ? slice + 1 : slice;
+					origin[across] = i;
+					origin[1] = y - run + 1;
+
+					if( d == 0 )
+					{
+						addChunkQuad( mesh, origin, u, v, run, 1, side, material - 1 );
+					}
+					else
+					{
+						addChunkQuad( mesh, origin, u, v, 1, run, side, material - 1 );
+					}
+
+					y -= run;
+				}
+			}
+		}
+	}
+
+	const size_t quads = (mesh.vertices.size() - firstVertex) / 4;
+
+	if( quads == 0 )
+	{
+		return;
+	}
+
+	// the skirt pushed the mesh past 16 bit indices
+	if( mesh.vertices.size() > 65536 && !mesh.indices16.empty() )
+	{
+		mesh.indices32.assign( mesh.indices16.begin(), mesh.indices16.end() );
+		mesh.indices16.clear();
+	}
+
+	for( size_t q = 0; q < quads; q++ )
+	{
+		const uint32_t base = firstVertex + q * 4;
+		const uint32_t quad[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+
+		if( mesh.vertices.size() > 65536 )
+		{
+			mesh.indices32.insert( mesh.indices32.end(), quad, quad + 6 );
+		}
+		else
+		{
+			mesh.indices16.insert( mesh.indices16.end(), quad, quad + 6 );
+		}
+	}
+}
+
+template <typename Index>
+static void groupFaces( ChunkMesh &mesh, std::vector<Index> &indices, std::vector<uint8_t> &scratch )
+{
+	const size_t triangles = indices.size() / 3;
+
+	// face of every triangle, then a copy of the indices to sort from
+	const size_t copyOffset = (triangles + sizeof(Index) - 1) / sizeof(Index) * sizeof(Index);
+	scratch.resize( copyOffset + indices.size() * sizeof(Index) );
+
+	uint8_t *faces = &scratch[0];
+	Index *copy = (Index*)&scratch[copyOffset];
+	uint32_t count[CHUNK_FACES] = { 0 };
+
+	for( size_t t = 0; t < triangles; t++ )
+	{
+		const ChunkVertex &a = mesh.vertices[ indices[t*3] ];
+		const ChunkVertex &b = mesh.vertices[ indices[t*3 + 1] ];
+		const ChunkVertex &c = mesh.vertices[ indices[t*3 + 2] ];
+
+		const int e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+		const int e2[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+		const int normal[3] = { e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0] };
+
+		// axis aligned, so only one component is set
+		int axis = 0;
+		if( abs( normal[1] ) > abs( normal[axis] ) ) axis = 1;
+		if( abs( normal[2] ) > abs( normal[axis] ) ) axis = 2;
+
+		faces[t] = axis*2 + (normal[axis] > 0);
+		count[ faces[t] ]++;
+	}
+
+	mesh.faceStart[0] = 0;
+	for( int f = 0; f < CHUNK_FACES; f++ )
+	{
+		mesh.faceStart[f + 1] = mesh.faceStart[f] + count[f] * 3;
+	}
+
+	if( triangles == 0 )
+	{
+		return;
+	}
+
+	memcpy( copy, &indices[0], indices.size() * sizeof(Index) );
+
+	uint32_t next[CHUNK_FACES];
+	std::copy( mesh.faceStart, mesh.faceStart + CHUNK_FACES, next );
+
+	for( size_t t = 0; t < triangles; t++ )
+	{
+		memcpy( &indices[ next[ faces[t] ] ], &copy[t*3], 3 * sizeof(Index) );
+		next[ faces[t] ] += 3;
+	}
+}
+
+void groupChunkFaces( ChunkMesh &mesh, std::vector<uint8_t> &scratch )
+{
+	if( mesh.indices32.empty() )
+	{
+		groupFaces( mesh, mesh.indices16, scratch );
+	}
+	else
+	{
+		groupFaces( mesh, mesh.indices32, scratch );
+	}
+
+	if( mesh.vertices.empty() )
+	{
+		for( int i = 0; i < 3; i++ )
+		{
+			mesh.boundsLo[i] = mesh.boundsHi[i] = 0;
+		}
+		return;
+	}
+
+	uint8_t lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+
+	for( size_t i = 0; i < mesh.vertices.size(); i++ )
+	{
+		const ChunkVertex &v = mesh.vertices[i];
+
+		lo[0] = std::min( lo[0], v.x ); hi[0] = std::max( hi[0], v.x );
+		lo[1] = std::min( lo[1], v.y ); hi[1] = std::max( hi[1], v.y );
+		lo[2] = std::min( lo[2], v.z ); hi[2] = std::max( hi[2], v.z );
+	}
+
+	std::copy( lo, lo + 3, mesh.boundsLo );
+	std::copy( hi, hi + 3, mesh.boundsHi );
+}
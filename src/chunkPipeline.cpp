@@ -0,0 +1,340 @@
+/*
+ * File:	chunkPipeline.cpp
+ * Author:	James Letendre
+ *
+ * Generate, mesh and upload stages for chunk jobs on a work stealing thread pool
+ */
+#include "chunkPipeline.h"
+#include "terrainCore.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <boost/bind.hpp>
+
+static uint64_t elapsedNs( const pipelineClock::time_point &start )
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>( pipelineClock::now() - start ).count();
+}
+
+ChunkPipeline::ChunkPipeline( TerrainCore &core, ChunkJobPool &pool, int threadCount, size_t capacity ) :
+	core(core), pool(pool), metrics(core.getMetrics()), capacity(capacity), deferred(0), deferredFrames(0), lastUploadMs(0), maxUploadMs(0),
+	steals(0), submitted(0), popped(0), nextWorker(0), epoch(0), stopping(false)
+{
+	if( threadCount <= 0 )
+	{
+		threadCount = std::max( 1u, boost::thread::hardware_concurrency() );
+	}
+	if( this->capacity == 0 )
+	{
+		this->capacity = 2 * threadCount;
+	}
+
+	for( int s = 0; s < CHUNK_STAGES; s++ )
+	{
+		slots[s] = 0;
+		queued[s] = 0;
+		peakQueued[s] = 0;
+		processed[s] = 0;
+		busyNs[s] = 0;
+	}
+
+	for( int t = 0; t < threadCount; t++ )
+	{
+		workers.push_back( new Worker );
+	}
+
+	// every worker exists before any of them looks for work to steal
+	for( int t = 0; t < threadCount; t++ )
+	{
+		threads.create_thread( boost::bind( &ChunkPipeline::workerLoop, this, (size_t)t ) );
+	}
+}
+
+ChunkPipeline::~ChunkPipeline()
+{
+	{
+		boost::mutex::scoped_lock lock(wake_mutex);
+		stopping = true;
+	}
+	wake_cond.notify_all();
+
+	threads.join_all();
+
+	for( size_t t = 0; t < workers.size(); t++ )
+	{
+		for( int s = 0; s < STAGE_UPLOAD; s++ )
+		{
+			for( size_t i = 0; i < workers[t]->queues[s].size(); i++ )
+			{
+				pool.release( workers[t]->queues[s][i] );
+			}
+		}
+		delete workers[t];
+	}
+
+	for( size_t i = 0; i < uploads.size(); i++ )
+	{
+		pool.release( uploads[i] );
+	}
+	for( size_t i = 0; i < ready.size(); i++ )
+	{
+		pool.release( ready[i] );
+	}
+}
+
+bool ChunkPipeline::reserve( int stage )
+{
+	size_t used = slots[stage].load();
+
+	while( used < capacity )
+	{
+		if( slots[stage].compare_exchange_weak( used, used + 1 ) )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void ChunkPipeline::queuedChanged( int stage, int delta )
+{
+	size_t now = (queued[stage] += delta);
+	size_t peak = peakQueued[stage].load();
+
+	while( now > peak && !peakQueued[stage].compare_exchange_weak( peak, now ) )
+	{
+	}
+}
+
+void ChunkPipeline::notify()
+{
+	{
+		boost::mutex::scoped_lock lock(wake_mutex);
+		epoch++;
+	}
+	wake_cond.notify_all();
+}
+
+void ChunkPipeline::push( size_t worker, int stage, ChunkJob *job )
+{
+	{
+		boost::mutex::scoped_lock lock(workers[worker]->mutex);
+		workers[worker]->queues[stage].push_back( job );
+	}
+	queuedChanged( stage, 1 );
+}
+
+bool ChunkPipeline::submit( ChunkJob *job )
+{
+	if( !reserve( STAGE_GENERATE ) )
+	{
+		return false;
+	}
+
+	submitted++;
+
+	push( nextWorker, STAGE_GENERATE, job );
+	nextWorker = (nextWorker + 1) % workers.size();
+
+	notify();
+	return true;
+}
+
+bool ChunkPipeline::take( size_t self, int stage, ChunkJob *&job )
+{
+	// a worker's own mesh queue holds what it just generated, newest is
+	// warmest in its cache. Generate queues keep the scheduler's order
+	{
+		Worker &own = *workers[self];
+		boost::mutex::scoped_lock lock(own.mutex);
+		std::deque<ChunkJob*> &queue = own.queues[stage];
+
+		if( !queue.empty() )
+		{
+			if( stage == STAGE_MESH )
+			{
+				job = queue.back();
+				queue.pop_back();
+			}
+			else
+			{
+				job = queue.front();
+				queue.pop_front();
+			}
+			queuedChanged( stage, -1 );
+			return true;
+		}
+	}
+
+	for( size_t i = 1; i < workers.size(); i++ )
+	{
+		Worker &victim = *workers[ (self + i) % workers.size() ];
+		boost::mutex::scoped_lock lock(victim.mutex);
+		std::deque<ChunkJob*> &queue = victim.queues[stage];
+
+		if( !queue.empty() )
+		{
+			job = queue.front();
+			queue.pop_front();
+			queuedChanged( stage, -1 );
+			steals++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool ChunkPipeline::runOne( size_t self )
+{
+	ChunkJob *job;
+
+	// finish what is already generated before starting on something new
+	if( reserve( STAGE_UPLOAD ) )
+	{
+		if( take( self, STAGE_MESH, job ) )
+		{
+			pipelineClock::time_point start = pipelineClock::now();
+			TerrainCore::meshJob( *job, &metrics );
+			busyNs[STAGE_MESH] += elapsedNs( start );
+			processed[STAGE_MESH]++;
+
+			{
+				boost::mutex::scoped_lock lock(upload_mutex);
+				uploads.push_back( job );
+			}
+			queuedChanged( STAGE_UPLOAD, 1 );
+			unreserve( STAGE_MESH );
+
+			// a generate job may have been waiting for room in the mesh stage
+			notify();
+			return true;
+		}
+		unreserve( STAGE_UPLOAD );
+	}
+
+	if( reserve( STAGE_MESH ) )
+	{
+		if( take( self, STAGE_GENERATE, job ) )
+		{
+			pipelineClock::time_point start = pipelineClock::now();
+			core.snapshotJob( *job );
+			busyNs[STAGE_GENERATE] += elapsedNs( start );
+			processed[STAGE_GENERATE]++;
+
+			push( self, STAGE_MESH, job );
+			unreserve( STAGE_GENERATE );
+
+			notify();
+			return true;
+		}
+		unreserve( STAGE_MESH );
+	}
+
+	return false;
+}
+
+void ChunkPipeline::workerLoop( size_t self )
+{
+	for( ;; )
+	{
+		uint64_t seen;
+		{
+			boost::mutex::scoped_lock lock(wake_mutex);
+			if( stopping )
+			{
+				return;
+			}
+			seen = epoch;
+		}
+
+		if( runOne( self ) )
+		{
+			continue;
+		}
+
+		// nothing to do, sleep until something changes. Anything which
+		// changed since seen was read wakes us straight away
+		boost::mutex::scoped_lock lock(wake_mutex);
+		while( epoch == seen && !stopping )
+		{
+			wake_cond.wait( lock );
+		}
+	}
+}
+
+void ChunkPipeline::collectMeshed()
+{
+	boost::mutex::scoped_lock lock(upload_mutex);
+
+	ready.insert( ready.end(), uploads.begin(), uploads.end() );
+	uploads.clear();
+}
+
+size_t ChunkPipeline::uploadsWaiting()
+{
+	boost::mutex::scoped_lock lock(upload_mutex);
+
+	return uploads.size() + ready.size();
+}
+
+void ChunkPipeline::uploadedOne()
+{
+	queuedChanged( STAGE_UPLOAD, -1 );
+	processed[STAGE_UPLOAD]++;
+	unreserve( STAGE_UPLOAD );
+	popped++;
+
+	// a mesh job may have been waiting for room in the upload stage
+	notify();
+}
+
+void ChunkPipeline::finishUpload( double ms )
+{
+	busyNs[STAGE_UPLOAD] += (uint64_t)(ms * 1e6);
+
+	if( !ready.empty() )
+	{
+		deferred += ready.size();
+		deferredFrames++;
+	}
+
+	lastUploadMs = ms;
+	maxUploadMs = std::max( maxUploadMs, ms );
+}
+
+float ChunkPipeline::distanceTo( const PolyVox::Region &region, const PolyVox::Vector3DFloat &p )
+{
+	const PolyVox::Vector3DInt32 &lo = region.getLowerCorner();
+	const PolyVox::Vector3DInt32 &hi = region.getUpperCorner();
+
+	float dx = std::max( 0.0f, std::max( lo.getX() - p.getX(), p.getX() - hi.getX() ) );
+	float dy = std::max( 0.0f, std::max( lo.getY() - p.getY(), p.getY() - hi.getY() ) );
+	float dz = std::max( 0.0f, std::max( lo.getZ() - p.getZ(), p.getZ() - hi.getZ() ) );
+
+	return sqrtf( dx*dx + dy*dy + dz*dz );
+}
+
+ChunkPipelineStats ChunkPipeline::getStats() const
+{
+	ChunkPipelineStats stats;
+
+	for( int s = 0; s < CHUNK_STAGES; s++ )
+	{
+		stats.stages[s].queued = queued[s].load();
+		stats.stages[s].peakQueued = peakQueued[s].load();
+		stats.stages[s].capacity = capacity;
+		stats.stages[s].processed = processed[s].load();
+		stats.stages[s].busyMs = busyNs[s].load() / 1e6;
+	}
+
+	stats.steals = steals.load();
+	stats.deferred = deferred;
+	stats.deferredFrames = deferredFrames;
+	stats.lastUploadMs = lastUploadMs;
+	stats.maxUploadMs = maxUploadMs;
+	stats.threads = workers.size();
+
+	return stats;
+}
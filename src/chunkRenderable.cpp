@@ -0,0 +1,207 @@
+/*
+ * File:	chunkRenderable.cpp
+ * Author:	James Letendre
+ *
+ * Indexed hardware buffer mesh of a single terrain chunk
+ */
+#include "chunkRenderable.h"
+
+#include <OgreCamera.h>
+#include <OgreSceneNode.h>
+#include <OgreRenderQueue.h>
+#include <OgreHardwareBufferManager.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+// smallest buffers handed out, avoids regrowing for every small chunk
+#define MIN_VERTEX_CAPACITY 4096
+#define MIN_INDEX_CAPACITY 8192
+
+ChunkRenderable::ChunkRenderable( const Ogre::String &material ) :
+	viewCamera(NULL), vertexCapacity(0), indexCapacity(0), indexType(Ogre::HardwareIndexBuffer::IT_16BIT)
+{
+	for( int i = 0; i < CHUNK_MAX_RANGES; i++ )
+	{
+		ranges[i].owner = this;
+	}
+	for( int i = 0; i <= CHUNK_FACES; i++ )
+	{
+		faceStart[i] = 0;
+	}
+
+	mRenderOp.operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
+	mRenderOp.useIndexes = true;
+
+	mRenderOp.vertexData = new Ogre::VertexData();
+	mRenderOp.vertexData->vertexStart = 0;
+	mRenderOp.vertexData->vertexCount = 0;
+
+	// ChunkVertex as is, VoxelTexture reads these as the vertex and uv0 attributes
+	Ogre::VertexDeclaration *decl = mRenderOp.vertexData->vertexDeclaration;
+	decl->addElement( 0, offsetof(ChunkVertex, x), Ogre::VET_UBYTE4, Ogre::VES_POSITION );
+	decl->addElement( 0, offsetof(ChunkVertex, material), Ogre::VET_UBYTE4, Ogre::VES_TEXTURE_COORDINATES, 0 );
+	assert( decl->getVertexSize(0) == sizeof(ChunkVertex) );
+
+	mRenderOp.indexData = new Ogre::IndexData();
+	mRenderOp.indexData->indexStart = 0;
+	mRenderOp.indexData->indexCount = 0;
+
+	setMaterial( material );
+}
+
+ChunkRenderable::~ChunkRenderable()
+{
+	delete mRenderOp.vertexData;
+	delete mRenderOp.indexData;
+}
+
+void ChunkRenderable::reserve( size_t vertexCount, size_t indexCount, Ogre::HardwareIndexBuffer::IndexType type )
+{
+	Ogre::HardwareBufferManager &mgr = Ogre::HardwareBufferManager::getSingleton();
+
+	// grow by half again so a chunk being edited doesn't reallocate every time
+	if( vertexCount > vertexCapacity )
+	{
+		vertexCapacity = std::max<size_t>( MIN_VERTEX_CAPACITY, vertexCount + vertexCount/2 );
+
+		Ogre::HardwareVertexBufferSharedPtr vbuf = mgr.createVertexBuffer(
+				mRenderOp.vertexData->vertexDeclaration->getVertexSize(0), vertexCapacity,
+				Ogre::HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY );
+
+		mRenderOp.vertexData->vertexBufferBinding->setBinding( 0, vbuf );
+	}
+
+	if( indexCount > indexCapacity || type != indexType )
+	{
+		indexCapacity = std::max<size_t>( MIN_INDEX_CAPACITY, indexCount + indexCount/2 );
+		indexType = type;
+
+		mRenderOp.indexData->indexBuffer = mgr.createIndexBuffer( indexType,
+				indexCapacity, Ogre::HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY );
+	}
+}
+
+void ChunkRenderable::update( const ChunkMesh &mesh )
+{
+	if( mesh.indexCount() == 0 )
+	{
+		clear();
+		return;
+	}
+
+	bool shortIndices = !mesh.indices16.empty();
+
+	reserve( mesh.vertices.size(), mesh.indexCount(),
+			shortIndices ? Ogre::HardwareIndexBuffer::IT_16BIT : Ogre::HardwareIndexBuffer::IT_32BIT );
+
+	// the vertices are already in the buffer layout, copy both in one go
+	mRenderOp.vertexData->vertexBufferBinding->getBuffer(0)->writeData( 0,
+			mesh.vertices.size() * sizeof(ChunkVertex), &mesh.vertices[0], true );
+	if( shortIndices )
+	{
+		mRenderOp.indexData->indexBuffer->writeData( 0, mesh.indices16.size() * sizeof(uint16_t), &mesh.indices16[0], true );
+	}
+	else
+	{
+		mRenderOp.indexData->indexBuffer->writeData( 0, mesh.indices32.size() * sizeof(uint32_t), &mesh.indices32[0], true );
+	}
+
+	mRenderOp.vertexData->vertexCount = mesh.vertices.size();
+	mRenderOp.indexData->indexCount = mesh.indexCount();
+
+	const PolyVox::Vector3DInt32 &lower = mesh.region.getLowerCorner();
+
+	// vertices are relative to half a voxel below the lower corner, coarse
+	// chunks count in units of 1 << lod voxels
+	getParentSceneNode()->setPosition( lower.getX() - 0.5, lower.getY() - 0.5, lower.getZ() - 0.5 );
+	getParentSceneNode()->setScale( 1 << mesh.lod, 1 << mesh.lod, 1 << mesh.lod );
+
+	// only as large as the surface, so Ogre culls chunks whose surface is
+	// out of view even if the chunk isn't
+	setBoundingBox( Ogre::AxisAlignedBox( mesh.boundsLo[0], mesh.boundsLo[1], mesh.boundsLo[2],
+				mesh.boundsHi[0], mesh.boundsHi[1], mesh.boundsHi[2] ) );
+
+	std::copy( mesh.faceStart, mesh.faceStart + CHUNK_FACES + 1, faceStart );
+}
+
+void ChunkRenderable::clear()
+{
+	mRenderOp.vertexData->vertexCount = 0;
+	mRenderOp.indexData->indexCount = 0;
+
+	setBoundingBox( Ogre::AxisAlignedBox::BOX_NULL );
+}
+
+size_t ChunkRenderable::getBufferBytes() const
+{
+	return vertexCapacity * mRenderOp.vertexData->vertexDeclaration->getVertexSize(0) +
+		indexCapacity * (indexType == Ogre::HardwareIndexBuffer::IT_16BIT ? sizeof(uint16_t) : sizeof(uint32_t));
+}
+
+Ogre::Real ChunkRenderable::getSquaredViewDepth( const Ogre::Camera *cam ) const
+{
+	return (getParentSceneNode()->_getFullTransform() * mBox.getCenter() - cam->getDerivedPosition()).squaredLength();
+}
+
+Ogre::Real ChunkRenderable::getBoundingRadius() const
+{
+	return mBox.isNull() ? 0 : mBox.getHalfSize().length();
+}
+
+void ChunkRenderable::_notifyCurrentCamera( Ogre::Camera *cam )
+{
+	Ogre::SimpleRenderable::_notifyCurrentCamera( cam );
+
+	viewCamera = cam;
+}
+
+void ChunkRenderable::_updateRenderQueue( Ogre::RenderQueue *queue )
+{
+	if( mRenderOp.indexData->indexCount == 0 )
+	{
+		return;
+	}
+
+	uint8_t faces = CHUNK_ALL_FACES;
+
+	if( viewCamera != NULL )
+	{
+		// the eye in vertex units, the node only translates and scales
+		const Ogre::SceneNode *node = getParentSceneNode();
+		const Ogre::Vector3 local = (viewCamera->getDerivedPosition() - node->_getDerivedPosition()) / node->_getDerivedScale();
+
+		const float eye[3] = { local.x, local.y, local.z };
+		const float lo[3] = { mBox.getMinimum().x, mBox.getMinimum().y, mBox.getMinimum().z };
+		const float hi[3] = { mBox.getMaximum().x, mBox.getMaximum().y, mBox.getMaximum().z };
+
+		faces = visibleFaces( eye, lo, hi );
+	}
+
+	uint32_t start[CHUNK_MAX_RANGES], count[CHUNK_MAX_RANGES];
+	int n = visibleRanges( faces, faceStart, start, count );
+
+	for( int i = 0; i < n; i++ )
+	{
+		ranges[i].indexData.indexBuffer = mRenderOp.indexData->indexBuffer;
+		ranges[i].indexData.indexStart = start[i];
+		ranges[i].indexData.indexCount = count[i];
+
+		if( mRenderQueueIDSet )
+		{
+			queue->addRenderable( &ranges[i], mRenderQueueID );
+		}
+		else
+		{
+			queue->addRenderable( &ranges[i] );
+		}
+	}
+}
+
+void ChunkRenderable::FaceRange::getRenderOperation( Ogre::RenderOperation &op )
+{
+	owner->getRenderOperation( op );
+
+	op.indexData = &indexData;
+}
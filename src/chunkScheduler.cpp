@@ -0,0 +1,156 @@
+/*
+ * File:	chunkScheduler.cpp
+ * Author:	James Letendre
+ *
+ * Orders pending chunk work by distance and view direction
+ */
+#include "chunkScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+// how many latencies the percentiles are taken over
+#define LATENCY_HISTORY 256
+
+// chunks straight behind the camera count as this much further away than
+// chunks straight ahead
+#define BEHIND_PENALTY 2.0f
+
+ChunkScheduler::ChunkScheduler( int chunkSize, size_t capacity ) :
+	chunkSize(chunkSize), viewPosition(0,0,0), viewDirection(1,0,0), stale(false),
+	dropped(0), completed(0), latencyNext(0)
+{
+	heap.reserve( capacity );
+	latencies.reserve( LATENCY_HISTORY );
+	sorted.reserve( LATENCY_HISTORY );
+}
+
+void ChunkScheduler::setView( const PolyVox::Vector3DFloat &position, const PolyVox::Vector3DFloat &direction )
+{
+	PolyVox::Vector3DFloat dir( direction.getX(), 0, direction.getZ() );
+
+	if( dir.lengthSquared() > 0 )
+	{
+		dir.normalise();
+	}
+
+	if( !(position == viewPosition) || !(dir == viewDirection) )
+	{
+		viewPosition = position;
+		viewDirection = dir;
+		stale = true;
+	}
+}
+
+float ChunkScheduler::priority( const chunkCoord &coord ) const
+{
+	// offset from the camera to the chunk center, in full detail chunks
+	const float scale = (float)(1 << coord.lod);
+	float dx = (coord.x + 0.5f) * scale - viewPosition.getX() / chunkSize;
+	float dy = (coord.y + 0.5f) * scale - viewPosition.getY() / chunkSize;
+	float dz = (coord.z + 0.5f) * scale - viewPosition.getZ() / chunkSize;
+
+	float dist = sqrtf( dx*dx + dy*dy + dz*dz );
+
+	if( dist < 1e-3f )
+	{
+		return 0;
+	}
+
+	// 1 straight ahead, BEHIND_PENALTY straight behind
+	float facing = (dx * viewDirection.getX() + dz * viewDirection.getZ()) / dist;
+
+	return dist * (1.0f + (BEHIND_PENALTY - 1.0f) * (1.0f - facing) * 0.5f);
+}
+
+void ChunkScheduler::reprioritize()
+{
+	for( size_t i = 0; i < heap.size(); i++ )
+	{
+		heap[i].priority = priority( heap[i].coord );
+	}
+
+	std::make_heap( heap.begin(), heap.end() );
+	stale = false;
+}
+
+void ChunkScheduler::push( const chunkCoord &coord )
+{
+	Entry entry;
+	entry.coord = coord;
+	entry.priority = priority( coord );
+
+	heap.push_back( entry );
+
+	// a stale heap is rebuilt on the next pop anyway
+	if( !stale )
+	{
+		std::push_heap( heap.begin(), heap.end() );
+	}
+}
+
+bool ChunkScheduler::pop( chunkCoord &coord )
+{
+	if( heap.empty() )
+	{
+		return false;
+	}
+
+	if( stale )
+	{
+		reprioritize();
+	}
+
+	std::pop_heap( heap.begin(), heap.end() );
+	coord = heap.back().coord;
+	heap.pop_back();
+
+	return true;
+}
+
+void ChunkScheduler::chunkVisible( double latencyMs )
+{
+	if( latencies.size() < LATENCY_HISTORY )
+	{
+		latencies.push_back( latencyMs );
+	}
+	else
+	{
+		latencies[latencyNext] = latencyMs;
+	}
+	latencyNext = (latencyNext + 1) % LATENCY_HISTORY;
+
+	completed++;
+}
+
+ChunkSchedulerStats ChunkScheduler::getStats() const
+{
+	ChunkSchedulerStats stats;
+
+	stats.queued = heap.size();
+	stats.dropped = dropped;
+	stats.completed = completed;
+	stats.avgLatencyMs = 0;
+	stats.p95LatencyMs = 0;
+	stats.maxLatencyMs = 0;
+
+	if( latencies.empty() )
+	{
+		return stats;
+	}
+
+	sorted.assign( latencies.begin(), latencies.end() );
+	std::sort( sorted.begin(), sorted.end() );
+
+	double sum = 0;
+	for( size_t i = 0; i < sorted.size(); i++ )
+	{
+		sum += sorted[i];
+	}
+
+	stats.avgLatencyMs = sum / sorted.size();
+	stats.p95LatencyMs = sorted[ (sorted.size() - 1) * 95 / 100 ];
+	stats.maxLatencyMs = sorted.back();
+
+	return stats;
+}
@@ -0,0 +1,93 @@
+/*
+ * File:	chunkTable.cpp
+ * Author:	James Letendre
+ *
+ * Open addressed hash table holding the state of every known chunk
+ */
+#include "chunkTable.h"
+
+static ChunkRecord freeRecord()
+{
+	ChunkRecord rec;
+	rec.key = 0;
+	rec.meshId = -1;
+	rec.state = CHUNK_FREE;
+	rec.dirty = false;
+	rec.version = 0;
+	rec.requested = 0;
+	return rec;
+}
+
+ChunkTable::ChunkTable( size_t capacity ) :
+	count(0)
+{
+	size_t size = 16;
+	while( size < capacity )
+	{
+		size *= 2;
+	}
+
+	slots.assign( size, freeRecord() );
+	mask = size - 1;
+}
+
+bool ChunkTable::erase( const chunkCoord &coord )
+{
+	ChunkRecord *rec = find( coord );
+
+	if( rec == NULL )
+	{
+		return false;
+	}
+
+	// backward shift deletion, pull later entries of the probe run into the
+	// hole so lookups never need tombstones
+	size_t hole = rec - &slots[0];
+
+	for( size_t i = (hole + 1) & mask; slots[i].state != CHUNK_FREE; i = (i + 1) & mask )
+	{
+		size_t home = hash( slots[i].key ) & mask;
+
+		// entry may move if its home isn't cyclically inside (hole, i]
+		if( ((i - home) & mask) >= ((i - hole) & mask) )
+		{
+			slots[hole] = slots[i];
+			hole = i;
+		}
+	}
+
+	slots[hole] = freeRecord();
+	count--;
+
+	return true;
+}
+
+void ChunkTable::clear()
+{
+	slots.assign( slots.size(), freeRecord() );
+	count = 0;
+}
+
+void ChunkTable::grow()
+{
+	std::vector<ChunkRecord> old;
+	old.swap( slots );
+
+	slots.assign( old.size() * 2, freeRecord() );
+	mask = slots.size() - 1;
+
+	for( size_t i = 0; i < old.size(); i++ )
+	{
+		if( old[i].state == CHUNK_FREE )
+		{
+			continue;
+		}
+
+		size_t j = hash( old[i].key ) & mask;
+		while( slots[j].state != CHUNK_FREE )
+		{
+			j = (j + 1) & mask;
+		}
+		slots[j] = old[i];
+	}
+}
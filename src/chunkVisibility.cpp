@@ -0,0 +1,170 @@
+/*
+ * File:	chunkVisibility.cpp
+ * Author:	James Letendre
+ *
+ * Chunk level visibility: frustum culling, face direction culling and draw lists
+ */
+#include "chunkVisibility.h"
+
+#include <cmath>
+
+static PolyVox::Vector3DFloat cross( const PolyVox::Vector3DFloat &a, const PolyVox::Vector3DFloat &b )
+{
+	return PolyVox::Vector3DFloat( a.getY()*b.getZ() - a.getZ()*b.getY(), a.getZ()*b.getX() - a.getX()*b.getZ(),
+			a.getX()*b.getY() - a.getY()*b.getX() );
+}
+
+static void setPlane( float plane[4], const PolyVox::Vector3DFloat &normal, const PolyVox::Vector3DFloat &point )
+{
+	PolyVox::Vector3DFloat n = normal;
+	n.normalise();
+
+	plane[0] = n.getX();
+	plane[1] = n.getY();
+	plane[2] = n.getZ();
+	plane[3] = -n.dot( point );
+}
+
+void ViewFrustum::setPerspective( const PolyVox::Vector3DFloat &position, const PolyVox::Vector3DFloat &direction,
+		const PolyVox::Vector3DFloat &up, float fovY, float aspect, float nearDist, float farDist )
+{
+	PolyVox::Vector3DFloat forward = direction;
+	forward.normalise();
+
+	PolyVox::Vector3DFloat right = cross( forward, up );
+	right.normalise();
+
+	PolyVox::Vector3DFloat top = cross( right, forward );
+
+	const float halfV = tanf( fovY / 2 );
+	const float halfH = halfV * aspect;
+
+	setPlane( planes[0], forward, position + forward * nearDist );
+	setPlane( planes[1], forward * -1.0f, position + forward * farDist );
+
+	// side planes go through the eye, their normals lean in towards forward
+	setPlane( planes[2], right + forward * halfH, position );
+	setPlane( planes[3], right * -1.0f + forward * halfH, position );
+	setPlane( planes[4], top + forward * halfV, position );
+	setPlane( planes[5], top * -1.0f + forward * halfV, position );
+}
+
+bool ViewFrustum::intersects( const float lo[3], const float hi[3] ) const
+{
+	for( int i = 0; i < 6; i++ )
+	{
+		const float *plane = planes[i];
+
+		// the corner furthest along the plane normal
+		float x = (plane[0] >= 0) ? hi[0] : lo[0];
+		float y = (plane[1] >= 0) ? hi[1] : lo[1];
+		float z = (plane[2] >= 0) ? hi[2] : lo[2];
+
+		if( plane[0]*x + plane[1]*y + plane[2]*z + plane[3] < 0 )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+uint8_t visibleFaces( const float eye[3], const float lo[3], const float hi[3] )
+{
+	uint8_t faces = 0;
+
+	for( int axis = 0; axis < 3; axis++ )
+	{
+		// faces pointing down the axis need the eye below them
+		if( eye[axis] < hi[axis] )
+		{
+			faces |= 1 << (axis*2);
+		}
+		if( eye[axis] > lo[axis] )
+		{
+			faces |= 1 << (axis*2 + 1);
+		}
+	}
+
+	return faces;
+}
+
+int visibleRanges( uint8_t faces, const uint32_t faceStart[CHUNK_FACES + 1], uint32_t start[CHUNK_MAX_RANGES],
+		uint32_t count[CHUNK_MAX_RANGES] )
+{
+	int ranges = 0;
+
+	for( int f = 0; f < CHUNK_FACES; f++ )
+	{
+		if( !(faces & (1 << f)) || faceStart[f] == faceStart[f + 1] )
+		{
+			continue;
+		}
+
+		// continues the last range
+		if( ranges > 0 && start[ranges - 1] + count[ranges - 1] == faceStart[f] )
+		{
+			count[ranges - 1] += faceStart[f + 1] - faceStart[f];
+			continue;
+		}
+
+		// at least one side of every axis is visible, so there are never
+		// more than CHUNK_MAX_RANGES gaps
+		start[ranges] = faceStart[f];
+		count[ranges] = faceStart[f + 1] - faceStart[f];
+		ranges++;
+	}
+
+	return ranges;
+}
+
+void ChunkDrawInfo::set( int id, const ChunkMesh &mesh )
+{
+	const PolyVox::Vector3DInt32 &lower = mesh.region.getLowerCorner();
+	const float origin[3] = { lower.getX() - 0.5f, lower.getY() - 0.5f, lower.getZ() - 0.5f };
+	const float scale = (float)(1 << mesh.lod);
+
+	meshId = id;
+
+	for( int i = 0; i < 3; i++ )
+	{
+		lo[i] = origin[i] + mesh.boundsLo[i] * scale;
+		hi[i] = origin[i] + mesh.boundsHi[i] * scale;
+	}
+
+	for( int i = 0; i <= CHUNK_FACES; i++ )
+	{
+		faceStart[i] = mesh.faceStart[i];
+	}
+}
+
+void buildDrawList( const ViewFrustum &frustum, const PolyVox::Vector3DFloat &eye, const std::vector<ChunkDrawInfo> &chunks,
+		bool cullFaces, std::vector<ChunkDraw> &out )
+{
+	const float eyePos[3] = { eye.getX(), eye.getY(), eye.getZ() };
+
+	for( size_t i = 0; i < chunks.size(); i++ )
+	{
+		const ChunkDrawInfo &chunk = chunks[i];
+
+		if( chunk.faceStart[CHUNK_FACES] == 0 || !frustum.intersects( chunk.lo, chunk.hi ) )
+		{
+			continue;
+		}
+
+		uint8_t faces = cullFaces ? visibleFaces( eyePos, chunk.lo, chunk.hi ) : CHUNK_ALL_FACES;
+
+		uint32_t start[CHUNK_MAX_RANGES], count[CHUNK_MAX_RANGES];
+		int ranges = visibleRanges( faces, chunk.faceStart, start, count );
+
+		for( int r = 0; r < ranges; r++ )
+		{
+			ChunkDraw draw;
+			draw.meshId = chunk.meshId;
+			draw.indexStart = start[r];
+			draw.indexCount = count[r];
+
+			out.push_back( draw );
+		}
+	}
+}
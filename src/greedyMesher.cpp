@@ -0,0 +1,163 @@
+/*
+ * File:	greedyMesher.cpp
+ * Author:	James Letendre
+ *
+ * Greedy surface extraction, merges coplanar faces of the same material
+ */
+#include "greedyMesher.h"
+
+#include <algorithm>
+
+template <typename Index>
+static void fillIndices( std::vector<Index> &indices, size_t quads )
+{
+	indices.resize( quads * 6 );
+
+	for( size_t q = 0; q < quads; q++ )
+	{
+		Index base = q * 4;
+		Index *out = &indices[q * 6];
+
+		out[0] = base;
+		out[1] = base + 1;
+		out[2] = base + 2;
+		out[3] = base;
+		out[4] = base + 2;
+		out[5] = base + 3;
+	}
+}
+
+void greedyMesh( PolyVox::RawVolume<PolyVox::Material8> &snap, const PolyVox::Region &region, ChunkMesh &mesh,
+		std::vector<uint8_t> &scratch )
+{
+	mesh.clear();
+	mesh.region = region;
+
+	const PolyVox::Vector3DInt32 &lower = region.getLowerCorner();
+	const int dims[3] = { region.getWidthInVoxels(), region.getHeightInVoxels(), region.getDepthInVoxels() };
+
+	// flat copy of the materials with the border, voxel (x,y,z) of the
+	// region is at (x+1) + (y+1)*stride[1] + (z+1)*stride[2]
+	const int stride[3] = { 1, dims[0] + 2, (dims[0] + 2) * (dims[1] + 2) };
+	const int volumeSize = stride[2] * (dims[2] + 2);
+
+	// the materials, then a mask big enough for the largest slice
+	const int maxSlice = std::max( dims[0], std::max( dims[1], dims[2] ) );
+	scratch.resize( volumeSize + maxSlice * maxSlice );
+
+	uint8_t *materials = &scratch[0];
+	uint8_t *mask = &scratch[volumeSize];
+
+	for( int z = 0; z < dims[2] + 2; z++ )
+	{
+		for( int y = 0; y < dims[1] + 2; y++ )
+		{
+			for( int x = 0; x < dims[0] + 2; x++ )
+			{
+				materials[ x + y*stride[1] + z*stride[2] ] =
+					snap.getVoxelAt( lower.getX() + x - 1, lower.getY() + y - 1, lower.getZ() + z - 1 ).getMaterial();
+			}
+		}
+	}
+
+	for( int d = 0; d < 3; d++ )
+	{
+		const int u = (d + 1) % 3;
+		const int v = (d + 2) % 3;
+
+		for( int side = -1; side <= 1; side += 2 )
+		{
+			for( int slice = 0; slice < dims[d]; slice++ )
+			{
+				// faces of the slice which point to an empty neighbour, by material
+				const uint8_t *src = &materials[ stride[0] + stride[1] + stride[2] + slice*stride[d] ];
+				const int neighbour = side * stride[d];
+				uint8_t *row = mask;
+				bool empty = true;
+
+				for( int j = 0; j < dims[v]; j++, src += stride[v], row += dims[u] )
+				{
+					const uint8_t *voxel = src;
+
+					for( int i = 0; i < dims[u]; i++, voxel += stride[u] )
+					{
+						uint8_t face = (voxel[neighbour] == 0) ? voxel[0] : 0;
+
+						row[i] = face;
+						empty &= (face == 0);
+					}
+				}
+
+				if( empty )
+				{
+					continue;
+				}
+
+				// take the widest run, then grow it along v while whole rows match
+				for( int j = 0; j < dims[v]; j++ )
+				{
+					for( int i = 0; i < dims[u]; )
+					{
+						uint8_t material = mask[ i + j*dims[u] ];
+
+						if( material == 0 )
+						{
+							i++;
+							continue;
+						}
+
+						int w = 1;
+						while( i + w < dims[u] && mask[ i + w + j*dims[u] ] == material )
+						{
+							w++;
+						}
+
+						int h = 1;
+						for( ; j + h < dims[v]; h++ )
+						{
+							int k = 0;
+							while( k < w && mask[ i + k + (j+h)*dims[u] ] == material )
+							{
+								k++;
+							}
+
+							if( k < w )
+							{
+								break;
+							}
+						}
+
+						for( int y = 0; y < h; y++ )
+						{
+							for( int x = 0; x < w; x++ )
+							{
+								mask[ i + x + (j+y)*dims[u] ] = 0;
+							}
+						}
+
+						// in vertex space voxel n spans n..n+1
+						int origin[3];
+						origin[d] = (side > 0) ? slice + 1 : slice;
+						origin[u] = i;
+						origin[v] = j;
+
+						addChunkQuad( mesh, origin, u, v, w, h, side, material - 1 );
+
+						i += w;
+					}
+				}
+			}
+		}
+	}
+
+	size_t quads = mesh.vertices.size() / 4;
+
+	if( mesh.vertices.size() <= 65536 )
+	{
+		fillIndices( mesh.indices16, quads );
+	}
+	else
+	{
+		fillIndices( mesh.indices32, quads );
+	}
+}
@@ -0,0 +1,119 @@
+/*
+ * File:	heightfieldCache.cpp
+ * Author:	James Letendre
+ *
+ * Surface noise of chunk columns, computed once and kept in an LRU cache
+ */
+#include "heightfieldCache.h"
+#include "chunkTable.h"
+
+#include <algorithm>
+
+HeightfieldCache::HeightfieldCache( const NoiseEngine<float> &noise, int size, double scale, size_t capacity, TerrainMetrics *metrics ) :
+	noise(noise), size(size), scale(scale), metrics(metrics), capacity(capacity), hits(0), misses(0), evictions(0)
+{
+}
+
+void HeightfieldCache::build( int x, int z, int lod, HeightTile &tile ) const
+{
+	TerrainTimerScope timer( metrics, TIMER_NOISE );
+
+	const int step = 1 << lod;
+	const int samples = size + 2;
+
+	// lower corner of the border sample
+	const double x0 = (double)x * (size << lod) - step + step / 2;
+	const double z0 = (double)z * (size << lod) - step + step / 2;
+
+	tile.size = size;
+	tile.samples.resize( samples * samples );
+	noise.tile( x0 / scale, z0 / scale, step / scale, samples, samples, &tile.samples[0] );
+
+	tile.minimum = tile.maximum = tile.at( 0, 0 );
+	for( int j = 0; j < size; j++ )
+	{
+		for( int i = 0; i < size; i++ )
+		{
+			tile.minimum = std::min( tile.minimum, tile.at( i, j ) );
+			tile.maximum = std::max( tile.maximum, tile.at( i, j ) );
+		}
+	}
+}
+
+HeightfieldCache::tilePtr HeightfieldCache::get( int x, int z, int lod )
+{
+	const uint64_t key = ChunkTable::packKey( ChunkTable::chunkCoord( x, 0, z, lod ) );
+
+	{
+		boost::mutex::scoped_lock lock(mutex);
+
+		std::unordered_map<uint64_t, Entry>::iterator it = tiles.find( key );
+		if( it != tiles.end() )
+		{
+			lru.splice( lru.begin(), lru, it->second.used );
+			hits++;
+			return it->second.tile;
+		}
+		misses++;
+	}
+
+	// the noise is the expensive part, other tiles can be found meanwhile
+	std::shared_ptr<HeightTile> tile( new HeightTile );
+	build( x, z, lod, *tile );
+
+	boost::mutex::scoped_lock lock(mutex);
+
+	if( capacity == 0 )
+	{
+		return tile;
+	}
+
+	std::unordered_map<uint64_t, Entry>::iterator it = tiles.find( key );
+	if( it != tiles.end() )
+	{
+		return it->second.tile;
+	}
+
+	lru.push_front( key );
+
+	Entry &entry = tiles[key];
+	entry.tile = tile;
+	entry.used = lru.begin();
+
+	trim();
+
+	return tile;
+}
+
+void HeightfieldCache::trim()
+{
+	while( tiles.size() > capacity )
+	{
+		tiles.erase( lru.back() );
+		lru.pop_back();
+		evictions++;
+	}
+}
+
+void HeightfieldCache::setCapacity( size_t tiles )
+{
+	boost::mutex::scoped_lock lock(mutex);
+
+	capacity = tiles;
+	trim();
+}
+
+HeightfieldCacheStats HeightfieldCache::getStats()
+{
+	boost::mutex::scoped_lock lock(mutex);
+
+	HeightfieldCacheStats stats;
+	stats.tiles = tiles.size();
+	stats.capacity = capacity;
+	stats.bytes = tiles.size() * (sizeof(HeightTile) + (size + 2)*(size + 2)*sizeof(float));
+	stats.hits = hits;
+	stats.misses = misses;
+	stats.evictions = evictions;
+
+	return stats;
+}
@@ -0,0 +1,341 @@
+/*
+ * File:	occupancyGrid.cpp
+ * Author:	James Letendre
+ *
+ * One bit per voxel solid/empty copy of the paged in blocks, readable without locks
+ */
+#include "occupancyGrid.h"
+
+#include <cstring>
+
+// smallest table, a few view ranges worth of blocks
+#define MIN_TABLE_SIZE 1024
+
+// never dereferenced, only compared against
+OccupancyBlock *const OccupancyGrid::emptyBlock = (OccupancyBlock*)1;
+OccupancyBlock *const OccupancyGrid::solidBlock = (OccupancyBlock*)2;
+
+OccupancyGrid::OccupancyGrid() :
+	readers(0), mixedBlocks(0)
+{
+	table.store( newTable( MIN_TABLE_SIZE ) );
+}
+
+OccupancyGrid::~OccupancyGrid()
+{
+	Table *t = table.load();
+
+	for( size_t i = 0; i <= t->mask; i++ )
+	{
+		OccupancyBlock *block = t->slots[i].block.load();
+
+		if( isBits( block ) )
+		{
+			delete block;
+		}
+	}
+	deleteTable( t );
+
+	// nobody reads any more
+	reclaim();
+}
+
+OccupancyGrid::Table *OccupancyGrid::newTable( size_t size )
+{
+	Table *t = new Table;
+	t->mask = size - 1;
+	t->used = 0;
+	t->slots = new Slot[size];
+
+	for( size_t i = 0; i < size; i++ )
+	{
+		t->slots[i].key.store( 0, std::memory_order_relaxed );
+		t->slots[i].block.store( NULL, std::memory_order_relaxed );
+	}
+
+	return t;
+}
+
+void OccupancyGrid::deleteTable( Table *t )
+{
+	delete [] t->slots;
+	delete t;
+}
+
+uint64_t OccupancyGrid::key( int bx, int by, int bz )
+{
+	return (1ULL << 63) | ((uint64_t)(bx & 0x1fffff) << 42) | ((uint64_t)(by & 0x1fffff) << 21) | (uint64_t)(bz & 0x1fffff);
+}
+
+// 64 bit finalizer from murmur3, as ChunkTable
+size_t OccupancyGrid::hash( uint64_t key )
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return (size_t)key;
+}
+
+OccupancyState OccupancyGrid::lookup( int bx, int by, int bz, const OccupancyBlock *&block ) const
+{
+	const uint64_t k = key( bx, by, bz );
+
+	// sequentially consistent with the unlinking stores and readers, see reclaim
+	const Table *t = table.load();
+
+	for( size_t i = hash( k ) & t->mask;; i = (i + 1) & t->mask )
+	{
+		uint64_t slotKey = t->slots[i].key.load( std::memory_order_acquire );
+
+		if( slotKey == 0 )
+		{
+			return OCCUPANCY_UNKNOWN;
+		}
+		if( slotKey != k )
+		{
+			continue;
+		}
+
+		OccupancyBlock *b = t->slots[i].block.load();
+
+		if( b == NULL )
+		{
+			return OCCUPANCY_UNKNOWN;
+		}
+		if( b == emptyBlock )
+		{
+			return OCCUPANCY_EMPTY;
+		}
+		if( b == solidBlock )
+		{
+			return OCCUPANCY_SOLID;
+		}
+
+		block = b;
+		return OCCUPANCY_MIXED;
+	}
+}
+
+OccupancyGrid::Slot &OccupancyGrid::insert( uint64_t k )
+{
+	Table *t = table.load( std::memory_order_relaxed );
+
+	// keep the load factor under 1/2 so probes stay short
+	if( (t->used + 1) * 2 > t->mask + 1 )
+	{
+		rebuild();
+		t = table.load( std::memory_order_relaxed );
+	}
+
+	for( size_t i = hash( k ) & t->mask;; i = (i + 1) & t->mask )
+	{
+		Slot &slot = t->slots[i];
+		uint64_t slotKey = slot.key.load( std::memory_order_relaxed );
+
+		if( slotKey == k )
+		{
+			return slot;
+		}
+		if( slotKey == 0 )
+		{
+			// the block is NULL until the caller sets it, so readers finding
+			// the key early see an unknown block
+			slot.key.store( k, std::memory_order_release );
+			t->used++;
+			return slot;
+		}
+	}
+}
+
+void OccupancyGrid::rebuild()
+{
+	Table *old = table.load( std::memory_order_relaxed );
+
+	size_t live = 0;
+	for( size_t i = 0; i <= old->mask; i++ )
+	{
+		if( old->slots[i].block.load( std::memory_order_relaxed ) != NULL )
+		{
+			live++;
+		}
+	}
+
+	size_t size = MIN_TABLE_SIZE;
+	while( size < live * 4 )
+	{
+		size *= 2;
+	}
+
+	Table *t = newTable( size );
+
+	for( size_t i = 0; i <= old->mask; i++ )
+	{
+		OccupancyBlock *block = old->slots[i].block.load( std::memory_order_relaxed );
+
+		if( block == NULL )
+		{
+			continue;
+		}
+
+		uint64_t k = old->slots[i].key.load( std::memory_order_relaxed );
+		size_t j = hash( k ) & t->mask;
+
+		while( t->slots[j].key.load( std::memory_order_relaxed ) != 0 )
+		{
+			j = (j + 1) & t->mask;
+		}
+
+		t->slots[j].key.store( k, std::memory_order_relaxed );
+		t->slots[j].block.store( block, std::memory_order_relaxed );
+		t->used++;
+	}
+
+	// readers already in the old table finish there, the blocks are shared
+	table.store( t );
+	retiredTables.push_back( old );
+}
+
+void OccupancyGrid::replace( Slot &slot, OccupancyBlock *block )
+{
+	OccupancyBlock *old = slot.block.load( std::memory_order_relaxed );
+
+	slot.block.store( block );
+
+	if( isBits( old ) )
+	{
+		retiredBlocks.push_back( old );
+		mixedBlocks--;
+	}
+	if( isBits( block ) )
+	{
+		mixedBlocks++;
+	}
+}
+
+void OccupancyGrid::setUniform( int bx, int by, int bz, bool solid )
+{
+	replace( insert( key( bx, by, bz ) ), solid ? solidBlock : emptyBlock );
+}
+
+void OccupancyGrid::setRows( int bx, int by, int bz, const uint64_t *rows )
+{
+	const size_t count = OCCUPANCY_BLOCK*OCCUPANCY_BLOCK;
+
+	bool empty = true, solid = true;
+	for( size_t i = 0; i < count && (empty || solid); i++ )
+	{
+		empty = empty && rows[i] == 0;
+		solid = solid && rows[i] == ~0ULL;
+	}
+
+	if( empty || solid )
+	{
+		setUniform( bx, by, bz, solid );
+		return;
+	}
+
+	OccupancyBlock *block = new OccupancyBlock;
+	for( size_t i = 0; i < count; i++ )
+	{
+		block->rows[i].store( rows[i], std::memory_order_relaxed );
+	}
+
+	replace( insert( key( bx, by, bz ) ), block );
+}
+
+void OccupancyGrid::setVoxel( int x, int y, int z, bool solid )
+{
+	const int bx = x >> OCCUPANCY_SHIFT, by = y >> OCCUPANCY_SHIFT, bz = z >> OCCUPANCY_SHIFT;
+	const OccupancyBlock *found = NULL;
+	OccupancyState state = lookup( bx, by, bz, found );
+
+	if( state == OCCUPANCY_UNKNOWN || state == (solid ? OCCUPANCY_SOLID : OCCUPANCY_EMPTY) )
+	{
+		return;
+	}
+
+	OccupancyBlock *block = const_cast<OccupancyBlock*>( found );
+
+	// the first change to a uniform block gives it bits
+	if( state != OCCUPANCY_MIXED )
+	{
+		const uint64_t fill = (state == OCCUPANCY_SOLID) ? ~0ULL : 0;
+
+		block = new OccupancyBlock;
+		for( size_t i = 0; i < OCCUPANCY_BLOCK*OCCUPANCY_BLOCK; i++ )
+		{
+			block->rows[i].store( fill, std::memory_order_relaxed );
+		}
+	}
+
+	std::atomic<uint64_t> &row = block->rows[ (y & (OCCUPANCY_BLOCK-1)) + (z & (OCCUPANCY_BLOCK-1)) * OCCUPANCY_BLOCK ];
+	const uint64_t bit = 1ULL << (x & (OCCUPANCY_BLOCK-1));
+
+	if( solid )
+	{
+		row.fetch_or( bit, std::memory_order_relaxed );
+	}
+	else
+	{
+		row.fetch_and( ~bit, std::memory_order_relaxed );
+	}
+
+	if( state != OCCUPANCY_MIXED )
+	{
+		replace( insert( key( bx, by, bz ) ), block );
+	}
+}
+
+void OccupancyGrid::forget( int bx, int by, int bz )
+{
+	const uint64_t k = key( bx, by, bz );
+	Table *t = table.load( std::memory_order_relaxed );
+
+	for( size_t i = hash( k ) & t->mask;; i = (i + 1) & t->mask )
+	{
+		uint64_t slotKey = t->slots[i].key.load( std::memory_order_relaxed );
+
+		if( slotKey == 0 )
+		{
+			return;
+		}
+		if( slotKey == k )
+		{
+			replace( t->slots[i], NULL );
+			return;
+		}
+	}
+}
+
+void OccupancyGrid::reclaim()
+{
+	if( (retiredBlocks.empty() && retiredTables.empty()) || readers.load() != 0 )
+	{
+		return;
+	}
+
+	// every reader which started before these were unlinked has finished,
+	// and later ones can't find them. The unlinking stores, this load, the
+	// readers' count and their loads are all sequentially consistent, so a
+	// reader counted after this load sees the unlinked pointers
+	for( size_t i = 0; i < retiredBlocks.size(); i++ )
+	{
+		delete retiredBlocks[i];
+	}
+	for( size_t i = 0; i < retiredTables.size(); i++ )
+	{
+		deleteTable( retiredTables[i] );
+	}
+
+	retiredBlocks.clear();
+	retiredTables.clear();
+}
+
+size_t OccupancyGrid::getBytes() const
+{
+	const Table *t = table.load();
+
+	return mixedBlocks * sizeof(OccupancyBlock) + (t->mask + 1) * sizeof(Slot);
+}
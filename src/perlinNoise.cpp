@@ -6,66 +6,9 @@
  */
 
 #include "perlinNoise.h"
-#include <cmath>
-#include <iostream>
+#include "perlinNoiseKernels.h"
 
-using namespace std;
-
-static int *p = new int[512];
-
-double fade(double t) 
-{ 
-	return t * t * t * (t * (t * 6 - 15) + 10); 
-}
-
-double lerp(double t, double a, double b) 
-{ 
-	return a + t * (b - a); 
-}
-
-double grad(int hash, double x, double y, double z) 
-{
-	int h = hash & 15;                      // CONVERT LO 4 BITS OF HASH CODE
-	double u = h<8 ? x : y,                 // INTO 12 GRADIENT DIRECTIONS.
-		   v = h<4 ? y : h==12||h==14 ? x : z;
-	return ((h&1) == 0 ? u : -u) + ((h&2) == 0 ? v : -v);
-}
-
-double perlinNoise(double x, double y, double z) {
-	int X = (int)floor(x) & 255,                  // FIND UNIT CUBE THAT
-		Y = (int)floor(y) & 255,                  // CONTAINS POINT.
-		Z = (int)floor(z) & 255;
-
-	x -= floor(x);                                // FIND RELATIVE X,Y,Z
-	y -= floor(y);                                // OF POINT IN CUBE.
-	z -= floor(z);
-
-	double u = fade(x),                                // COMPUTE FADE CURVES
-		   v = fade(y),                                // FOR EACH OF X,Y,Z.
-		   w = fade(z);
-
-	int A = p[X  ]+Y, AA = p[A]+Z, AB = p[A+1]+Z,      // HASH COORDINATES OF
-		B = p[X+1]+Y, BA = p[B]+Z, BB = p[B+1]+Z;      // THE 8 CUBE CORNERS,
-
-	double ret = lerp(w, 
-			lerp(v, 
-				lerp(u, 
-					grad(p[AA  ], x  , y  , z   ),  // AND ADD
-					grad(p[BA  ], x-1, y  , z   )), // BLENDED
-				lerp(u, 
-					grad(p[AB  ], x  , y-1, z   ),  // RESULTS
-					grad(p[BB  ], x-1, y-1, z   ))),// FROM  8
-			lerp(v, 
-				lerp(u, 
-					grad(p[AA+1], x  , y  , z-1 ),  // CORNERS
-					grad(p[BA+1], x-1, y  , z-1 )), // OF CUBE
-				lerp(u, 
-					grad(p[AB+1], x  , y-1, z-1 ),
-					grad(p[BB+1], x-1, y-1, z-1 ))));
-
-	return ret;
-}
-const int permutation[] = { 151,160,137,91,90,15,
+static const int permutation[] = { 151,160,137,91,90,15,
 	131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,21,10,23,
 	190, 6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,
 	88,237,149,56,87,174,20,125,136,171,168, 68,175,74,165,71,134,139,48,27,166,
@@ -80,9 +23,107 @@ const int permutation[] = { 151,160,137,91,90,15,
 	138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180
 };
 
-void initPerlinNoise() 
-{ 
-	for (int i=0; i < 256 ; i++) 
-		p[256+i] = p[i] = permutation[i]; 
+// splitmix64, any seed gives a well mixed sequence
+static uint64_t nextRandom( uint64_t &state )
+{
+	uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+void perlinPermutation( uint32_t seed, int *p )
+{
+	for( int i = 0; i < 256; i++ )
+	{
+		p[i] = permutation[i];
+	}
+
+	// other seeds shuffle the reference permutation
+	if( seed != 0 )
+	{
+		uint64_t state = seed;
+
+		for( int i = 255; i > 0; i-- )
+		{
+			int j = nextRandom( state ) % (i + 1);
+			int t = p[i]; p[i] = p[j]; p[j] = t;
+		}
+	}
+
+	for( int i = 0; i < 256; i++ )
+	{
+		p[256 + i] = p[i];
+	}
 }
 
+void perlinNoiseTileScalar( const int *p, double x, double y, double step, int countX, int countY, float *out )
+{
+	PerlinAxis ax(x);
+
+	for( int j = 0; j < countY; j++ )
+	{
+		PerlinAxis ay( y + j*step );
+		int Y = ay.cell & 255;
+
+		for( int i = 0; i < countX; i++ )
+		{
+			out[j*countX + i] = perlinRowSample( p, ax, step, i, Y, ay.frac );
+		}
+	}
+}
+
+bool perlinKernelSupported( PerlinKernel kernel )
+{
+	switch( kernel )
+	{
+		case PERLIN_BEST:
+		case PERLIN_SCALAR:
+			return true;
+#ifdef PERLIN_NOISE_SIMD
+		case PERLIN_SSE2:
+			return __builtin_cpu_supports("sse2");
+		case PERLIN_AVX2:
+			return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+		default:
+			return false;
+	}
+}
+
+typedef void (*perlinTileFunc)( const int *p, double x, double y, double step, int countX, int countY, float *out );
+
+static perlinTileFunc perlinKernel( PerlinKernel kernel )
+{
+	if( kernel == PERLIN_BEST )
+	{
+		// resolved once, the cpu isn't going to change under us
+		static const PerlinKernel best = 
+			perlinKernelSupported(PERLIN_AVX2) ? PERLIN_AVX2 :
+			perlinKernelSupported(PERLIN_SSE2) ? PERLIN_SSE2 : PERLIN_SCALAR;
+
+		kernel = best;
+	}
+
+	if( !perlinKernelSupported( kernel ) )
+	{
+		kernel = PERLIN_SCALAR;
+	}
+
+	switch( kernel )
+	{
+#ifdef PERLIN_NOISE_SIMD
+		case PERLIN_SSE2:
+			return perlinNoiseTileSSE2;
+		case PERLIN_AVX2:
+			return perlinNoiseTileAVX2;
+#endif
+		default:
+			return perlinNoiseTileScalar;
+	}
+}
+
+void perlinNoiseTile( const int *p, double x, double y, double step, int countX, int countY, float *out, PerlinKernel kernel )
+{
+	perlinKernel( kernel )( p, x, y, step, countX, countY, out );
+}
@@ -0,0 +1,104 @@
+/*
+ * File:	perlinNoiseAVX2.cpp
+ * Author:	James Letendre
+ *
+ * AVX2/FMA Perlin noise tile kernel, 8 samples per iteration
+ */
+
+#include "perlinNoiseKernels.h"
+
+#include <immintrin.h>
+
+static inline __m256i lookup( const int *p, __m256i idx )
+{
+	return _mm256_i32gather_epi32( p, idx, 4 );
+}
+
+static inline __m256 fade( __m256 t )
+{
+	__m256 r = _mm256_fmsub_ps( t, _mm256_set1_ps(6), _mm256_set1_ps(15) );
+	r = _mm256_fmadd_ps( t, r, _mm256_set1_ps(10) );
+	return _mm256_mul_ps( _mm256_mul_ps( _mm256_mul_ps( t, t ), t ), r );
+}
+
+static inline __m256 lerp( __m256 t, __m256 a, __m256 b )
+{
+	return _mm256_fmadd_ps( t, _mm256_sub_ps( b, a ), a );
+}
+
+static inline __m256 grad( __m256i hash, __m256 x, __m256 y )
+{
+	__m256i h = _mm256_and_si256( hash, _mm256_set1_epi32(15) );
+
+	__m256 lt8 = _mm256_castsi256_ps( _mm256_cmpgt_epi32( _mm256_set1_epi32(8), h ) );
+	__m256 lt4 = _mm256_castsi256_ps( _mm256_cmpgt_epi32( _mm256_set1_epi32(4), h ) );
+	__m256 isX = _mm256_castsi256_ps( _mm256_or_si256(
+				_mm256_cmpeq_epi32( h, _mm256_set1_epi32(12) ),
+				_mm256_cmpeq_epi32( h, _mm256_set1_epi32(14) ) ) );
+
+	__m256 u = _mm256_blendv_ps( y, x, lt8 );
+	__m256 v = _mm256_blendv_ps( _mm256_and_ps( isX, x ), y, lt4 );
+
+	// flip the sign bits with bits 0 and 1 of the hash
+	__m256 signU = _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_and_si256( h, _mm256_set1_epi32(1) ), 31 ) );
+	__m256 signV = _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_and_si256( h, _mm256_set1_epi32(2) ), 30 ) );
+
+	return _mm256_add_ps( _mm256_xor_ps( u, signU ), _mm256_xor_ps( v, signV ) );
+}
+
+void perlinNoiseTileAVX2( const int *p, double x, double y, double step, int countX, int countY, float *out )
+{
+	PerlinAxis ax(x);
+
+	const __m256i mask = _mm256_set1_epi32(255);
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256 onef = _mm256_set1_ps(1);
+	const __m256 lane = _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0);
+	const __m256 stepv = _mm256_set1_ps(step);
+	const __m256 frac = _mm256_set1_ps(ax.frac);
+	const __m256i cell = _mm256_set1_epi32(ax.cell);
+
+	for( int j = 0; j < countY; j++ )
+	{
+		PerlinAxis ay( y + j*step );
+		int Y = ay.cell & 255;
+
+		const __m256i Yv = _mm256_set1_epi32(Y);
+		const __m256 yv = _mm256_set1_ps(ay.frac);
+		const __m256 y1 = _mm256_sub_ps( yv, onef );
+		const __m256 v = _mm256_set1_ps(perlinFade(ay.frac));
+
+		float *row = out + j*countX;
+		int i = 0;
+
+		for( ; i + 8 <= countX; i += 8 )
+		{
+			__m256 t = _mm256_fmadd_ps( _mm256_add_ps( _mm256_set1_ps(i), lane ), stepv, frac );
+			__m256 fl = _mm256_floor_ps( t );
+			__m256 xv = _mm256_sub_ps( t, fl );
+
+			__m256i X = _mm256_and_si256( _mm256_add_epi32( cell, _mm256_cvttps_epi32( fl ) ), mask );
+
+			__m256i A  = _mm256_add_epi32( lookup( p, X ), Yv );
+			__m256i B  = _mm256_add_epi32( lookup( p, _mm256_add_epi32( X, one ) ), Yv );
+			__m256i AA = lookup( p, A );
+			__m256i AB = lookup( p, _mm256_add_epi32( A, one ) );
+			__m256i BA = lookup( p, B );
+			__m256i BB = lookup( p, _mm256_add_epi32( B, one ) );
+
+			__m256 u = fade( xv );
+			__m256 x1 = _mm256_sub_ps( xv, onef );
+
+			__m256 r = lerp( v,
+					lerp( u, grad( lookup( p, AA ), xv, yv ), grad( lookup( p, BA ), x1, yv ) ),
+					lerp( u, grad( lookup( p, AB ), xv, y1 ), grad( lookup( p, BB ), x1, y1 ) ) );
+
+			_mm256_storeu_ps( row + i, r );
+		}
+
+		for( ; i < countX; i++ )
+		{
+			row[i] = perlinRowSample( p, ax, step, i, Y, ay.frac );
+		}
+	}
+}
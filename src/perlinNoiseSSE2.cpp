@@ -0,0 +1,118 @@
+/*
+ * File:	perlinNoiseSSE2.cpp
+ * Author:	James Letendre
+ *
+ * SSE2 Perlin noise tile kernel, 4 samples per iteration
+ */
+
+#include "perlinNoiseKernels.h"
+
+#include <emmintrin.h>
+
+// SSE2 has no gather, look the hashes up one lane at a time
+static inline __m128i lookup( const int *p, __m128i idx )
+{
+	int lanes[4] __attribute__((aligned(16)));
+	_mm_store_si128( (__m128i*)lanes, idx );
+
+	return _mm_set_epi32( p[lanes[3]], p[lanes[2]], p[lanes[1]], p[lanes[0]] );
+}
+
+static inline __m128 select( __m128 mask, __m128 a, __m128 b )
+{
+	return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+}
+
+static inline __m128 fade( __m128 t )
+{
+	__m128 r = _mm_sub_ps( _mm_mul_ps( t, _mm_set1_ps(6) ), _mm_set1_ps(15) );
+	r = _mm_add_ps( _mm_mul_ps( t, r ), _mm_set1_ps(10) );
+	return _mm_mul_ps( _mm_mul_ps( _mm_mul_ps( t, t ), t ), r );
+}
+
+static inline __m128 lerp( __m128 t, __m128 a, __m128 b )
+{
+	return _mm_add_ps( a, _mm_mul_ps( t, _mm_sub_ps( b, a ) ) );
+}
+
+static inline __m128 grad( __m128i hash, __m128 x, __m128 y )
+{
+	__m128i h = _mm_and_si128( hash, _mm_set1_epi32(15) );
+
+	__m128 lt8 = _mm_castsi128_ps( _mm_cmplt_epi32( h, _mm_set1_epi32(8) ) );
+	__m128 lt4 = _mm_castsi128_ps( _mm_cmplt_epi32( h, _mm_set1_epi32(4) ) );
+	__m128 isX = _mm_castsi128_ps( _mm_or_si128(
+				_mm_cmpeq_epi32( h, _mm_set1_epi32(12) ),
+				_mm_cmpeq_epi32( h, _mm_set1_epi32(14) ) ) );
+
+	__m128 u = select( lt8, x, y );
+	__m128 v = select( lt4, y, _mm_and_ps( isX, x ) );
+
+	// flip the sign bits with bits 0 and 1 of the hash
+	__m128 signU = _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( h, _mm_set1_epi32(1) ), 31 ) );
+	__m128 signV = _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( h, _mm_set1_epi32(2) ), 30 ) );
+
+	return _mm_add_ps( _mm_xor_ps( u, signU ), _mm_xor_ps( v, signV ) );
+}
+
+static inline __m128 floorps( __m128 t )
+{
+	__m128 f = _mm_cvtepi32_ps( _mm_cvttps_epi32( t ) );
+	return _mm_sub_ps( f, _mm_and_ps( _mm_cmpgt_ps( f, t ), _mm_set1_ps(1) ) );
+}
+
+void perlinNoiseTileSSE2( const int *p, double x, double y, double step, int countX, int countY, float *out )
+{
+	PerlinAxis ax(x);
+
+	const __m128i mask = _mm_set1_epi32(255);
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128 onef = _mm_set1_ps(1);
+	const __m128 lane = _mm_set_ps(3, 2, 1, 0);
+	const __m128 stepv = _mm_set1_ps(step);
+	const __m128i cell = _mm_set1_epi32(ax.cell);
+
+	for( int j = 0; j < countY; j++ )
+	{
+		PerlinAxis ay( y + j*step );
+		int Y = ay.cell & 255;
+
+		const __m128i Yv = _mm_set1_epi32(Y);
+		const __m128 yv = _mm_set1_ps(ay.frac);
+		const __m128 v = _mm_set1_ps(perlinFade(ay.frac));
+
+		float *row = out + j*countX;
+		int i = 0;
+
+		for( ; i + 4 <= countX; i += 4 )
+		{
+			__m128 t = _mm_add_ps( _mm_set1_ps(ax.frac), _mm_mul_ps( _mm_add_ps( _mm_set1_ps(i), lane ), stepv ) );
+			__m128 fl = floorps( t );
+			__m128 xv = _mm_sub_ps( t, fl );
+
+			__m128i X = _mm_and_si128( _mm_add_epi32( cell, _mm_cvttps_epi32( fl ) ), mask );
+
+			__m128i A  = _mm_add_epi32( lookup( p, X ), Yv );
+			__m128i B  = _mm_add_epi32( lookup( p, _mm_add_epi32( X, one ) ), Yv );
+			__m128i AA = lookup( p, A );
+			__m128i AB = lookup( p, _mm_add_epi32( A, one ) );
+			__m128i BA = lookup( p, B );
+			__m128i BB = lookup( p, _mm_add_epi32( B, one ) );
+
+			__m128 u = fade( xv );
+			__m128 x1 = _mm_sub_ps( xv, onef );
+			__m128 y1 = _mm_sub_ps( yv, onef );
+
+			__m128 r = lerp( v,
+					lerp( u, grad( lookup( p, AA ), xv, yv ), grad( lookup( p, BA ), x1, yv ) ),
+					lerp( u, grad( lookup( p, AB ), xv, y1 ), grad( lookup( p, BB ), x1, y1 ) ) );
+
+			_mm_storeu_ps( row + i, r );
+		}
+
+		for( ; i < countX; i++ )
+		{
+			row[i] = perlinRowSample( p, ax, step, i, Y, ay.frac );
+		}
+	}
+}
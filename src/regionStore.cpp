@@ -0,0 +1,702 @@
+/*
+ * File:	regionStore.cpp
+ * Author:	James Letendre
+ *
+ * On disk store of modified volume blocks, grouped into region files
+ */
+#include "regionStore.h"
+#include "runLength.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+
+#define REGION_MAGIC 0x47525856		// "VXRG"
+#define REGION_VERSION 1
+
+// more than this and every file is closed again
+#define MAX_OPEN_REGIONS 64
+
+// blocks written per sync, at most MAX_OPEN_REGIONS so a batch's files fit
+#define MAX_WRITE_BATCH 64
+
+// a block failing this many writes more is dropped
+#define MAX_WRITE_RETRIES 3
+
+#define REGION_TABLE_SIZE (REGION_BLOCKS*REGION_BLOCKS*REGION_BLOCKS)
+
+static int floorDiv( int a, int b )
+{
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+// FNV-1a
+static uint32_t checksum( const uint8_t *data, size_t size )
+{
+	uint32_t hash = 2166136261u;
+
+	for( size_t i = 0; i < size; i++ )
+	{
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+	return hash;
+}
+
+RegionStore::RegionStore( const std::string &directory, int blockSize ) :
+	directory(directory), blockSize(blockSize), generation(0), writing(false), stopping(false)
+{
+	if( mkdir( directory.c_str(), 0755 ) != 0 && errno != EEXIST )
+	{
+		std::cout << "RegionStore: can't create " << directory << ": " << strerror(errno) << std::endl;
+	}
+
+	writer = boost::thread( boost::bind( &RegionStore::writerLoop, this ) );
+}
+
+RegionStore::~RegionStore()
+{
+	{
+		boost::mutex::scoped_lock lock(pending_mutex);
+		stopping = true;
+	}
+	pending_cond.notify_all();
+
+	writer.join();
+
+	closeAll();
+}
+
+bool RegionStore::load( int bx, int by, int bz, std::vector<uint8_t> &voxels )
+{
+	const uint64_t key = blockKey( bx, by, bz );
+	voxels.resize( blockSize * blockSize * blockSize );
+
+	{
+		boost::mutex::scoped_lock lock(pending_mutex);
+
+		std::unordered_map<uint64_t, std::vector<uint8_t> >::const_iterator it = pending.find( key );
+		if( it != pending.end() )
+		{
+			voxels = it->second;
+			return true;
+		}
+
+		it = inflight.find( key );
+		if( it != inflight.end() )
+		{
+			voxels = it->second;
+			return true;
+		}
+	}
+
+	boost::mutex::scoped_lock io(io_mutex);
+
+	RegionFile *file = openRegion( bx, by, bz, false );
+	if( file == NULL )
+	{
+		return false;
+	}
+	const int fd = file->fd;
+
+	int lx = bx - floorDiv( bx, REGION_BLOCKS ) * REGION_BLOCKS;
+	int ly = by - floorDiv( by, REGION_BLOCKS ) * REGION_BLOCKS;
+	int lz = bz - floorDiv( bz, REGION_BLOCKS ) * REGION_BLOCKS;
+	off_t entryOffset = sizeof(Header) + (lx + ly*REGION_BLOCKS + lz*REGION_BLOCKS*REGION_BLOCKS) * sizeof(Entry);
+
+	Entry entry;
+	if( pread( fd, &entry, sizeof(entry), entryOffset ) != sizeof(entry) || entry.length == 0 )
+	{
+		return false;
+	}
+
+	// runs are two bytes each and at most one per voxel, anything longer
+	// is a damaged table and mustn't size the buffer
+	if( entry.length > 2 * voxels.size() )
+	{
+		std::cout << "RegionStore: block " << bx << "," << by << "," << bz << " is damaged, regenerating" << std::endl;
+		return false;
+	}
+
+	compressed.resize( entry.length );
+
+	if( entry.voxels != voxels.size() ||
+		pread( fd, &compressed[0], entry.length, entry.offset ) != (ssize_t)entry.length ||
+		checksum( &compressed[0], entry.length ) != entry.checksum ||
+		!runLengthDecode( &compressed[0], entry.length, &voxels[0], voxels.size() ) )
+	{
+		std::cout << "RegionStore: block " << bx << "," << by << "," << bz << " is damaged, regenerating" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void RegionStore::store( int bx, int by, int bz, std::vector<uint8_t> &voxels )
+{
+	const uint64_t key = blockKey( bx, by, bz );
+
+	{
+		boost::mutex::scoped_lock lock(pending_mutex);
+
+		std::vector<uint8_t> &slot = pending[key];
+
+		// a newer copy replaces one still waiting, it keeps its place in line
+		if( slot.empty() )
+		{
+			order.push_back( key );
+		}
+		slot.swap( voxels );
+	}
+	pending_cond.notify_one();
+}
+
+void RegionStore::flush()
+{
+	boost::mutex::scoped_lock lock(pending_mutex);
+
+	while( !order.empty() || writing )
+	{
+		flushed_cond.wait( lock );
+	}
+}
+
+void RegionStore::list( std::vector<uint64_t> &keys )
+{
+	{
+		boost::mutex::scoped_lock lock(pending_mutex);
+
+		for( std::unordered_map<uint64_t, std::vector<uint8_t> >::const_iterator it = pending.begin(); it != pending.end(); ++it )
+		{
+			keys.push_back( it->first );
+		}
+	}
+
+	boost::mutex::scoped_lock io(io_mutex);
+
+	DIR *dir = opendir( directory.c_str() );
+	if( dir == NULL )
+	{
+		return;
+	}
+
+	std::vector<Entry> table( REGION_TABLE_SIZE );
+
+	while( struct dirent *ent = readdir( dir ) )
+	{
+		int rx, ry, rz;
+		char tail;
+
+		if( sscanf( ent->d_name, "r.%d.%d.%d.vx%c", &rx, &ry, &rz, &tail ) != 4 || tail != 'r' )
+		{
+			continue;
+		}
+
+		RegionFile *file = openRegion( rx * REGION_BLOCKS, ry * REGION_BLOCKS, rz * REGION_BLOCKS, false );
+		if( file == NULL ||
+			pread( file->fd, &table[0], REGION_TABLE_SIZE * sizeof(Entry), sizeof(Header) ) != (ssize_t)(REGION_TABLE_SIZE * sizeof(Entry)) )
+		{
+			continue;
+		}
+
+		for( int i = 0; i < REGION_TABLE_SIZE; i++ )
+		{
+			if( table[i].length != 0 )
+			{
+				keys.push_back( blockKey( rx * REGION_BLOCKS + i % REGION_BLOCKS,
+							ry * REGION_BLOCKS + (i / REGION_BLOCKS) % REGION_BLOCKS,
+							rz * REGION_BLOCKS + i / (REGION_BLOCKS * REGION_BLOCKS) ) );
+			}
+		}
+	}
+
+	closedir( dir );
+}
+
+void RegionStore::clear()
+{
+	flush();
+
+	boost::mutex::scoped_lock io(io_mutex);
+	closeAll();
+
+	DIR *dir = opendir( directory.c_str() );
+	if( dir == NULL )
+	{
+		return;
+	}
+
+	while( struct dirent *ent = readdir( dir ) )
+	{
+		std::string name = ent->d_name;
+
+		if( name.size() > 6 && name.compare( 0, 2, "r." ) == 0 && name.compare( name.size() - 4, 4, ".vxr" ) == 0 )
+		{
+			unlink( (directory + "/" + name).c_str() );
+		}
+	}
+
+	closedir( dir );
+}
+
+uint64_t RegionStore::regionKey( int bx, int by, int bz )
+{
+	return blockKey( floorDiv( bx, REGION_BLOCKS ), floorDiv( by, REGION_BLOCKS ), floorDiv( bz, REGION_BLOCKS ) );
+}
+
+RegionStore::RegionFile *RegionStore::openRegion( int bx, int by, int bz, bool create )
+{
+	int rx = floorDiv( bx, REGION_BLOCKS );
+	int ry = floorDiv( by, REGION_BLOCKS );
+	int rz = floorDiv( bz, REGION_BLOCKS );
+	uint64_t key = regionKey( bx, by, bz );
+
+	std::map<uint64_t, RegionFile>::iterator it = files.find( key );
+	if( it != files.end() )
+	{
+		return &it->second;
+	}
+
+	std::ostringstream path;
+	path << directory << "/r." << rx << "." << ry << "." << rz << ".vxr";
+
+	int fd = open( path.str().c_str(), create ? (O_RDWR | O_CREAT) : O_RDWR, 0644 );
+	if( fd == -1 )
+	{
+		if( errno != ENOENT )
+		{
+			std::cout << "RegionStore: can't open " << path.str() << ": " << strerror(errno) << std::endl;
+		}
+		return NULL;
+	}
+
+	Header header;
+	ssize_t got = pread( fd, &header, sizeof(header), 0 );
+
+	if( got == 0 && create )
+	{
+		// new file, an all zero table means no blocks
+		header.magic = REGION_MAGIC;
+		header.version = REGION_VERSION;
+		header.blockSize = blockSize;
+		header.regionBlocks = REGION_BLOCKS;
+
+		if( pwrite( fd, &header, sizeof(header), 0 ) != sizeof(header) ||
+			ftruncate( fd, sizeof(Header) + REGION_TABLE_SIZE * sizeof(Entry) ) != 0 )
+		{
+			std::cout << "RegionStore: can't write " << path.str() << ": " << strerror(errno) << std::endl;
+			close( fd );
+			return NULL;
+		}
+	}
+	else if( got != sizeof(header) || header.magic != REGION_MAGIC || header.version != REGION_VERSION ||
+			header.blockSize != (uint32_t)blockSize || header.regionBlocks != REGION_BLOCKS )
+	{
+		std::cout << "RegionStore: " << path.str() << " isn't a region file for this world, ignoring it" << std::endl;
+		close( fd );
+		return NULL;
+	}
+
+	RegionFile file;
+	file.fd = fd;
+
+	if( !scanFreeSpace( file ) )
+	{
+		std::cout << "RegionStore: can't read the table of " << path.str() << ", ignoring it" << std::endl;
+		close( fd );
+		return NULL;
+	}
+
+	if( files.size() >= MAX_OPEN_REGIONS )
+	{
+		closeAll();
+	}
+
+	RegionFile &slot = files[key];
+	slot.fd = fd;
+	slot.freeSpace.swap( file.freeSpace );
+	slot.end = file.end;
+	return &slot;
+}
+
+void RegionStore::closeAll()
+{
+	for( std::map<uint64_t, RegionFile>::const_iterator it = files.begin(); it != files.end(); ++it )
+	{
+		// reopening finds released extents free from the table, so the
+		// entries which gave them up must be on disk first
+		if( !it->second.released.empty() )
+		{
+			fdatasync( it->second.fd );
+		}
+		close( it->second.fd );
+	}
+	files.clear();
+	generation++;
+}
+
+// add an extent to a free list, merging it with its neighbours
+static void addFree( std::map<uint32_t, uint32_t> &freeSpace, uint32_t offset, uint32_t length )
+{
+	std::map<uint32_t, uint32_t>::iterator next = freeSpace.lower_bound( offset );
+
+	if( next != freeSpace.end() && offset + length == next->first )
+	{
+		length += next->second;
+		next = freeSpace.erase( next );
+	}
+
+	if( next != freeSpace.begin() )
+	{
+		std::map<uint32_t, uint32_t>::iterator prev = next;
+		--prev;
+
+		if( prev->first + prev->second == offset )
+		{
+			prev->second += length;
+			return;
+		}
+	}
+
+	freeSpace.insert( next, std::make_pair( offset, length ) );
+}
+
+bool RegionStore::scanFreeSpace( RegionFile &file )
+{
+	std::vector<Entry> table( REGION_TABLE_SIZE );
+
+	if( pread( file.fd, &table[0], REGION_TABLE_SIZE * sizeof(Entry), sizeof(Header) ) != (ssize_t)(REGION_TABLE_SIZE * sizeof(Entry)) )
+	{
+		return false;
+	}
+
+	std::vector<std::pair<uint32_t, uint32_t> > used;
+	for( int i = 0; i < REGION_TABLE_SIZE; i++ )
+	{
+		if( table[i].length != 0 )
+		{
+			used.push_back( std::make_pair( table[i].offset, table[i].length ) );
+		}
+	}
+	std::sort( used.begin(), used.end() );
+
+	// everything between the stored blocks is free, so is the tail past
+	// the last one, left by a write which never got its table entry
+	uint32_t pos = sizeof(Header) + REGION_TABLE_SIZE * sizeof(Entry);
+
+	file.freeSpace.clear();
+	file.released.clear();
+
+	for( size_t i = 0; i < used.size(); i++ )
+	{
+		if( used[i].first > pos )
+		{
+			addFree( file.freeSpace, pos, used[i].first - pos );
+		}
+		pos = std::max( pos, used[i].first + used[i].second );
+	}
+
+	file.end = pos;
+	return true;
+}
+
+uint32_t RegionStore::allocate( RegionFile &file, uint32_t length )
+{
+	// first fit, the blocks of a region are of similar sizes
+	for( std::map<uint32_t, uint32_t>::iterator it = file.freeSpace.begin(); it != file.freeSpace.end(); ++it )
+	{
+		if( it->second >= length )
+		{
+			uint32_t offset = it->first;
+			uint32_t left = it->second - length;
+
+			file.freeSpace.erase( it );
+			if( left != 0 )
+			{
+				file.freeSpace[ offset + length ] = left;
+			}
+			return offset;
+		}
+	}
+
+	uint32_t offset = file.end;
+	file.end += length;
+	return offset;
+}
+
+void RegionStore::release( RegionFile &file, uint32_t offset, uint32_t length )
+{
+	file.released.push_back( std::make_pair( offset, length ) );
+}
+
+void RegionStore::writeData( Write &w, std::map<uint64_t, Sync> &syncs )
+{
+	int bx, by, bz;
+	unpackBlockKey( w.key, bx, by, bz );
+	w.written = false;
+
+	RegionFile *file = openRegion( bx, by, bz, true );
+	if( file == NULL )
+	{
+		return;
+	}
+	const std::vector<uint8_t> &voxels = *w.voxels;
+
+	runLengthEncode( &voxels[0], voxels.size(), compressed );
+
+	int lx = bx - floorDiv( bx, REGION_BLOCKS ) * REGION_BLOCKS;
+	int ly = by - floorDiv( by, REGION_BLOCKS ) * REGION_BLOCKS;
+	int lz = bz - floorDiv( bz, REGION_BLOCKS ) * REGION_BLOCKS;
+	w.entryOffset = sizeof(Header) + (lx + ly*REGION_BLOCKS + lz*REGION_BLOCKS*REGION_BLOCKS) * sizeof(Entry);
+
+	if( pread( file->fd, &w.old, sizeof(w.old), w.entryOffset ) != sizeof(w.old) )
+	{
+		memset( &w.old, 0, sizeof(w.old) );
+	}
+
+	// never over the stored copy, until the new entry is written the old
+	// one is the block
+	w.entry.length = compressed.size();
+	w.entry.offset = allocate( *file, w.entry.length );
+	w.entry.checksum = checksum( &compressed[0], compressed.size() );
+	w.entry.voxels = voxels.size();
+
+	std::map<uint64_t, Sync>::iterator sync = syncs.find( w.region );
+	if( sync == syncs.end() )
+	{
+		Sync s;
+		s.fd = dup( file->fd );
+		s.released = file->released.size();
+		s.ok = true;
+
+		if( s.fd == -1 )
+		{
+			std::cout << "RegionStore: writing block " << bx << "," << by << "," << bz << " failed: " << strerror(errno) << std::endl;
+			release( *file, w.entry.offset, w.entry.length );
+			return;
+		}
+		syncs.insert( std::make_pair( w.region, s ) );
+	}
+
+	if( pwrite( file->fd, &compressed[0], compressed.size(), w.entry.offset ) != (ssize_t)compressed.size() )
+	{
+		std::cout << "RegionStore: writing block " << bx << "," << by << "," << bz << " failed: " << strerror(errno) << std::endl;
+		release( *file, w.entry.offset, w.entry.length );
+		return;
+	}
+
+	w.written = true;
+}
+
+bool RegionStore::writeEntry( Write &w )
+{
+	int bx, by, bz;
+	unpackBlockKey( w.key, bx, by, bz );
+
+	RegionFile *file = openRegion( bx, by, bz, true );
+	if( file == NULL )
+	{
+		return false;
+	}
+
+	if( pwrite( file->fd, &w.entry, sizeof(w.entry), w.entryOffset ) != sizeof(w.entry) )
+	{
+		std::cout << "RegionStore: writing block " << bx << "," << by << "," << bz << " failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	if( w.old.length != 0 )
+	{
+		release( *file, w.old.offset, w.old.length );
+	}
+	return true;
+}
+
+void RegionStore::writeBatch( std::vector<Write> &batch )
+{
+	std::map<uint64_t, Sync> syncs;
+	uint32_t batchGeneration;
+
+	{
+		boost::mutex::scoped_lock io(io_mutex);
+
+		// a file closed while its blocks are written would find their
+		// extents free when reopened, make room for the batch's files first
+		std::vector<uint64_t> regions;
+		for( size_t i = 0; i < batch.size(); i++ )
+		{
+			int bx, by, bz;
+			unpackBlockKey( batch[i].key, bx, by, bz );
+
+			batch[i].region = regionKey( bx, by, bz );
+			regions.push_back( batch[i].region );
+		}
+		std::sort( regions.begin(), regions.end() );
+		regions.erase( std::unique( regions.begin(), regions.end() ), regions.end() );
+
+		size_t opening = 0;
+		for( size_t i = 0; i < regions.size(); i++ )
+		{
+			opening += (files.find( regions[i] ) == files.end());
+		}
+
+		if( files.size() + opening > MAX_OPEN_REGIONS )
+		{
+			closeAll();
+		}
+		batchGeneration = generation;
+
+		for( size_t i = 0; i < batch.size(); i++ )
+		{
+			writeData( batch[i], syncs );
+		}
+	}
+
+	// data on disk before the table entries point at it, a crash before an
+	// entry is written leaves the old copy in place. Loads go on meanwhile
+	for( std::map<uint64_t, Sync>::iterator it = syncs.begin(); it != syncs.end(); ++it )
+	{
+		it->second.ok = (fdatasync( it->second.fd ) == 0);
+
+		if( !it->second.ok )
+		{
+			std::cout << "RegionStore: syncing a region file failed: " << strerror(errno) << std::endl;
+		}
+		close( it->second.fd );
+	}
+
+	boost::mutex::scoped_lock io(io_mutex);
+
+	// a load or list may have closed and reopened files, their free space
+	// then came from the table and has the batch's extents in it
+	const bool reopened = (generation != batchGeneration);
+
+	// the sync also got every table entry written before the batch to disk,
+	// what they gave up can be reused
+	for( std::map<uint64_t, Sync>::iterator it = syncs.begin(); it != syncs.end() && !reopened; ++it )
+	{
+		RegionFile &file = files[it->first];
+
+		if( it->second.ok )
+		{
+			for( size_t i = 0; i < it->second.released; i++ )
+			{
+				addFree( file.freeSpace, file.released[i].first, file.released[i].second );
+			}
+			file.released.erase( file.released.begin(), file.released.begin() + it->second.released );
+		}
+	}
+
+	for( size_t i = 0; i < batch.size(); i++ )
+	{
+		Write &w = batch[i];
+
+		if( !w.written )
+		{
+			continue;
+		}
+
+		w.stored = syncs[w.region].ok && writeEntry( w );
+
+		// the table still points at the old copy, the new extent is unused.
+		// A reopened file found it free already
+		std::map<uint64_t, RegionFile>::iterator file = files.find( w.region );
+
+		if( !w.stored && generation == batchGeneration && file != files.end() )
+		{
+			release( file->second, w.entry.offset, w.entry.length );
+		}
+	}
+
+	// the tables have the batch's extents now, reopening finds them used
+	if( generation != batchGeneration )
+	{
+		closeAll();
+	}
+}
+
+void RegionStore::writerLoop()
+{
+	std::vector<Write> batch;
+
+	for( ;; )
+	{
+		{
+			boost::mutex::scoped_lock lock(pending_mutex);
+
+			while( order.empty() && !stopping )
+			{
+				pending_cond.wait( lock );
+			}
+
+			if( order.empty() )
+			{
+				return;
+			}
+
+			// loads find the batch in inflight until its entries are written
+			batch.clear();
+			while( !order.empty() && batch.size() < MAX_WRITE_BATCH )
+			{
+				Write w;
+				w.key = order.front();
+				order.pop_front();
+
+				std::vector<uint8_t> &copy = inflight[w.key];
+				copy.swap( pending[w.key] );
+				pending.erase( w.key );
+
+				w.voxels = &copy;
+				w.written = false;
+				w.stored = false;
+				batch.push_back( w );
+			}
+			writing = true;
+		}
+
+		writeBatch( batch );
+
+		{
+			boost::mutex::scoped_lock lock(pending_mutex);
+
+			for( size_t i = 0; i < batch.size(); i++ )
+			{
+				const uint64_t key = batch[i].key;
+
+				// a newer copy queued meanwhile replaces one which failed
+				if( batch[i].stored || pending.count( key ) != 0 )
+				{
+					failures.erase( key );
+					continue;
+				}
+
+				if( ++failures[key] > MAX_WRITE_RETRIES )
+				{
+					int bx, by, bz;
+					unpackBlockKey( key, bx, by, bz );
+
+					std::cout << "RegionStore: giving up on block " << bx << "," << by << "," << bz << ", its edits are lost" << std::endl;
+					failures.erase( key );
+					continue;
+				}
+
+				// queued again, the load of it still finds this copy
+				pending[key].swap( inflight[key] );
+				order.push_back( key );
+			}
+
+			inflight.clear();
+			writing = false;
+		}
+		flushed_cond.notify_all();
+	}
+}
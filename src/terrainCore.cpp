@@ -0,0 +1,1539 @@
+/*
+ * File:	terrainCore.cpp
+ * Author:	James Letendre
+ *
+ * Renderer independent voxel terrain: paging, chunk bookkeeping and extraction
+ */
+#include "terrainCore.h"
+#include "greedyMesher.h"
+
+#include <PolyVoxCore/CubicSurfaceExtractor.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#define NOISE_SCALE 150.0
+
+// generated terrain is solid below TERRAIN_FLOOR and empty from
+// TERRAIN_CEILING up, the surface lies in between
+#define TERRAIN_FLOOR 1
+#define TERRAIN_CEILING (CHUNK_SIZE-1)
+
+// how far, in chunks of its level, the camera goes past the border of a
+// ring's center chunk before the ring follows. Keeps the level of detail
+// from flipping back and forth on a border
+#define LOD_HYSTERESIS 0.25f
+
+// samples of side faces coarse chunks add below the top of their border
+// columns, covers the difference to the finer chunks next to them
+#define LOD_SKIRT_DEPTH 2
+
+static uint64_t nowMicros()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+static int floorDiv( int a, int b )
+{
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+// height of the generated surface over a column from its noise
+static double surfaceHeight( float noise )
+{
+	double height = CHUNK_SIZE*noise/2.0 + CHUNK_SIZE/2.0;
+
+	return std::max( std::min( height, (double)TERRAIN_CEILING ), (double)TERRAIN_FLOOR );
+}
+
+// material of the band holding height y, under the surface
+static uint8_t bandMaterial( int y )
+{
+	if( y < CHUNK_SIZE/3 )
+	{
+		return 1;
+	}
+	if( y < 2*CHUNK_SIZE/3 )
+	{
+		return 2;
+	}
+	return 3;
+}
+
+// material the generator puts at height y of a column
+static uint8_t generatedMaterial( int y, double height )
+{
+	return (y >= height) ? 0 : bandMaterial( y );
+}
+
+// solid voxels from the bottom y0 of a block up in a column of the noise
+static int solidVoxels( float noise, int y0 )
+{
+	return std::max( 0, std::min( (int)ceil( surfaceHeight( noise ) ) - y0, CHUNK_SIZE ) );
+}
+
+TerrainCore::TerrainCore( const std::string &storePath, int lodLevels, int radius, uint32_t seed ) :
+	surfaceNoise(seed), heightfield(surfaceNoise, CHUNK_SIZE, NOISE_SCALE, HEIGHT_CACHE_TILES, &metrics),
+	store(storePath.empty() ? NULL : new RegionStore(storePath, CHUNK_SIZE)),
+	volume(boost::bind(&TerrainCore::volume_load, this, _1, _2), boost::bind(&TerrainCore::volume_unload, this, _1, _2), CHUNK_SIZE),
+	mesher(MESHER_CUBIC),
+	chunks( 4*lodLevels*(2*radius+2)*(2*radius+2) ), scheduler( CHUNK_SIZE, lodLevels*(2*radius+2)*(2*radius+2) ),
+	lodLevels(std::max( 1, std::min( lodLevels, LOD_MAX_LEVELS ) )), radius(radius), haveCenter(false),
+	retiring(0), chunkFinished(false)
+{
+	rings.resize( this->lodLevels );
+	lastRings.resize( this->lodLevels );
+
+	// sized for the window so streaming doesn't allocate once running
+	const size_t window = lodLevels*(2*radius+4)*(2*radius+4);
+	dropped.reserve( window );
+	evictCoords.reserve( window );
+	evicted.reserve( window );
+	dirtyChunks.reserve( window );
+
+	// chunks of earlier sessions' edits can have a surface anywhere
+	if( store )
+	{
+		std::vector<uint64_t> stored;
+		store->list( stored );
+
+		for( size_t i = 0; i < stored.size(); i++ )
+		{
+			int x, y, z;
+			RegionStore::unpackBlockKey( stored[i], x, y, z );
+
+			markEdited( chunkCoord( x, y, z ) );
+			markEdited( chunkCoord( x - 1, y, z ) );
+			markEdited( chunkCoord( x + 1, y, z ) );
+			markEdited( chunkCoord( x, y - 1, z ) );
+			markEdited( chunkCoord( x, y + 1, z ) );
+			markEdited( chunkCoord( x, y, z - 1 ) );
+			markEdited( chunkCoord( x, y, z + 1 ) );
+		}
+	}
+
+	// a block's occupancy is one word per row of voxels
+	static_assert( CHUNK_SIZE == OCCUPANCY_BLOCK, "occupancy blocks must match volume blocks" );
+	occupancyRows.resize( CHUNK_SIZE*CHUNK_SIZE );
+
+	volume.setMaxNumberOfBlocksInMemory( 1024 );
+}
+
+TerrainCore::~TerrainCore()
+{
+	// page out now, the unload callback uses members destroyed before the
+	// volume would flush itself
+	{
+		TimedLock lock( volume_mutex, metrics );
+		volume.flushAll();
+	}
+
+	if( store )
+	{
+		store->flush();
+		delete store;
+		store = NULL;
+	}
+}
+
+void TerrainCore::flushStore()
+{
+	if( store == NULL )
+	{
+		return;
+	}
+
+	{
+		TimedLock lock( volume_mutex, metrics );
+		volume.flushAll();
+	}
+
+	store->flush();
+}
+
+PolyVox::Material8 TerrainCore::getVoxelAt( const PolyVox::Vector3DInt32 &vec )
+{
+	TimedLock lock( volume_mutex, metrics );
+
+	return volume.getVoxelAt( vec );
+}
+
+void TerrainCore::setVoxelAt( const PolyVox::Vector3DInt32 &vec, PolyVox::Material8 mat )
+{
+	editBox( PolyVox::Region( vec, vec ), mat );
+}
+
+template <typename Brush>
+void TerrainCore::applyBrush( const PolyVox::Region &bounds, const Brush &brush )
+{
+	const PolyVox::Vector3DInt32 &lower = bounds.getLowerCorner();
+	const PolyVox::Vector3DInt32 &upper = bounds.getUpperCorner();
+
+	if( lower.getX() > upper.getX() || lower.getY() > upper.getY() || lower.getZ() > upper.getZ() )
+	{
+		return;
+	}
+
+	// a voxel on a chunk border is also read by the neighbour across it
+	const int cx0 = floorDiv( lower.getX() - 1, CHUNK_SIZE );
+	const int cy0 = floorDiv( lower.getY() - 1, CHUNK_SIZE );
+	const int cz0 = floorDiv( lower.getZ() - 1, CHUNK_SIZE );
+	const int cw = floorDiv( upper.getX() + 1, CHUNK_SIZE ) - cx0 + 1;
+	const int ch = floorDiv( upper.getY() + 1, CHUNK_SIZE ) - cy0 + 1;
+	const int cd = floorDiv( upper.getZ() + 1, CHUNK_SIZE ) - cz0 + 1;
+	editChunks.assign( cw * ch * cd, 0 );
+
+	// blocks and chunks are the same size, only the blocks written to
+	// are modified though
+	const int bx0 = floorDiv( lower.getX(), CHUNK_SIZE ), by0 = floorDiv( lower.getY(), CHUNK_SIZE ), bz0 = floorDiv( lower.getZ(), CHUNK_SIZE );
+	const int bw = floorDiv( upper.getX(), CHUNK_SIZE ) - bx0 + 1;
+	const int bh = floorDiv( upper.getY(), CHUNK_SIZE ) - by0 + 1;
+	const int bd = floorDiv( upper.getZ(), CHUNK_SIZE ) - bz0 + 1;
+	editBlocks.assign( bw * bh * bd, 0 );
+
+	bool changed = false;
+
+	TimedLock lock( volume_mutex, metrics );
+
+	// block by block, each row of a block written through its array
+	for( int bz = bz0; bz < bz0 + bd; bz++ )
+	{
+		const int z0 = std::max( lower.getZ(), bz * CHUNK_SIZE ), z1 = std::min( upper.getZ(), bz * CHUNK_SIZE + CHUNK_SIZE - 1 );
+
+		for( int by = by0; by < by0 + bh; by++ )
+		{
+			const int y0 = std::max( lower.getY(), by * CHUNK_SIZE ), y1 = std::min( upper.getY(), by * CHUNK_SIZE + CHUNK_SIZE - 1 );
+
+			for( int bx = bx0; bx < bx0 + bw; bx++ )
+			{
+				const int ox = bx * CHUNK_SIZE;
+				const int lx0 = std::max( lower.getX(), ox ) - ox, lx1 = std::min( upper.getX(), ox + CHUNK_SIZE - 1 ) - ox;
+
+				uint8_t *voxels = volume.getBlock( bx, by, bz ).voxels();
+				uint8_t *chunk = &editChunks[ (bx - cx0) + ((by - cy0) + (bz - cz0) * ch) * cw ];
+				bool blockChanged = false;
+
+				for( int z = z0; z <= z1; z++ )
+				{
+					const int lz = z - bz * CHUNK_SIZE;
+
+					for( int y = y0; y <= y1; y++ )
+					{
+						const int ly = y - by * CHUNK_SIZE;
+						uint8_t *row = voxels + (lz * CHUNK_SIZE + ly) * CHUNK_SIZE;
+
+						for( int lx = lx0; lx <= lx1; lx++ )
+						{
+							const int x = ox + lx;
+							uint8_t out;
+
+							if( !brush( x, y, z, row[lx], out ) || out == row[lx] )
+							{
+								continue;
+							}
+
+							row[lx] = out;
+							occupancy.setVoxel( x, y, z, out != 0 );
+							blockChanged = true;
+
+							if( lx == 0 )				chunk[-1] = 1;
+							if( lx == CHUNK_SIZE-1 )	chunk[1] = 1;
+							if( ly == 0 )				chunk[-cw] = 1;
+							if( ly == CHUNK_SIZE-1 )	chunk[cw] = 1;
+							if( lz == 0 )				chunk[-cw*ch] = 1;
+							if( lz == CHUNK_SIZE-1 )	chunk[cw*ch] = 1;
+						}
+					}
+				}
+
+				if( blockChanged )
+				{
+					chunk[0] = 1;
+					editBlocks[ (bx - bx0) + ((by - by0) + (bz - bz0) * bh) * bw ] = 1;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	if( !changed )
+	{
+		return;
+	}
+
+	if( store )
+	{
+		for( int bz = 0; bz < bd; bz++ )
+		{
+			for( int by = 0; by < bh; by++ )
+			{
+				for( int bx = 0; bx < bw; bx++ )
+				{
+					if( editBlocks[ bx + (by + bz * bh) * bw ] )
+					{
+						modifiedBlocks.insert( RegionStore::blockKey( bx0 + bx, by0 + by, bz0 + bz ) );
+					}
+				}
+			}
+		}
+	}
+
+	for( int cz = 0; cz < cd; cz++ )
+	{
+		for( int cy = 0; cy < ch; cy++ )
+		{
+			for( int cx = 0; cx < cw; cx++ )
+			{
+				if( editChunks[ cx + (cy + cz * ch) * cw ] )
+				{
+					markEdited( chunkCoord( cx0 + cx, cy0 + cy, cz0 + cz ) );
+				}
+			}
+		}
+	}
+
+	lock.unlock();
+
+	// one batch, regenerate queues them all together
+	for( int cz = 0; cz < cd; cz++ )
+	{
+		for( int cy = 0; cy < ch; cy++ )
+		{
+			for( int cx = 0; cx < cw; cx++ )
+			{
+				if( !editChunks[ cx + (cy + cz * ch) * cw ] )
+				{
+					continue;
+				}
+
+				chunkCoord coord( cx0 + cx, cy0 + cy, cz0 + cz );
+				markDirty( coord );
+
+				// coarser chunks showing the edit, the ones not tracked get
+				// it when they are first meshed
+				for( coord = coord.parent(); coord.lod < lodLevels; coord = coord.parent() )
+				{
+					if( chunks.find( coord ) != NULL )
+					{
+						markDirty( coord );
+					}
+				}
+			}
+		}
+	}
+}
+
+bool TerrainCore::generatedLayer( const PolyVox::Region &region, int y, uint8_t &material ) const
+{
+	if( y >= TERRAIN_FLOOR && y < TERRAIN_CEILING )
+	{
+		return false;
+	}
+
+	const int cy = floorDiv( y, CHUNK_SIZE );
+
+	for( int cz = floorDiv( region.getLowerCorner().getZ(), CHUNK_SIZE ); cz <= floorDiv( region.getUpperCorner().getZ(), CHUNK_SIZE ); cz++ )
+	{
+		for( int cx = floorDiv( region.getLowerCorner().getX(), CHUNK_SIZE ); cx <= floorDiv( region.getUpperCorner().getX(), CHUNK_SIZE ); cx++ )
+		{
+			if( editedChunks.count( ChunkTable::packKey( chunkCoord( cx, cy, cz ) ) ) )
+			{
+				return false;
+			}
+		}
+	}
+
+	material = (y < TERRAIN_FLOOR) ? 1 : 0;
+	return true;
+}
+
+struct SphereBrush
+{
+	float x, y, z, radiusSq;
+	uint8_t material;
+
+	bool operator()( int vx, int vy, int vz, uint8_t current, uint8_t &out ) const
+	{
+		float dx = vx - x, dy = vy - y, dz = vz - z;
+
+		out = material;
+		return dx*dx + dy*dy + dz*dz <= radiusSq;
+	}
+};
+
+struct CylinderBrush
+{
+	float x, z, radiusSq;
+	uint8_t material;
+
+	bool operator()( int vx, int vy, int vz, uint8_t current, uint8_t &out ) const
+	{
+		float dx = vx - x, dz = vz - z;
+
+		out = material;
+		return dx*dx + dz*dz <= radiusSq;
+	}
+};
+
+struct BoxBrush
+{
+	uint8_t material;
+
+	bool operator()( int vx, int vy, int vz, uint8_t current, uint8_t &out ) const
+	{
+		out = material;
+		return true;
+	}
+};
+
+struct FillBrush
+{
+	uint8_t from, to;
+
+	bool operator()( int vx, int vy, int vz, uint8_t current, uint8_t &out ) const
+	{
+		out = to;
+		return current == from;
+	}
+};
+
+struct PasteBrush
+{
+	const VoxelClipboard *clip;
+	PolyVox::Vector3DInt32 origin;
+	bool pasteEmpty;
+
+	bool operator()( int vx, int vy, int vz, uint8_t current, uint8_t &out ) const
+	{
+		int x = vx - origin.getX(), y = vy - origin.getY(), z = vz - origin.getZ();
+
+		out = clip->voxels[ x + (y + z * clip->height) * clip->width ];
+		return pasteEmpty || out != 0;
+	}
+};
+
+void TerrainCore::editSphere( const PolyVox::Vector3DFloat &center, float radius, PolyVox::Material8 mat )
+{
+	SphereBrush brush = { center.getX(), center.getY(), center.getZ(), radius * radius, mat.getMaterial() };
+
+	applyBrush( PolyVox::Region(
+				PolyVox::Vector3DInt32( floor( center.getX() - radius ), floor( center.getY() - radius ), floor( center.getZ() - radius ) ),
+				PolyVox::Vector3DInt32( ceil( center.getX() + radius ), ceil( center.getY() + radius ), ceil( center.getZ() + radius ) ) ),
+			brush );
+}
+
+void TerrainCore::editBox( const PolyVox::Region &box, PolyVox::Material8 mat )
+{
+	BoxBrush brush = { mat.getMaterial() };
+
+	applyBrush( box, brush );
+}
+
+void TerrainCore::editCylinder( const PolyVox::Vector3DFloat &base, float radius, int height, PolyVox::Material8 mat )
+{
+	CylinderBrush brush = { base.getX(), base.getZ(), radius * radius, mat.getMaterial() };
+
+	applyBrush( PolyVox::Region(
+				PolyVox::Vector3DInt32( floor( base.getX() - radius ), floor( base.getY() ), floor( base.getZ() - radius ) ),
+				PolyVox::Vector3DInt32( ceil( base.getX() + radius ), floor( base.getY() ) + height - 1, ceil( base.getZ() + radius ) ) ),
+			brush );
+}
+
+void TerrainCore::editFill( const PolyVox::Region &box, PolyVox::Material8 from, PolyVox::Material8 to )
+{
+	FillBrush brush = { from.getMaterial(), to.getMaterial() };
+
+	applyBrush( box, brush );
+}
+
+void TerrainCore::copyRegion( const PolyVox::Region &box, VoxelClipboard &clip )
+{
+	clip.width = box.getWidthInVoxels();
+	clip.height = box.getHeightInVoxels();
+	clip.depth = box.getDepthInVoxels();
+	clip.voxels.resize( clip.width * clip.height * clip.depth );
+
+	uint8_t *out = clip.voxels.empty() ? NULL : &clip.voxels[0];
+
+	TimedLock lock( volume_mutex, metrics );
+
+	for( int z = box.getLowerCorner().getZ(); z <= box.getUpperCorner().getZ(); z++ )
+	{
+		for( int y = box.getLowerCorner().getY(); y <= box.getUpperCorner().getY(); y++ )
+		{
+			for( int x = box.getLowerCorner().getX(); x <= box.getUpperCorner().getX(); x++ )
+			{
+				*out++ = volume.getVoxelAt( x, y, z ).getMaterial();
+			}
+		}
+	}
+}
+
+void TerrainCore::paste( const VoxelClipboard &clip, const PolyVox::Vector3DInt32 &origin, bool pasteEmpty )
+{
+	if( clip.voxels.empty() )
+	{
+		return;
+	}
+
+	PasteBrush brush = { &clip, origin, pasteEmpty };
+
+	applyBrush( PolyVox::Region( origin, origin + PolyVox::Vector3DInt32( clip.width - 1, clip.height - 1, clip.depth - 1 ) ), brush );
+}
+
+void TerrainCore::markDirty( const chunkCoord &coord )
+{
+	ChunkRecord &rec = chunks.insert( coord );
+
+	if( !rec.dirty )
+	{
+		dirtyChunks.push_back( coord );
+	}
+
+	rec.dirty = true;
+	rec.version++;
+}
+
+void TerrainCore::markEdited( const chunkCoord &coord )
+{
+	for( chunkCoord c = coord; c.lod < lodLevels; c = c.parent() )
+	{
+		editedChunks.insert( ChunkTable::packKey( c ) );
+	}
+}
+
+bool TerrainCore::hasSurface( const chunkCoord &coord ) const
+{
+	// solid voxels next to empty ones, or either side of the chunk's lower
+	// faces, can only be found from just under the floor to the ceiling
+	const int size = CHUNK_SIZE << coord.lod;
+	const int lower = coord.y * size;
+	const int upper = lower + size - 1;
+
+	if( upper >= TERRAIN_FLOOR - 1 && lower < TERRAIN_CEILING )
+	{
+		return true;
+	}
+
+	return editedChunks.count( ChunkTable::packKey( coord ) ) != 0;
+}
+
+// keep the rings of chunks around position meshed. The rings are only
+// walked when the camera moves on to another chunk of some level, edits are
+// picked up from the dirty list, so standing still costs next to nothing
+void TerrainCore::regenerate( const PolyVox::Vector3DFloat &position, const PolyVox::Vector3DFloat &direction )
+{
+	scheduler.setView( position, direction );
+
+	evicted.clear();
+
+	if( recenter( position ) )
+	{
+		moveWindow();
+	}
+	else if( retiring != 0 && chunkFinished )
+	{
+		evictUnwanted();
+	}
+
+	if( !dirtyChunks.empty() )
+	{
+		serviceDirty();
+	}
+}
+
+bool TerrainCore::recenter( const PolyVox::Vector3DFloat &position )
+{
+	const float pos[3] = { position.getX(), position.getY(), position.getZ() };
+	bool moved = !haveCenter;
+
+	for( int level = 0; level < lodLevels; level++ )
+	{
+		const float size = (float)(CHUNK_SIZE << level);
+		const chunkCoord &center = rings[level].center;
+		const int c[3] = { center.x, center.y, center.z };
+		int next[3];
+
+		for( int axis = 0; axis < 3; axis++ )
+		{
+			float p = pos[axis] / size;
+
+			if( !haveCenter || p < c[axis] - LOD_HYSTERESIS || p > c[axis] + 1 + LOD_HYSTERESIS )
+			{
+				next[axis] = (int)floorf( p );
+			}
+			else
+			{
+				next[axis] = c[axis];
+			}
+		}
+
+		chunkCoord nextCenter( next[0], next[1], next[2], level );
+
+		if( !haveCenter || nextCenter != center )
+		{
+			if( !moved )
+			{
+				lastRings = rings;
+				moved = true;
+			}
+			rings[level].center = nextCenter;
+		}
+	}
+
+	if( moved )
+	{
+		layoutRings();
+	}
+
+	return moved;
+}
+
+void TerrainCore::layoutRings()
+{
+	for( int level = 0; level < lodLevels; level++ )
+	{
+		LodRing &ring = rings[level];
+		const int c[3] = { ring.center.x, ring.center.y, ring.center.z };
+		const int r[3] = { radius, CHUNK_DIST_Y, radius };
+
+		for( int axis = 0; axis < 3; axis++ )
+		{
+			ring.box.lo[axis] = c[axis] - r[axis];
+			ring.box.hi[axis] = c[axis] + r[axis];
+		}
+
+		ring.hasHole = (level > 0);
+
+		if( ring.hasHole )
+		{
+			// the finer box is aligned to this level, so the hole is exact.
+			// Keep at least one chunk of this level around it
+			const ChunkBox &finer = rings[level-1].box;
+
+			for( int axis = 0; axis < 3; axis++ )
+			{
+				ring.hole.lo[axis] = floorDiv( finer.lo[axis], 2 );
+				ring.hole.hi[axis] = floorDiv( finer.hi[axis], 2 );
+
+				ring.box.lo[axis] = std::min( ring.box.lo[axis], ring.hole.lo[axis] - 1 );
+				ring.box.hi[axis] = std::max( ring.box.hi[axis], ring.hole.hi[axis] + 1 );
+			}
+		}
+
+		// the next coarser level cuts its hole out of whole chunks of its own
+		if( level + 1 < lodLevels )
+		{
+			for( int axis = 0; axis < 3; axis++ )
+			{
+				ring.box.lo[axis] = floorDiv( ring.box.lo[axis], 2 ) * 2;
+				ring.box.hi[axis] = floorDiv( ring.box.hi[axis], 2 ) * 2 + 1;
+			}
+		}
+	}
+}
+
+int TerrainCore::getViewRange() const
+{
+	if( !haveCenter )
+	{
+		return 0;
+	}
+
+	const LodRing &ring = rings[ lodLevels - 1 ];
+
+	int range = std::min( ring.center.x - ring.box.lo[0], ring.box.hi[0] - ring.center.x );
+	range = std::min( range, std::min( ring.center.z - ring.box.lo[2], ring.box.hi[2] - ring.center.z ) );
+
+	return range * (CHUNK_SIZE << (lodLevels - 1));
+}
+
+void TerrainCore::moveWindow()
+{
+	// queued chunks we flew away from go back to how they were, they get
+	// queued again if they come back in range
+	dropped.clear();
+	scheduler.dropIf( boost::bind( &TerrainCore::unwanted, this, _1 ), dropped );
+
+	for( size_t i = 0; i < dropped.size(); i++ )
+	{
+		ChunkRecord *rec = chunks.find( dropped[i] );
+
+		if( rec->meshId == -1 )
+		{
+			rec->state = CHUNK_NEW;
+		}
+		else
+		{
+			rec->state = CHUNK_MESHED;
+			rec->dirty = true;
+		}
+	}
+
+	evictUnwanted();
+
+	// only the chunks which just came into range can need a mesh, the rest
+	// of the rings were handled when we entered them. Chunks without a
+	// surface are never tracked, edits add them through markDirty
+	for( int level = 0; level < lodLevels; level++ )
+	{
+		const LodRing &ring = rings[level];
+		const LodRing &last = lastRings[level];
+
+		for( int x = ring.box.lo[0]; x <= ring.box.hi[0]; x++ )
+		{
+			for( int z = ring.box.lo[2]; z <= ring.box.hi[2]; z++ )
+			{
+				for( int y = ring.box.lo[1]; y <= ring.box.hi[1]; y++ )
+				{
+					chunkCoord coord( x, y, z, level );
+
+					if( !ring.contains( coord ) || (haveCenter && last.contains( coord )) || !hasSurface( coord ) )
+					{
+						continue;
+					}
+
+					queueChunk( chunks.insert( coord ), coord );
+				}
+			}
+		}
+	}
+
+	haveCenter = true;
+}
+
+void TerrainCore::serviceDirty()
+{
+	for( size_t i = 0; i < dirtyChunks.size(); i++ )
+	{
+		const chunkCoord &coord = dirtyChunks[i];
+		ChunkRecord *rec = chunks.find( coord );
+
+		// out of range chunks keep the flag, they are queued when they come
+		// back in range. Chunks being extracted are put back on the list when
+		// they finish
+		if( rec == NULL || !rec->dirty || !wanted( coord ) || rec->state == CHUNK_PROCESSING )
+		{
+			continue;
+		}
+
+		// not extracted yet, it will see the change anyway
+		if( rec->state == CHUNK_QUEUED )
+		{
+			rec->dirty = false;
+			continue;
+		}
+
+		queueChunk( *rec, coord );
+	}
+
+	dirtyChunks.clear();
+}
+
+void TerrainCore::queueChunk( ChunkRecord &rec, const chunkCoord &coord )
+{
+	if( rec.state == CHUNK_QUEUED || rec.state == CHUNK_PROCESSING )
+	{
+		return;
+	}
+
+	if( rec.state == CHUNK_NEW || rec.dirty )
+	{
+		rec.state = CHUNK_QUEUED;
+		rec.dirty = false;
+		rec.requested = nowMicros();
+
+		scheduler.push( coord );
+	}
+}
+
+bool TerrainCore::ready( const chunkCoord &coord )
+{
+	if( !hasSurface( coord ) )
+	{
+		return true;
+	}
+
+	ChunkRecord *rec = chunks.find( coord );
+	return rec != NULL && rec->meshId != -1;
+}
+
+TerrainCore::Coverage TerrainCore::coverage( const chunkCoord &coord )
+{
+	// a coarser chunk took over
+	for( chunkCoord parent = coord.parent(); parent.lod < lodLevels; parent = parent.parent() )
+	{
+		if( wanted( parent ) )
+		{
+			return ready( parent ) ? COVER_READY : COVER_PENDING;
+		}
+	}
+
+	// or finer ones did
+	return childCoverage( coord );
+}
+
+TerrainCore::Coverage TerrainCore::childCoverage( const chunkCoord &coord )
+{
+	if( coord.lod == 0 )
+	{
+		return COVER_NONE;
+	}
+
+	Coverage result = COVER_NONE;
+
+	for( int i = 0; i < 8; i++ )
+	{
+		chunkCoord child( coord.x*2 + (i & 1), coord.y*2 + ((i >> 1) & 1), coord.z*2 + (i >> 2), coord.lod - 1 );
+		Coverage cover;
+
+		if( wanted( child ) )
+		{
+			cover = ready( child ) ? COVER_READY : COVER_PENDING;
+		}
+		else if( rings[ child.lod ].box.contains( child ) )
+		{
+			// in the hole, the finer levels have it
+			cover = childCoverage( child );
+		}
+		else
+		{
+			// every finer box lies in this one's hole
+			cover = COVER_NONE;
+		}
+
+		if( cover == COVER_PENDING )
+		{
+			return COVER_PENDING;
+		}
+		if( cover == COVER_READY )
+		{
+			result = COVER_READY;
+		}
+	}
+
+	return result;
+}
+
+void TerrainCore::evictUnwanted()
+{
+	// erasing shifts entries around, so collect first
+	evictCoords.clear();
+	retiring = 0;
+	chunkFinished = false;
+
+	// out of range chunks are kept one chunk past the outermost ring, so
+	// moving back and forth over its border doesn't drop and remesh a row
+	const int top = lodLevels - 1;
+	ChunkBox keep = rings[top].box;
+
+	for( int axis = 0; axis < 3; axis++ )
+	{
+		keep.lo[axis]--;
+		keep.hi[axis]++;
+	}
+
+	for( size_t i = 0; i < chunks.capacity(); i++ )
+	{
+		const ChunkRecord &rec = chunks.slot( i );
+
+		// queued chunks are only dropped by the scheduler, and chunks being
+		// extracted are evicted on the next pass after they finish
+		if( rec.state != CHUNK_NEW && rec.state != CHUNK_MESHED )
+		{
+			continue;
+		}
+
+		chunkCoord coord = ChunkTable::unpackKey( rec.key );
+
+		if( wanted( coord ) )
+		{
+			continue;
+		}
+
+		if( rec.meshId != -1 )
+		{
+			Coverage cover = coverage( coord );
+			const int shift = top - coord.lod;
+
+			if( cover == COVER_PENDING ||
+				(cover == COVER_NONE && keep.contains( chunkCoord( coord.x >> shift, coord.y >> shift, coord.z >> shift, top ) )) )
+			{
+				retiring++;
+				continue;
+			}
+		}
+
+		evictCoords.push_back( coord );
+	}
+
+	for( size_t i = 0; i < evictCoords.size(); i++ )
+	{
+		int meshId = chunks.find( evictCoords[i] )->meshId;
+
+		if( meshId != -1 )
+		{
+			evicted.push_back( meshId );
+		}
+
+		chunks.erase( evictCoords[i] );
+	}
+}
+
+bool TerrainCore::nextChunk( chunkCoord &coord )
+{
+	if( !scheduler.pop( coord ) )
+	{
+		return false;
+	}
+
+	chunks.find( coord )->state = CHUNK_PROCESSING;
+	return true;
+}
+
+double TerrainCore::finishChunk( const chunkCoord &coord, int meshId )
+{
+	ChunkRecord &rec = chunks.insert( coord );
+
+	rec.meshId = meshId;
+	rec.state = CHUNK_MESHED;
+
+	// changed while it was being extracted, mesh it again
+	if( rec.dirty )
+	{
+		dirtyChunks.push_back( coord );
+	}
+
+	// chunks it replaces may go now
+	chunkFinished = true;
+	metrics.chunkDone();
+
+	double latencyMs = (nowMicros() - rec.requested) / 1000.0;
+	scheduler.chunkVisible( latencyMs );
+
+	return latencyMs;
+}
+
+bool TerrainCore::isCurrent( const chunkCoord &coord )
+{
+	ChunkRecord *rec = chunks.find( coord );
+
+	return rec != NULL && rec->state == CHUNK_MESHED && !rec->dirty;
+}
+
+int TerrainCore::getMeshId( const chunkCoord &coord )
+{
+	ChunkRecord *rec = chunks.find( coord );
+
+	if( rec == NULL )
+	{
+		return -1;
+	}
+	return rec->meshId;
+}
+
+// what the generator makes of blocks the occupancy grid doesn't hold
+struct GeneratedOccupancy
+{
+	HeightfieldCache &heightfield;
+	HeightfieldCache::tilePtr tile;
+	int tileX, tileZ;
+	int lastX, lastZ;
+	double height;
+
+	GeneratedOccupancy( HeightfieldCache &heightfield ) :
+		heightfield(heightfield), tileX(0), tileZ(0), lastX(0), lastZ(0), height(0) {}
+
+	// rays and bodies mostly stay in a column for a few voxels, and in a
+	// chunk column for many
+	const HeightTile &column( int cx, int cz )
+	{
+		if( !tile || cx != tileX || cz != tileZ )
+		{
+			tile = heightfield.get( cx, cz, 0 );
+			tileX = cx;
+			tileZ = cz;
+		}
+		return *tile;
+	}
+
+	OccupancyState blockState( int bx, int by, int bz )
+	{
+		if( by * CHUNK_SIZE >= TERRAIN_CEILING )
+		{
+			return OCCUPANCY_EMPTY;
+		}
+		if( (by + 1) * CHUNK_SIZE <= TERRAIN_FLOOR )
+		{
+			return OCCUPANCY_SOLID;
+		}
+
+		// voxels are solid below the surface
+		const HeightTile &heights = column( bx, bz );
+		if( by * CHUNK_SIZE >= surfaceHeight( heights.maximum ) )
+		{
+			return OCCUPANCY_EMPTY;
+		}
+		if( (by + 1) * CHUNK_SIZE <= surfaceHeight( heights.minimum ) )
+		{
+			return OCCUPANCY_SOLID;
+		}
+		return OCCUPANCY_MIXED;
+	}
+
+	bool solid( int x, int y, int z )
+	{
+		if( !tile || x != lastX || z != lastZ )
+		{
+			const HeightTile &heights = column( x >> OCCUPANCY_SHIFT, z >> OCCUPANCY_SHIFT );
+
+			height = surfaceHeight( heights.at( x & (CHUNK_SIZE-1), z & (CHUNK_SIZE-1) ) );
+			lastX = x;
+			lastZ = z;
+		}
+
+		return y < height;
+	}
+};
+
+void TerrainCore::raycast( const PolyVox::Vector3DFloat &start, const PolyVox::Vector3DFloat &dir, PolyVox::RaycastResult &result )
+{
+	GeneratedOccupancy generated( heightfield );
+
+	occupancy.beginRead();
+	castOccupancyRay( occupancy, generated, start, dir, result );
+	occupancy.endRead();
+}
+
+void TerrainCore::raycastBatch( const VoxelRay *rays, size_t count, PolyVox::RaycastResult *results )
+{
+	GeneratedOccupancy generated( heightfield );
+
+	occupancy.beginRead();
+	for( size_t i = 0; i < count; i++ )
+	{
+		castOccupancyRay( occupancy, generated, rays[i].start, rays[i].dir, results[i] );
+	}
+	occupancy.endRead();
+}
+
+void TerrainCore::collide( CollisionBody *bodies, size_t count )
+{
+	GeneratedOccupancy generated( heightfield );
+
+	occupancy.beginRead();
+	OccupancyProbe<GeneratedOccupancy> probe( occupancy, generated );
+	for( size_t i = 0; i < count; i++ )
+	{
+		sweepOccupancyBox( probe, bodies[i] );
+	}
+	occupancy.endRead();
+}
+
+void TerrainCore::sampleMetrics( TerrainMetricsSample &sample )
+{
+	metrics.sample( sample );
+
+	sample.scheduled = scheduler.size();
+	sample.occupancyBytes = occupancy.getBytes();
+	sample.heightBytes = heightfield.getStats().bytes;
+
+	TimedLock lock( volume_mutex, metrics );
+	sample.voxelBytes = volume.calculateSizeInBytes();
+}
+
+void TerrainCore::raycastVolume( const PolyVox::Vector3DFloat &start, const PolyVox::Vector3DFloat &dir, PolyVox::RaycastResult &result )
+{
+	// voxel i spans i - 0.5 to i + 0.5, t runs from 0 at p to 1 at p + d
+	const float p[3] = { start.getX() + 0.5f, start.getY() + 0.5f, start.getZ() + 0.5f };
+	const float d[3] = { dir.getX(), dir.getY(), dir.getZ() };
+
+	int v[3], end[3], step[3];
+	float tMax[3], tDelta[3];
+
+	for( int a = 0; a < 3; a++ )
+	{
+		v[a] = (int)floorf( p[a] );
+		end[a] = (int)floorf( p[a] + d[a] );
+		step[a] = (d[a] > 0) ? 1 : ((d[a] < 0) ? -1 : 0);
+		tDelta[a] = step[a] ? 1.0f / fabsf( d[a] ) : HUGE_VALF;
+		tMax[a] = step[a] ? ((step[a] > 0) ? (v[a] + 1 - p[a]) : (p[a] - v[a])) * tDelta[a] : HUGE_VALF;
+	}
+
+	result.previousVoxel = PolyVox::Vector3DInt32( v[0], v[1], v[2] );
+
+	TimedLock lock( volume_mutex, metrics );
+
+	for( ;; )
+	{
+		if( volume.getVoxelAt( v[0], v[1], v[2] ).getMaterial() != 0 )
+		{
+			result.foundIntersection = true;
+			result.intersectionVoxel = PolyVox::Vector3DInt32( v[0], v[1], v[2] );
+			return;
+		}
+		result.previousVoxel = PolyVox::Vector3DInt32( v[0], v[1], v[2] );
+
+		int axis = (tMax[0] <= tMax[1] && tMax[0] <= tMax[2]) ? 0 : ((tMax[1] <= tMax[2]) ? 1 : 2);
+
+		if( v[axis] == end[axis] )
+		{
+			break;
+		}
+
+		tMax[axis] += tDelta[axis];
+		v[axis] += step[axis];
+	}
+
+	result.foundIntersection = false;
+	result.intersectionVoxel = PolyVox::Vector3DInt32( 0, 0, 0 );
+}
+
+void TerrainCore::warmHeightfield( const PolyVox::Region &region )
+{
+	// only blocks the surface passes through need the noise
+	if( region.getUpperCorner().getY() < TERRAIN_FLOOR || region.getLowerCorner().getY() >= TERRAIN_CEILING )
+	{
+		return;
+	}
+
+	for( int z = floorDiv( region.getLowerCorner().getZ(), CHUNK_SIZE ); z <= floorDiv( region.getUpperCorner().getZ(), CHUNK_SIZE ); z++ )
+	{
+		for( int x = floorDiv( region.getLowerCorner().getX(), CHUNK_SIZE ); x <= floorDiv( region.getUpperCorner().getX(), CHUNK_SIZE ); x++ )
+		{
+			heightfield.get( x, z, 0 );
+		}
+	}
+}
+
+void TerrainCore::surfaceRange( const chunkCoord &coord, double &lowest, double &highest )
+{
+	HeightfieldCache::tilePtr heights = heightfield.get( coord.x, coord.z, coord.lod );
+
+	lowest = surfaceHeight( heights->minimum );
+	highest = surfaceHeight( heights->maximum );
+}
+
+void TerrainCore::prefetch( const PolyVox::Region &region )
+{
+	PolyVox::Vector3DInt32 lower = region.getLowerCorner();
+	PolyVox::Vector3DInt32 upper = region.getUpperCorner();
+	uint8_t material;
+
+	warmHeightfield( region );
+
+	TimedLock lock( volume_mutex, metrics );
+
+	// snapshot fills in generated top and bottom layers without the volume
+	if( generatedLayer( region, lower.getY(), material ) )
+	{
+		lower.setY( lower.getY() + 1 );
+	}
+	if( generatedLayer( region, upper.getY(), material ) )
+	{
+		upper.setY( upper.getY() - 1 );
+	}
+
+	if( lower.getY() <= upper.getY() )
+	{
+		TerrainTimerScope timer( &metrics, TIMER_PAGE_IN );
+		volume.prefetch( PolyVox::Region( lower, upper ) );
+	}
+}
+
+void TerrainCore::snapshot( const PolyVox::Region &region, PolyVox::RawVolume<PolyVox::Material8> &snap )
+{
+	const PolyVox::Region border = toSnapshotRegion( region );
+	const PolyVox::Vector3DInt32 &origin = region.getLowerCorner();
+
+	const int bottom = border.getLowerCorner().getY();
+	const int top = border.getUpperCorner().getY();
+
+	warmHeightfield( border );
+
+	TimedLock lock( volume_mutex, metrics );
+
+	// the border layers usually lie in the solid blocks under the surface or
+	// the empty ones over it, those are filled in without paging them in
+	uint8_t below = 0, above = 0;
+	const bool fillBelow = generatedLayer( border, bottom, below );
+	const bool fillAbove = generatedLayer( border, top, above );
+
+	PolyVox::Region fetch = border;
+	fetch.setLowerCorner( PolyVox::Vector3DInt32( border.getLowerCorner().getX(), bottom + fillBelow, border.getLowerCorner().getZ() ) );
+	fetch.setUpperCorner( PolyVox::Vector3DInt32( border.getUpperCorner().getX(), top - fillAbove, border.getUpperCorner().getZ() ) );
+
+	{
+		TerrainTimerScope timer( &metrics, TIMER_PAGE_IN );
+		volume.prefetch( fetch );
+	}
+
+	for( int z = border.getLowerCorner().getZ(); z <= border.getUpperCorner().getZ(); z++ )
+	{
+		for( int y = bottom; y <= top; y++ )
+		{
+			const bool fill = (y == bottom && fillBelow) || (y == top && fillAbove);
+			const PolyVox::Material8 material( (y == bottom) ? below : above );
+
+			for( int x = border.getLowerCorner().getX(); x <= border.getUpperCorner().getX(); x++ )
+			{
+				snap.setVoxelAt( x - origin.getX(), y - origin.getY(), z - origin.getZ(), fill ? material : volume.getVoxelAt( x, y, z ) );
+			}
+		}
+	}
+}
+
+void TerrainCore::extract( const PolyVox::Region &region, PolyVox::SurfaceMesh<PolyVox::PositionMaterial> &surf_mesh )
+{
+	const PolyVox::Region local = toLocalRegion( region );
+	PolyVox::RawVolume<PolyVox::Material8> snap( toSnapshotRegion( local ) );
+
+	snapshot( region, snap );
+
+	PolyVox::CubicSurfaceExtractor<PolyVox::RawVolume<PolyVox::Material8> > suf(&snap, local, &surf_mesh, false);
+
+	suf.execute();
+
+	// vertices are relative to the region either way
+	surf_mesh.m_Region = region;
+}
+
+void TerrainCore::snapshotLod( const chunkCoord &coord, PolyVox::RawVolume<PolyVox::Material8> &snap )
+{
+	const int step = 1 << coord.lod;
+	const PolyVox::Vector3DInt32 lower = toRegion( coord ).getLowerCorner();
+
+	// a sample stands for the step voxels from its lower corner, take the
+	// voxel in the middle of them
+	const int offset = step / 2;
+
+	// the surface of every sampled column, border included, shared by the
+	// chunks above and below
+	HeightfieldCache::tilePtr heights = heightfield.get( coord.x, coord.z, coord.lod );
+
+	TimedLock lock( volume_mutex, metrics );
+
+	// edits reach the coarser chunks through editedChunks, only then is the
+	// volume needed
+	bool edited = false;
+	for( int i = 0; i < 27 && !edited; i++ )
+	{
+		chunkCoord neighbour( coord.x + i % 3 - 1, coord.y + (i / 3) % 3 - 1, coord.z + i / 9 - 1, coord.lod );
+		edited = editedChunks.count( ChunkTable::packKey( neighbour ) ) != 0;
+	}
+
+	if( !edited )
+	{
+		lock.unlock();
+	}
+
+	// no chunk of level 0 packs to this
+	uint64_t lastKey = ~(uint64_t)0;
+	bool lastEdited = false;
+
+	for( int z = -1; z <= CHUNK_SIZE; z++ )
+	{
+		const int wz = lower.getZ() + z*step + offset;
+
+		for( int y = -1; y <= CHUNK_SIZE; y++ )
+		{
+			const int wy = lower.getY() + y*step + offset;
+
+			for( int x = -1; x <= CHUNK_SIZE; x++ )
+			{
+				const int wx = lower.getX() + x*step + offset;
+				uint8_t material;
+
+				if( edited )
+				{
+					// neighbouring samples mostly share a chunk
+					uint64_t key = ChunkTable::packKey( chunkCoord( floorDiv( wx, CHUNK_SIZE ), floorDiv( wy, CHUNK_SIZE ), floorDiv( wz, CHUNK_SIZE ) ) );
+
+					if( key != lastKey )
+					{
+						lastKey = key;
+						lastEdited = editedChunks.count( key ) != 0;
+					}
+				}
+
+				if( edited && lastEdited )
+				{
+					material = volume.getVoxelAt( wx, wy, wz ).getMaterial();
+				}
+				else
+				{
+					material = generatedMaterial( wy, surfaceHeight( heights->at( x, z ) ) );
+				}
+
+				snap.setVoxelAt( x, y, z, PolyVox::Material8( material ) );
+			}
+		}
+	}
+}
+
+void TerrainCore::snapshotJob( ChunkJob &job )
+{
+	if( job.coord.lod == 0 )
+	{
+		snapshot( job.region, job.snap );
+	}
+	else
+	{
+		snapshotLod( job.coord, job.snap );
+	}
+}
+
+void TerrainCore::meshJob( ChunkJob &job, TerrainMetrics *metrics )
+{
+	meshSnapshot( job.snap, job.region, job.coord.lod, job.mesher, job.surf_mesh, job.scratch, job.mesh, metrics );
+}
+
+void TerrainCore::extractJob( ChunkJob &job )
+{
+	snapshotJob( job );
+
+	meshJob( job, &metrics );
+}
+
+void TerrainCore::meshSnapshot( PolyVox::RawVolume<PolyVox::Material8> &snap, const PolyVox::Region &region, int lod, MesherType type,
+		PolyVox::SurfaceMesh<PolyVox::PositionMaterial> &surf_mesh, std::vector<uint8_t> &scratch, ChunkMesh &mesh, TerrainMetrics *metrics )
+{
+	// coarse snapshots hold one sample per 1 << lod voxels
+	const PolyVox::Region local( PolyVox::Vector3DInt32( 0, 0, 0 ),
+			PolyVox::Vector3DInt32( (region.getWidthInVoxels() >> lod) - 1, (region.getHeightInVoxels() >> lod) - 1, (region.getDepthInVoxels() >> lod) - 1 ) );
+
+	// the greedy mesher packs its quads as it goes, all of it counts as extraction
+	if( type == MESHER_GREEDY )
+	{
+		TerrainTimerScope timer( metrics, TIMER_EXTRACT );
+		greedyMesh( snap, local, mesh, scratch );
+	}
+	else
+	{
+		surf_mesh.clear();
+
+		{
+			TerrainTimerScope timer( metrics, TIMER_EXTRACT );
+			PolyVox::CubicSurfaceExtractor<PolyVox::RawVolume<PolyVox::Material8> > suf(&snap, local, &surf_mesh, false);
+			suf.execute();
+		}
+
+		TerrainTimerScope timer( metrics, TIMER_MESH_BUILD );
+		buildChunkMesh( surf_mesh, mesh );
+	}
+
+	TerrainTimerScope timer( metrics, TIMER_MESH_BUILD );
+
+	if( lod > 0 )
+	{
+		addSkirts( snap, local, LOD_SKIRT_DEPTH, mesh );
+	}
+
+	groupChunkFaces( mesh, scratch );
+
+	mesh.region = region;
+	mesh.lod = lod;
+}
+
+void TerrainCore::setMesher( MesherType type )
+{
+	if( type == mesher )
+	{
+		return;
+	}
+	mesher = type;
+
+	for( size_t i = 0; i < chunks.capacity(); i++ )
+	{
+		ChunkRecord &rec = chunks.slot( i );
+
+		if( rec.state != CHUNK_FREE && rec.meshId != -1 && !rec.dirty )
+		{
+			rec.dirty = true;
+			dirtyChunks.push_back( ChunkTable::unpackKey( rec.key ) );
+		}
+	}
+}
+
+const PolyVox::Region TerrainCore::toRegion( const chunkCoord &coord )
+{
+	const int size = CHUNK_SIZE << coord.lod;
+	int x = coord.x * size;
+	int y = coord.y * size;
+	int z = coord.z * size;
+
+	PolyVox::Region region;
+
+	region.setLowerCorner( PolyVox::Vector3DInt32( x, y, z ) );
+	region.setUpperCorner( PolyVox::Vector3DInt32( x + size-1, y + size-1, z + size-1 ) );
+
+	return region;
+}
+
+const PolyVox::Region TerrainCore::toLocalRegion( const PolyVox::Region &region )
+{
+	return PolyVox::Region( PolyVox::Vector3DInt32( 0, 0, 0 ), region.getUpperCorner() - region.getLowerCorner() );
+}
+
+const PolyVox::Region TerrainCore::toSnapshotRegion( const PolyVox::Region &region )
+{
+	return PolyVox::Region( region.getLowerCorner() - PolyVox::Vector3DInt32(1,1,1),
+			region.getUpperCorner() + PolyVox::Vector3DInt32(1,1,1) );
+}
+
+TerrainCore::chunkCoord TerrainCore::toChunkCoord( const PolyVox::Vector3DInt32 &vec )
+{
+	int x = floor(((double)vec.getX()) / CHUNK_SIZE);
+	int y = floor(((double)vec.getY()) / CHUNK_SIZE);
+	int z = floor(((double)vec.getZ()) / CHUNK_SIZE);
+
+	return chunkCoord( x, y, z );
+}
+
+uint64_t TerrainCore::toBlockKey( const PolyVox::Vector3DInt32 &vec )
+{
+	return RegionStore::blockKey( floor(((double)vec.getX()) / CHUNK_SIZE),
+			floor(((double)vec.getY()) / CHUNK_SIZE), floor(((double)vec.getZ()) / CHUNK_SIZE) );
+}
+
+// volume paging functions
+void TerrainCore::volume_load( BlockVolume::Block &block, const PolyVox::Region &region )
+{
+	const PolyVox::Vector3DInt32 &lower = region.getLowerCorner();
+	const int bx = floorDiv( lower.getX(), CHUNK_SIZE ), by = floorDiv( lower.getY(), CHUNK_SIZE ), bz = floorDiv( lower.getZ(), CHUNK_SIZE );
+
+	// stored blocks were edited, load them instead of generating
+	if( store && store->load( bx, by, bz, blockVoxels ) )
+	{
+		uint8_t *voxels = block.overwrite();
+		memcpy( voxels, &blockVoxels[0], blockVoxels.size() );
+
+		const uint8_t *voxel = voxels;
+		for( size_t row = 0; row < occupancyRows.size(); row++ )
+		{
+			uint64_t bits = 0;
+
+			for( int x = 0; x < CHUNK_SIZE; x++, voxel++ )
+			{
+				bits |= (uint64_t)(*voxel != 0) << x;
+			}
+			occupancyRows[row] = bits;
+		}
+
+		occupancy.setRows( bx, by, bz, &occupancyRows[0] );
+		return;
+	}
+
+	generate( block, region );
+}
+
+void TerrainCore::volume_unload( BlockVolume::Block &block, const PolyVox::Region &region )
+{
+	const PolyVox::Vector3DInt32 &lower = region.getLowerCorner();
+	const int bx = floorDiv( lower.getX(), CHUNK_SIZE ), by = floorDiv( lower.getY(), CHUNK_SIZE ), bz = floorDiv( lower.getZ(), CHUNK_SIZE );
+
+	// raycasts fall back on the generator for blocks which aren't paged in,
+	// edited ones keep their occupancy
+	if( editedChunks.count( ChunkTable::packKey( chunkCoord( bx, by, bz ) ) ) == 0 )
+	{
+		occupancy.forget( bx, by, bz );
+		occupancy.reclaim();
+	}
+
+	// untouched blocks can be generated or loaded again
+	if( store == NULL || modifiedBlocks.erase( toBlockKey( lower ) ) == 0 )
+	{
+		return;
+	}
+
+	std::vector<uint8_t> voxels( CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE );
+	block.copyTo( &voxels[0] );
+
+	// compressed and written by the store's writer thread
+	store->store( bx, by, bz, voxels );
+}
+
+void TerrainCore::generate( BlockVolume::Block &block, const PolyVox::Region &region )
+{
+	const PolyVox::Vector3DInt32 &lower = region.getLowerCorner();
+
+	const int bx = floorDiv( lower.getX(), CHUNK_SIZE ), by = floorDiv( lower.getY(), CHUNK_SIZE ), bz = floorDiv( lower.getZ(), CHUNK_SIZE );
+	const int y0 = lower.getY();
+
+	assert( region.getWidthInVoxels() == CHUNK_SIZE && region.getHeightInVoxels() == CHUNK_SIZE &&
+			region.getDepthInVoxels() == CHUNK_SIZE );
+
+	// new blocks are empty
+	if( y0 >= TERRAIN_CEILING )
+	{
+		block.fill( 0 );
+		occupancy.setUniform( bx, by, bz, false );
+		return;
+	}
+
+	// under the surface, no need for the noise
+	if( y0 + CHUNK_SIZE <= TERRAIN_FLOOR )
+	{
+		block.fill( 1 );
+		occupancy.setUniform( bx, by, bz, true );
+		return;
+	}
+
+	// blocks are the columns of full detail chunks, paging a block in again
+	// finds its heights still cached
+	HeightfieldCache::tilePtr heights = heightfield.get( bx, bz, 0 );
+
+	// every column has at least low and at most high solid voxels in the
+	// block, rows under low are filled whole and rows from high up cleared
+	const int low = solidVoxels( heights->minimum, y0 );
+	const int high = solidVoxels( heights->maximum, y0 );
+
+	uint8_t *voxels = block.overwrite();
+	int solid[CHUNK_SIZE];
+
+	for( int z = 0; z < CHUNK_SIZE; z++ )
+	{
+		for( int x = 0; x < CHUNK_SIZE && high > low; x++ )
+		{
+			solid[x] = solidVoxels( heights->at( x, z ), y0 );
+		}
+
+		for( int y = 0; y < CHUNK_SIZE; y++ )
+		{
+			uint8_t *row = voxels + (z*CHUNK_SIZE + y)*CHUNK_SIZE;
+			uint64_t &bits = occupancyRows[ z*CHUNK_SIZE + y ];
+
+			if( y < low )
+			{
+				memset( row, bandMaterial( y0 + y ), CHUNK_SIZE );
+				bits = ~0ULL;
+			}
+			else if( y >= high )
+			{
+				memset( row, 0, CHUNK_SIZE );
+				bits = 0;
+			}
+			else
+			{
+				// the surface crosses the row, the material is still the band's
+				const uint8_t material = bandMaterial( y0 + y );
+				bits = 0;
+
+				for( int x = 0; x < CHUNK_SIZE; x++ )
+				{
+					const bool filled = y < solid[x];
+
+					row[x] = filled ? material : 0;
+					bits |= (uint64_t)filled << x;
+				}
+			}
+		}
+	}
+
+	occupancy.setRows( bx, by, bz, &occupancyRows[0] );
+}
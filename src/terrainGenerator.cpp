@@ -9,26 +9,36 @@
 #include <iostream>
 #include <cstdlib>
 #include <time.h>
-#include "perlinNoise.h"
 
 using namespace std;
 
 // smaller = steeper more frequent hills
 #define TERRAIN_SCALE 150.0
 
-TerrainGenerator::TerrainGenerator( uint32_t size, float scaleFact ) :
-	_size(size), _scaleFact(scaleFact), heightMap(new float[size*size])
+TerrainGenerator::TerrainGenerator( uint32_t size, float scaleFact, uint32_t seed ) :
+	_size(size), _scaleFact(scaleFact), heightMap(new float[size*size]), noise(seed)
 {
 	//diamondSquare();
-	initPerlinNoise();
 }
 
 float TerrainGenerator::get( double x, double y ) const 
 { 
-	return _scaleFact*perlinNoise(x/TERRAIN_SCALE, y/TERRAIN_SCALE);
+	float val;
+	getTile( x, y, 1, 1, &val );
+	return val;
 	//return heightMap[(y%_size)*_size + (x%_size)]; 
 }
 
+void TerrainGenerator::getTile( double x, double y, uint32_t countX, uint32_t countY, float *out ) const
+{
+	noise.tile( x/TERRAIN_SCALE, y/TERRAIN_SCALE, 1.0/TERRAIN_SCALE, countX, countY, out );
+
+	for( uint32_t i = 0; i < countX*countY; i++ )
+	{
+		out[i] *= _scaleFact;
+	}
+}
+
 void TerrainGenerator::diamondSquare()
 {
 	// seed random number generator
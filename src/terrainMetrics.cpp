@@ -0,0 +1,155 @@
+/*
+ * File:	terrainMetrics.cpp
+ * Author:	James Letendre
+ *
+ * Timers and counters of the streaming pipeline, sampled for display and logs
+ */
+#include "terrainMetrics.h"
+
+static double seconds( const metricsClock::duration &d )
+{
+	return std::chrono::duration<double>( d ).count();
+}
+
+TerrainMetrics::TerrainMetrics() :
+	chunks(0), jobsCreated(0), jobsRegrown(0), start( metricsClock::now() ), last( start ), lastChunks(0),
+	lastJobsCreated(0), lastJobsRegrown(0)
+{
+	for( int t = 0; t < TERRAIN_TIMERS; t++ )
+	{
+		count[t] = 0;
+		totalNs[t] = 0;
+		maxNs[t] = 0;
+		lastCount[t] = 0;
+		lastTotalNs[t] = 0;
+	}
+}
+
+void TerrainMetrics::add( TerrainTimer timer, uint64_t ns )
+{
+	count[timer]++;
+	totalNs[timer] += ns;
+
+	uint64_t longest = maxNs[timer].load();
+	while( ns > longest && !maxNs[timer].compare_exchange_weak( longest, ns ) )
+	{
+	}
+}
+
+void TerrainMetrics::sample( TerrainMetricsSample &out )
+{
+	metricsClock::time_point now = metricsClock::now();
+
+	out = TerrainMetricsSample();
+	out.seconds = seconds( now - start );
+	out.intervalSeconds = seconds( now - last );
+
+	for( int t = 0; t < TERRAIN_TIMERS; t++ )
+	{
+		uint64_t c = count[t].load();
+		uint64_t ns = totalNs[t].load();
+
+		out.timers[t].count = c - lastCount[t];
+		out.timers[t].totalMs = (ns - lastTotalNs[t]) / 1e6;
+		out.timers[t].maxMs = maxNs[t].exchange( 0 ) / 1e6;
+
+		lastCount[t] = c;
+		lastTotalNs[t] = ns;
+	}
+
+	const double perSecond = (out.intervalSeconds > 0) ? 1 / out.intervalSeconds : 0;
+
+	uint64_t done = chunks.load();
+	out.chunks = done - lastChunks;
+	out.chunksPerSecond = out.chunks * perSecond;
+
+	uint64_t created = jobsCreated.load();
+	out.jobsCreated = created - lastJobsCreated;
+	out.jobsCreatedPerSecond = out.jobsCreated * perSecond;
+
+	uint64_t regrown = jobsRegrown.load();
+	out.jobsRegrown = regrown - lastJobsRegrown;
+	out.jobsRegrownPerSecond = out.jobsRegrown * perSecond;
+
+	lastChunks = done;
+	lastJobsCreated = created;
+	lastJobsRegrown = regrown;
+	last = now;
+}
+
+const char *TerrainMetrics::timerName( TerrainTimer timer )
+{
+	static const char *names[TERRAIN_TIMERS] = { "noise", "page_in", "extract", "mesh_build", "upload", "lock_wait" };
+
+	return names[timer];
+}
+
+TerrainMetricsLog::TerrainMetricsLog( const std::string &path, MetricsFormat format, double periodSeconds ) :
+	format(format), periodSeconds(periodSeconds), wroteHeader(false), last( metricsClock::now() )
+{
+	out = (path == "-") ? stdout : fopen( path.c_str(), "w" );
+}
+
+TerrainMetricsLog::~TerrainMetricsLog()
+{
+	if( out != NULL && out != stdout )
+	{
+		fclose( out );
+	}
+}
+
+bool TerrainMetricsLog::due() const
+{
+	return seconds( metricsClock::now() - last ) >= periodSeconds;
+}
+
+void TerrainMetricsLog::write( const TerrainMetricsSample &s )
+{
+	if( out == NULL )
+	{
+		return;
+	}
+
+	last = metricsClock::now();
+
+	if( format == METRICS_CSV )
+	{
+		if( !wroteHeader )
+		{
+			fprintf( out, "seconds,chunks,chunks_per_second,jobs_created,jobs_created_per_second,jobs_regrown,jobs_regrown_per_second" );
+			for( int t = 0; t < TERRAIN_TIMERS; t++ )
+			{
+				const char *name = TerrainMetrics::timerName( (TerrainTimer)t );
+				fprintf( out, ",%s_count,%s_ms,%s_max_ms", name, name, name );
+			}
+			fprintf( out, ",scheduled,generate_queued,mesh_queued,upload_queued,voxel_bytes,occupancy_bytes,height_bytes,mesh_bytes\n" );
+			wroteHeader = true;
+		}
+
+		fprintf( out, "%.3f,%zu,%.1f,%zu,%.1f,%zu,%.1f", s.seconds, s.chunks, s.chunksPerSecond,
+				s.jobsCreated, s.jobsCreatedPerSecond, s.jobsRegrown, s.jobsRegrownPerSecond );
+		for( int t = 0; t < TERRAIN_TIMERS; t++ )
+		{
+			fprintf( out, ",%zu,%.3f,%.3f", s.timers[t].count, s.timers[t].totalMs, s.timers[t].maxMs );
+		}
+		fprintf( out, ",%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu\n", s.scheduled, s.generateQueued, s.meshQueued, s.uploadQueued,
+				s.voxelBytes, s.occupancyBytes, s.heightBytes, s.meshBytes );
+	}
+	else
+	{
+		fprintf( out, "{\"seconds\":%.3f,\"chunks\":%zu,\"chunks_per_second\":%.1f", s.seconds, s.chunks, s.chunksPerSecond );
+		fprintf( out, ",\"jobs_created\":%zu,\"jobs_created_per_second\":%.1f,\"jobs_regrown\":%zu,\"jobs_regrown_per_second\":%.1f",
+				s.jobsCreated, s.jobsCreatedPerSecond, s.jobsRegrown, s.jobsRegrownPerSecond );
+		for( int t = 0; t < TERRAIN_TIMERS; t++ )
+		{
+			fprintf( out, ",\"%s\":{\"count\":%zu,\"ms\":%.3f,\"max_ms\":%.3f}", TerrainMetrics::timerName( (TerrainTimer)t ),
+					s.timers[t].count, s.timers[t].totalMs, s.timers[t].maxMs );
+		}
+		fprintf( out, ",\"scheduled\":%zu,\"generate_queued\":%zu,\"mesh_queued\":%zu,\"upload_queued\":%zu", s.scheduled,
+				s.generateQueued, s.meshQueued, s.uploadQueued );
+		fprintf( out, ",\"voxel_bytes\":%zu,\"occupancy_bytes\":%zu,\"height_bytes\":%zu,\"mesh_bytes\":%zu}\n", s.voxelBytes,
+				s.occupancyBytes, s.heightBytes, s.meshBytes );
+	}
+
+	fflush( out );
+}
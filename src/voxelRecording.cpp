@@ -0,0 +1,141 @@
+/*
+ * File:	voxelRecording.cpp
+ * Author:	James Letendre
+ *
+ * Camera path and voxel edits recorded at a fixed timestep, for replaying
+ */
+#include "voxelRecording.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#define RECORDING_MAGIC 0x50525856		// "VXRP"
+#define RECORDING_VERSION 1
+
+struct RecordingHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	float timestep;
+	uint32_t frames;
+	uint32_t edits;
+};
+
+PolyVox::Vector3DFloat RecordedFrame::getPosition() const
+{
+	return PolyVox::Vector3DFloat( position[0], position[1], position[2] );
+}
+
+PolyVox::Vector3DFloat RecordedFrame::getDirection() const
+{
+	// v = -z rotated by the quaternion: t = 2 (q x v), v + w t + q x t.
+	// t has no z component
+	const float w = orientation[0], x = orientation[1], y = orientation[2], z = orientation[3];
+	const float tx = -2 * y, ty = 2 * x;
+
+	return PolyVox::Vector3DFloat( w*tx - z*ty, w*ty + z*tx, -1 + x*ty - y*tx );
+}
+
+VoxelRecording::VoxelRecording( double timestep ) :
+	timestep(timestep), pending(0)
+{
+}
+
+void VoxelRecording::advance( double seconds, const float position[3], const float orientation[4] )
+{
+	pending += seconds;
+
+	while( pending >= timestep )
+	{
+		RecordedFrame frame;
+		memcpy( frame.position, position, sizeof(frame.position) );
+		memcpy( frame.orientation, orientation, sizeof(frame.orientation) );
+
+		frames.push_back( frame );
+		pending -= timestep;
+	}
+}
+
+void VoxelRecording::addEdit( const PolyVox::Vector3DFloat &center, float radius, uint8_t material )
+{
+	RecordedEdit edit;
+	edit.frame = frames.size();
+	edit.center[0] = center.getX();
+	edit.center[1] = center.getY();
+	edit.center[2] = center.getZ();
+	edit.radius = radius;
+	edit.material = material;
+
+	edits.push_back( edit );
+}
+
+void VoxelRecording::clear()
+{
+	frames.clear();
+	edits.clear();
+	pending = 0;
+}
+
+bool VoxelRecording::save( const std::string &path ) const
+{
+	FILE *file = fopen( path.c_str(), "wb" );
+	if( file == NULL )
+	{
+		std::cout << "VoxelRecording: can't write " << path << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	RecordingHeader header;
+	header.magic = RECORDING_MAGIC;
+	header.version = RECORDING_VERSION;
+	header.timestep = timestep;
+	header.frames = frames.size();
+	header.edits = edits.size();
+
+	bool ok = fwrite( &header, sizeof(header), 1, file ) == 1;
+	ok = ok && (frames.empty() || fwrite( &frames[0], sizeof(RecordedFrame), frames.size(), file ) == frames.size());
+	ok = ok && (edits.empty() || fwrite( &edits[0], sizeof(RecordedEdit), edits.size(), file ) == edits.size());
+	ok = (fclose( file ) == 0) && ok;
+
+	if( !ok )
+	{
+		std::cout << "VoxelRecording: can't write " << path << ": " << strerror(errno) << std::endl;
+	}
+	return ok;
+}
+
+bool VoxelRecording::load( const std::string &path )
+{
+	clear();
+
+	FILE *file = fopen( path.c_str(), "rb" );
+	if( file == NULL )
+	{
+		std::cout << "VoxelRecording: can't open " << path << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	RecordingHeader header;
+	bool ok = fread( &header, sizeof(header), 1, file ) == 1 &&
+		header.magic == RECORDING_MAGIC && header.version == RECORDING_VERSION && header.timestep > 0;
+
+	if( ok )
+	{
+		timestep = header.timestep;
+		frames.resize( header.frames );
+		edits.resize( header.edits );
+
+		ok = (frames.empty() || fread( &frames[0], sizeof(RecordedFrame), frames.size(), file ) == frames.size()) &&
+			(edits.empty() || fread( &edits[0], sizeof(RecordedEdit), edits.size(), file ) == edits.size());
+	}
+	fclose( file );
+
+	if( !ok )
+	{
+		std::cout << "VoxelRecording: " << path << " isn't a recording" << std::endl;
+		clear();
+	}
+	return ok;
+}